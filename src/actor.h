@@ -999,25 +999,15 @@ public:
 	// Triggers SECSPAC_Exit/SECSPAC_Enter and related events if oldsec != current sector
 	void CheckSectorTransition(sector_t *oldsec);
 
-// info for drawing
+// movement and collision info
 // NOTE: The first member variable *must* be snext.
+// Everything up to projectileKickback is used by P_XYMovement, P_ZMovement
+// and PIT_CheckThing for every moving actor each tic, so it is kept together
+// at the start of the object instead of being spread over all of it.
 	AActor			*snext, **sprev;	// links in sector (if needed)
 	fixedvec3		__pos;				// double underscores so that it won't get used by accident. Access to this should be exclusively through the designated access functions.
 
 	angle_t			angle;
-	WORD			sprite;				// used to find patch_t and flip value
-	BYTE			frame;				// sprite frame to draw
-	fixed_t			scaleX, scaleY;		// Scaling values; FRACUNIT is normal size
-	FRenderStyle	RenderStyle;		// Style to draw this actor with
-	ActorRenderFlags	renderflags;		// Different rendering flags
-	FTextureID		picnum;				// Draw this instead of sprite if valid
-	DWORD			effects;			// [RH] see p_effect.h
-	fixed_t			alpha;
-	DWORD			fillcolor;			// Color to draw when STYLE_Shaded
-
-// interaction info
-	fixed_t			pitch;
-	angle_t			roll;	// This was fixed_t before, which is probably wrong
 	FBlockNode		*BlockNode;			// links in blocks (if needed)
 	struct sector_t	*Sector;
 	subsector_t *		subsector;
@@ -1032,10 +1022,6 @@ public:
 	fixed_t			radius, height;		// for movement checking
 	fixed_t			projectilepassheight;	// height for clipping projectile movement against this actor
 	fixed_t			velx, vely, velz;	// velocity
-	SDWORD			tics;				// state tic counter
-	FState			*state;
-	SDWORD			Damage;			// For missiles and monster railgun
-	int				projectileKickback;
 	ActorFlags		flags;
 	ActorFlags2		flags2;			// Heretic flags
 	ActorFlags3		flags3;			// [RH] Hexen/Heretic actor-dependant behavior made flaggable
@@ -1043,6 +1029,37 @@ public:
 	ActorFlags5		flags5;			// OMG! We need another one.
 	ActorFlags6		flags6;			// Shit! Where did all the flags go?
 	ActorFlags7		flags7;			// WHO WANTS TO BET ON 8!?
+	fixed_t			MaxDropOffHeight, MaxStepHeight;
+	fixed_t			gravity;		// [GRB] Gravity factor
+	fixed_t			Friction;
+	fixed_t			floorclip;		// value to use for floor clipping
+	int				waterlevel;		// 0=none, 1=feet, 2=waist, 3=eyes
+	player_t		*player;		// only valid if type of APlayerPawn
+	AActor			*BlockingMobj;	// Actor that blocked the last move
+	line_t			*BlockingLine;	// Line that blocked the last move
+
+	// a linked list of sectors where this object appears
+	struct msecnode_t	*touching_sectorlist;				// phares 3/14/98
+
+	SDWORD			tics;				// state tic counter
+	FState			*state;
+	SDWORD			Damage;			// For missiles and monster railgun
+	int				projectileKickback;
+
+// info for drawing
+	WORD			sprite;				// used to find patch_t and flip value
+	BYTE			frame;				// sprite frame to draw
+	fixed_t			scaleX, scaleY;		// Scaling values; FRACUNIT is normal size
+	FRenderStyle	RenderStyle;		// Style to draw this actor with
+	ActorRenderFlags	renderflags;		// Different rendering flags
+	FTextureID		picnum;				// Draw this instead of sprite if valid
+	DWORD			effects;			// [RH] see p_effect.h
+	fixed_t			alpha;
+	DWORD			fillcolor;			// Color to draw when STYLE_Shaded
+
+// interaction info
+	fixed_t			pitch;
+	angle_t			roll;	// This was fixed_t before, which is probably wrong
 
 	// [BB] If 0, everybody can see the actor, if > 0, only members of team (VisibleToTeam-1) can see it.
 	DWORD			VisibleToTeam;
@@ -1063,7 +1080,6 @@ public:
 									// player to freeze a bit after teleporting
 	SDWORD			threshold;		// if > 0, the target will be chased
 									// no matter what (even if shot)
-	player_t		*player;		// only valid if type of APlayerPawn
 	TObjPtr<AActor>	LastLookActor;	// Actor last looked for (if TIDtoHate != 0)
 	fixed_t			SpawnPoint[3]; 	// For nightmare respawn
 	WORD			SpawnAngle;
@@ -1075,7 +1091,6 @@ public:
 	FNameNoInit		Species;		// For monster families
 	TObjPtr<AActor>	tracer;			// Thing being chased/attacked for tracers
 	TObjPtr<AActor>	master;			// Thing which spawned this one (prevents mutual attacks)
-	fixed_t			floorclip;		// value to use for floor clipping
 	int				tid;			// thing identifier
 	int				special;		// special
 	int				args[5];		// special arguments
@@ -1084,7 +1099,6 @@ public:
 
 	AActor			*inext, **iprev;// Links to other mobjs in same bucket
 	TObjPtr<AActor> goal;			// Monster's goal if not chasing anything
-	int				waterlevel;		// 0=none, 1=feet, 2=waist, 3=eyes
 	BYTE			boomwaterlevel;	// splash information for non-swimmable water sectors
 	BYTE			MinMissileChance;// [RH] If a random # is > than this, then missile attack.
 	SBYTE			LastLookPlayerNumber;// Player number last looked for (if TIDtoHate == 0)
@@ -1098,8 +1112,6 @@ public:
 	fixed_t			bouncefactor;	// Strife's grenades use 50%, Hexen's Flechettes 70.
 	fixed_t			wallbouncefactor;	// The bounce factor for walls can be different.
 	int				bouncecount;	// Strife's grenades only bounce twice before exploding
-	fixed_t			gravity;		// [GRB] Gravity factor
-	fixed_t			Friction;
 	int 			FastChaseStrafeCount;
 	fixed_t			pushfactor;
 	int				lastpush;
@@ -1109,9 +1121,6 @@ public:
 	FString *		Tag;			// Strife's tag name.
 	int				DesignatedTeam;	// Allow for friendly fire cacluations to be done on non-players.
 
-	AActor			*BlockingMobj;	// Actor that blocked the last move
-	line_t			*BlockingLine;	// Line that blocked the last move
-
 	int PoisonDamage; // Damage received per tic from poison.
 	FNameNoInit PoisonDamageType; // Damage type dealt by poison.
 	int PoisonDuration; // Duration left for receiving poison damage.
@@ -1123,9 +1132,6 @@ public:
 	int PoisonPeriodReceived; // How often poison damage is applied. (Every X tics.)
 	TObjPtr<AActor> Poisoner; // Last source of received poison damage.
 
-	// a linked list of sectors where this object appears
-	struct msecnode_t	*touching_sectorlist;				// phares 3/14/98
-
 	TObjPtr<AInventory>	Inventory;		// [RH] This actor's inventory
 	DWORD			InventoryID;	// A unique ID to keep track of inventory items
 
@@ -1147,7 +1153,6 @@ public:
 
 	fixed_t Speed;
 	fixed_t FloatSpeed;
-	fixed_t MaxDropOffHeight, MaxStepHeight;
 	SDWORD Mass;
 	SWORD PainChance;
 	int PainThreshold;
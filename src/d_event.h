@@ -69,6 +69,8 @@ typedef enum
 	ga_screenshot,
 	ga_togglemap,
 	ga_fullconsole,
+	ga_rewind,
+	ga_demoseek,
 } gameaction_t;
 
 
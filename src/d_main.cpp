@@ -975,22 +975,28 @@ void D_DoomLoop ()
 			}
 			
 			// process one or more tics
-			if (singletics)
+			if (singletics || G_DemoFastForwarding ())
 			{
-				I_StartTic ();
-				D_ProcessEvents ();
-				G_BuildTiccmd (&netcmds[consoleplayer][maketic%BACKUPTICS]);
-				if (advancedemo)
-					D_DoAdvanceDemo ();
-				C_Ticker ();
-				M_Ticker ();
-				G_Ticker ();
-				// [RH] Use the consoleplayer's camera to update sounds
-				S_UpdateSounds (players[consoleplayer].camera);	// move positional sounds
-				gametic++;
-				maketic++;
-				GC::CheckGC ();
-				Net_NewMakeTic ();
+				// When fast-forwarding a demo, run as many tics as fit
+				// in a tenth of a second before drawing the next frame.
+				DWORD start = I_MSTime ();
+				do
+				{
+					I_StartTic ();
+					D_ProcessEvents ();
+					G_BuildTiccmd (&netcmds[consoleplayer][maketic%BACKUPTICS]);
+					if (advancedemo)
+						D_DoAdvanceDemo ();
+					C_Ticker ();
+					M_Ticker ();
+					G_Ticker ();
+					// [RH] Use the consoleplayer's camera to update sounds
+					S_UpdateSounds (players[consoleplayer].camera);	// move positional sounds
+					gametic++;
+					maketic++;
+					GC::CheckGC ();
+					Net_NewMakeTic ();
+				} while (!singletics && G_DemoFastForwarding () && I_MSTime () - start < 100);
 			}
 			else
 			{
@@ -46,6 +46,8 @@
 #include "teaminfo.h"
 #include "p_conversation.h"
 #include "g_level.h"
+#include "g_synchash.h"
+#include "d_netsim.h"
 #include "d_event.h"
 #include "m_argv.h"
 #include "p_lnspec.h"
@@ -96,6 +98,7 @@ bool			nodejustleft[MAXNETNODES];				// set when a node just left
 bool	 		remoteresend[MAXNETNODES];				// set when local needs tics
 int 			resendto[MAXNETNODES];					// set when remote needs tics
 int 			resendcount[MAXNETNODES];
+FNetTraffic		NetTraffic[MAXNETNODES];
 
 unsigned int	lastrecvtime[MAXPLAYERS];				// [RH] Used for pings
 unsigned int	currrecvtime[MAXPLAYERS];
@@ -496,6 +499,9 @@ void HSendPacket (int node, int len)
 	if (!netgame)
 		I_Error ("Tried to transmit to another node");
 
+	NetTraffic[node].PacketsOut++;
+	NetTraffic[node].BytesOut += len;
+
 #if SIMULATEERRORS
 	if (rand() < SIMULATEERRORS)
 	{
@@ -509,6 +515,12 @@ void HSendPacket (int node, int len)
 	doomcom.remotenode = node;
 	doomcom.datalength = len;
 
+	if (NetSim_Active () && !(netbuffer[0] & (NCMD_EXIT|NCMD_SETUP)))
+	{
+		NetSim_Send ();
+		return;
+	}
+
 #ifdef _DEBUG
 	if (net_fakelatency / 2 > 0)
 	{
@@ -555,6 +567,8 @@ bool HGetPacket (void)
 	if (demoplayback)
 		return false;
 
+	NetSim_Flush ();
+
 	doomcom.command = CMD_GET;
 	I_NetCmd ();
 
@@ -654,6 +668,8 @@ bool HGetPacket (void)
 		return false;
 	}
 
+	NetTraffic[doomcom.remotenode].PacketsIn++;
+	NetTraffic[doomcom.remotenode].BytesIn += doomcom.datalength;
 	return true;		
 }
 
@@ -734,6 +750,99 @@ void PlayerIsGone (int netnode, int netconsole)
 // GetPackets
 //
 
+//==========================================================================
+//
+// Lockstep rules
+//
+// These decide what NetUpdate sends, what GetPackets accepts and how
+// many tics TryRunTics runs. They only work on the values passed to
+// them, so the netsim harness can run the same rules for several
+// simulated nodes.
+//
+//==========================================================================
+
+// True if another local tic can be made while ahead tics (in ticdup
+// units) are made but not run yet.
+bool Net_CanMakeTic (int ahead)
+{
+	return ahead < BACKUPTICS/2-1;
+}
+
+// Where the next packet to a node starts after sending it everything
+// up to lowtic, for the given net_extratic setting. remotetics is how
+// far that node has sent to us.
+int Net_NextResendTo (int extratic, int lowtic, int remotetics)
+{
+	switch (extratic)
+	{
+	case 0:
+	default:
+		return lowtic;
+	case 1:
+		return MAX(0, lowtic - 1);
+	case 2:
+		return remotetics;
+	}
+}
+
+// Decides whether a node is sent a packet when no new local tic was made:
+// only if it asked for a resend of numtics tics, we are waiting for a
+// resend from it, or it hasn't sent anything yet.
+bool Net_SendResendOnly (int numtics, int resendcount, bool remoteresend, int remotetics)
+{
+	return (numtics > 0 && resendcount > 0) || remoteresend || remotetics == 0;
+}
+
+// Handles a retransmit request from a node. Requests repeated within
+// RESENDCOUNT packets of the last one are ignored. Returns true if the
+// next packet to the node will start at retransmitfrom.
+bool Net_CheckRetransmit (bool retransmit, int retransmitfrom, int &resendto, int &resendcount)
+{
+	if (resendcount <= 0 && retransmit)
+	{
+		resendto = retransmitfrom;
+		resendcount = RESENDCOUNT;
+		return true;
+	}
+	resendcount--;
+	return false;
+}
+
+// Checks tics realstart to realend received from a node against the
+// tics already received from it. On a gap, remoteresend is set so that
+// the next packets to the node ask for a retransmit.
+ENetReceived Net_ReceiveTics (int realstart, int realend, int nettics, bool &remoteresend)
+{
+	if (realend == nettics)
+	{
+		return NETRECV_Duplicate;
+	}
+	if (realend < nettics)
+	{
+		return NETRECV_Late;
+	}
+	if (realstart > nettics)
+	{
+		remoteresend = true;
+		return NETRECV_Missed;
+	}
+	remoteresend = false;
+	return NETRECV_Tics;
+}
+
+// How many tics to run when realtics tics of time passed and every
+// node's commands are there for availabletics more. Catches up by one
+// extra tic at a time.
+int Net_TicsToRun (int realtics, int availabletics)
+{
+	if (realtics < availabletics-1)
+		return realtics+1;
+	else if (realtics < availabletics)
+		return realtics;
+	else
+		return availabletics;
+}
+
 void GetPackets (void)
 {
 	int netconsole;
@@ -857,46 +966,46 @@ void GetPackets (void)
 		nodeforplayer[netconsole] = netnode;
 		
 		// check for retransmit request
-		if (resendcount[netnode] <= 0 && (netbuffer[0] & NCMD_RETRANSMIT))
+		if (Net_CheckRetransmit (!!(netbuffer[0] & NCMD_RETRANSMIT), ExpandTics (retransmitfrom),
+			resendto[netnode], resendcount[netnode]))
 		{
-			resendto[netnode] = ExpandTics (retransmitfrom);
+			NetTraffic[netnode].Retransmits++;
 			if (debugfile)
 				fprintf (debugfile,"retransmit from %i\n", resendto[netnode]);
-			resendcount[netnode] = RESENDCOUNT;
-		}
-		else
-		{
-			resendcount[netnode]--;
 		}
 		
-		// check for out of order / duplicated packet			
-		if (realend == nettics[netnode])
-			continue;
-						
-		if (realend < nettics[netnode])
+		// check for out of order / duplicated packet and for a missed packet
+		bool wasmissing = remoteresend[netnode];
+		switch (Net_ReceiveTics (realstart, realend, nettics[netnode], remoteresend[netnode]))
 		{
+		case NETRECV_Duplicate:
+			continue;
+
+		case NETRECV_Late:
 			if (debugfile)
 				fprintf (debugfile, "out of order packet (%i + %i)\n" ,
 						 realstart, numtics);
 			continue;
-		}
-		
-		// check for a missed packet
-		if (realstart > nettics[netnode])
-		{
+
+		case NETRECV_Missed:
 			// stop processing until the other system resends the missed tics
 			if (debugfile)
 				fprintf (debugfile, "missed tics from %i (%i to %i)\n",
 						 netnode, nettics[netnode], realstart);
-			remoteresend[netnode] = true;
+			if (!wasmissing)
+			{
+				NetTraffic[netnode].ResendRequests++;
+			}
 			continue;
+
+		case NETRECV_Tics:
+			break;
 		}
 
 		// update command store from the packet
 		{
 			BYTE *start;
 			int i, tics;
-			remoteresend[netnode] = false;
 
 			start = &netbuffer[k];
 
@@ -965,7 +1074,7 @@ void NetUpdate (void)
 	{
 		I_StartTic ();
 		D_ProcessEvents ();
-		if (pauseext || (maketic - gametic) / ticdup >= BACKUPTICS/2-1)
+		if (pauseext || !Net_CanMakeTic ((maketic - gametic) / ticdup))
 			break;			// can't hold any more
 		
 		//Printf ("mk:%i ",maketic);
@@ -1119,7 +1228,7 @@ void NetUpdate (void)
 		{
 			continue;
 		}
-		if (resendOnly && resendcount[i] <= 0 && !remoteresend[i] && nettics[i])
+		if (resendOnly && !Net_SendResendOnly (1, resendcount[i], remoteresend[i], nettics[i]))
 		{
 			continue;
 		}
@@ -1151,16 +1260,9 @@ void NetUpdate (void)
 		if (numtics > BACKUPTICS)
 			I_Error ("NetUpdate: Node %d missed too many tics", i);
 
-		switch (net_extratic)
-		{
-		case 0:
-		default: 
-			resendto[i] = lowtic; break;
-		case 1: resendto[i] = MAX(0, lowtic - 1); break;
-		case 2: resendto[i] = nettics[i]; break;
-		}
+		resendto[i] = Net_NextResendTo (net_extratic, lowtic, nettics[i]);
 
-		if (numtics == 0 && resendOnly && !remoteresend[i] && nettics[i])
+		if (resendOnly && !Net_SendResendOnly (numtics, resendcount[i], remoteresend[i], nettics[i]))
 		{
 			continue;
 		}
@@ -1245,7 +1347,7 @@ void NetUpdate (void)
 							memcpy (cmddata, specials.streams[start], specials.used[start]);
 							cmddata += specials.used[start];
 						}
-						WriteUserCmdMessage (&localcmds[localstart].ucmd,
+						WriteNetUserCmdMessage (&localcmds[localstart].ucmd,
 							localprev >= 0 ? &localcmds[localprev].ucmd : NULL, &cmddata);
 					}
 					else if (i != 0)
@@ -1261,7 +1363,7 @@ void NetUpdate (void)
 							cmddata += len;
 						}
 
-						WriteUserCmdMessage (&netcmds[playerbytes[l]][start].ucmd,
+						WriteNetUserCmdMessage (&netcmds[playerbytes[l]][start].ucmd,
 							prev >= 0 ? &netcmds[playerbytes[l]][prev].ucmd : NULL, &cmddata);
 					}
 				}
@@ -1846,12 +1948,7 @@ void TryRunTics (void)
 	}
 
 	// decide how many tics to run
-	if (realtics < availabletics-1)
-		counts = realtics+1;
-	else if (realtics < availabletics)
-		counts = realtics;
-	else
-		counts = availabletics;
+	counts = Net_TicsToRun (realtics, availabletics);
 	
 	// Uncapped framerate needs seprate checks
 	if (counts == 0 && !doWait)
@@ -2660,6 +2757,10 @@ void Net_DoCommand (int type, BYTE **stream, int player)
 		players[player].camera = players[player].mo;
 		break;
 
+	case DEM_SYNCHASH:
+		G_ReadSyncHash (player, stream);
+		break;
+
 	default:
 		I_Error ("Unknown net command: %d", type);
 		break;
@@ -2813,6 +2914,10 @@ void Net_SkipCommand (int type, BYTE **stream)
 			skip = 2;
 			break;
 
+		case DEM_SYNCHASH:
+			skip = 20;
+			break;
+
 		default:
 			return;
 	}
@@ -2830,6 +2935,115 @@ CCMD (pings)
 					players[i].userinfo.GetName());
 }
 
+//==========================================================================
+//
+// CCMD packetstats
+//
+// Lists the traffic with every node since the game started or the last
+// "packetstats reset".
+//
+//==========================================================================
+
+CCMD (packetstats)
+{
+	if (argv.argc() > 1 && stricmp (argv[1], "reset") == 0)
+	{
+		memset (NetTraffic, 0, sizeof(NetTraffic));
+		NetUserCmdBytes = NetUserCmdUnpackedBytes = 0;
+		return;
+	}
+
+	Printf ("node    sent  avg  wire    recv  avg  wire  rreq   rtx  player\n");
+	for (int i = 1; i < doomcom.numnodes; i++)
+	{
+		const FNetTraffic &t = NetTraffic[i];
+		Printf ("%4d %7u %4u %5u %7u %4u %5u %5u %5u  %s\n", i,
+			t.PacketsOut, unsigned(t.BytesOut / MAX<DWORD>(t.PacketsOut, 1)), unsigned(t.WireOut / MAX<DWORD>(t.PacketsOut, 1)),
+			t.PacketsIn, unsigned(t.BytesIn / MAX<DWORD>(t.PacketsIn, 1)), unsigned(t.WireIn / MAX<DWORD>(t.PacketsIn, 1)),
+			t.ResendRequests, t.Retransmits,
+			nodeingame[i] ? players[playerfornode[i]].userinfo.GetName() : "");
+	}
+	if (NetUserCmdUnpackedBytes > 0)
+	{
+		Printf ("Movement: %u bytes sent, %u in the demo format (%.1f%%)\n",
+			NetUserCmdBytes, NetUserCmdUnpackedBytes, NetUserCmdBytes * 100. / NetUserCmdUnpackedBytes);
+	}
+}
+
+//==========================================================================
+//
+// CCMD netpacktest
+//
+// Runs synthetic movement through the network encoding and back again,
+// the same way NetUpdate and GetPackets do, and compares the result and
+// size with the demo encoding.
+//
+//==========================================================================
+
+CCMD (netpacktest)
+{
+	static FRandom pr_netpacktest;
+	const int tics = argv.argc() > 1 ? MAX (atoi (argv[1]), 1) : 35*60;
+	DWORD savedbytes = NetUserCmdBytes, savedunpacked = NetUserCmdUnpackedBytes;
+	TArray<usercmd_t> cmds;
+	TArray<BYTE> stream;
+	usercmd_t cmd;
+	int i;
+
+	// Mouse turning with occasional key and button changes
+	memset (&cmd, 0, sizeof(cmd));
+	cmds.Resize (tics);
+	for (i = 0; i < tics; ++i)
+	{
+		int r = pr_netpacktest (100);
+		if (r < 70)			cmd.yaw += pr_netpacktest.Random2 () * 4;
+		if (r < 20)			cmd.pitch = pr_netpacktest.Random2 () * 2;
+		else if (r < 25)	cmd.pitch = 0;
+		if (r >= 90)		cmd.forwardmove = (pr_netpacktest (3) - 1) * 0x3200;
+		if (r >= 94)		cmd.sidemove = (pr_netpacktest (3) - 1) * 0x2800;
+		if (r >= 97)		cmd.buttons ^= 1 << pr_netpacktest (8);
+		cmds[i] = cmd;
+	}
+
+	// Encode with a consistancy word per tic, as in a packet.
+	stream.Resize (tics * 24);
+	BYTE *p = &stream[0];
+	NetUserCmdBytes = NetUserCmdUnpackedBytes = 0;
+	for (i = 0; i < tics; ++i)
+	{
+		WriteWord (short(i), &p);
+		WriteNetUserCmdMessage (&cmds[i], i > 0 ? &cmds[i-1] : NULL, &p);
+	}
+	DWORD packed = NetUserCmdBytes, unpacked = NetUserCmdUnpackedBytes;
+	NetUserCmdBytes = savedbytes;
+	NetUserCmdUnpackedBytes = savedunpacked;
+
+	// Decode and compare.
+	BYTE *end = p, *skip = &stream[0];
+	bool ok = SkipTicCmd (&skip, tics) == int(end - &stream[0]);
+	p = &stream[0];
+	memset (&cmd, 0, sizeof(cmd));
+	for (i = 0; ok && i < tics; ++i)
+	{
+		ok = ReadWord (&p) == short(i);
+		int type = ReadByte (&p);
+		if (type == DEM_NETUSERCMD)
+		{
+			UnpackNetUserCmd (&cmd, &cmd, &p);
+		}
+		else if (type != DEM_EMPTYUSERCMD)
+		{
+			ok = false;
+		}
+		ok = ok && memcmp (&cmd, &cmds[i], sizeof(cmd)) == 0;
+	}
+	ok = ok && p == end;
+
+	Printf ("%d tics: %u bytes of movement, %u in the demo format (%.1f%%), %.2f bytes per tic with consistancy: %s\n",
+		tics, packed, unpacked, packed * 100. / MAX<DWORD>(unpacked, 1), double(end - &stream[0]) / tics,
+		ok ? "OK" : "MISMATCH");
+}
+
 //==========================================================================
 //
 // Network_Controller
@@ -98,6 +98,18 @@ private:
 
 extern FDynamicBuffer NetSpecs[MAXPLAYERS][BACKUPTICS];
 
+// Traffic with one node, for packetstats. Wire sizes are after compression.
+struct FNetTraffic
+{
+	DWORD PacketsOut, PacketsIn;
+	QWORD BytesOut, BytesIn;
+	QWORD WireOut, WireIn;
+	DWORD ResendRequests;		// Times we asked the node to resend
+	DWORD Retransmits;			// Times the node asked us to resend
+};
+
+extern FNetTraffic NetTraffic[MAXNETNODES];
+
 // Create any new ticcmds and broadcast to other players.
 void NetUpdate (void);
 
@@ -125,6 +137,22 @@ void Net_SkipCommand (int type, BYTE **stream);
 
 void Net_ClearBuffers ();
 
+// Lockstep rules, shared by the game and the netsim harness
+enum ENetReceived
+{
+	NETRECV_Tics,			// New tics, read them
+	NETRECV_Duplicate,		// Nothing new
+	NETRECV_Late,			// Older than what we have, arrived out of order
+	NETRECV_Missed,			// Some tics before these are missing
+};
+
+bool Net_CanMakeTic (int ahead);
+int Net_NextResendTo (int extratic, int lowtic, int remotetics);
+bool Net_SendResendOnly (int numtics, int resendcount, bool remoteresend, int remotetics);
+bool Net_CheckRetransmit (bool retransmit, int retransmitfrom, int &resendto, int &resendcount);
+ENetReceived Net_ReceiveTics (int realstart, int realend, int nettics, bool &remoteresend);
+int Net_TicsToRun (int realtics, int availabletics);
+
 
 // Netgame stuff (buffers and pointers, i.e. indices).
 
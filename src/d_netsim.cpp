@@ -0,0 +1,559 @@
+// DESCRIPTION:
+//      Simulated network conditions and an in-process lockstep harness.
+//
+// With any of the net_sim* cvars set, game packets leaving this node are
+// held back by FNetSimQueue, which adds latency and jitter and loses or
+// reorders some of them, before they are handed to the real packet
+// driver. Exit and setup packets are never touched.
+//
+// The netsim command runs a number of simulated nodes through the same
+// queue without a game. NetUpdate, GetPackets and TryRunTics work on the
+// game itself, so they can't run several nodes in one process. Instead
+// each simulated node calls the lockstep rules they use (Net_CanMakeTic,
+// Net_CheckRetransmit, Net_ReceiveTics, Net_TicsToRun and so on) in the
+// same order as they do for a peer-to-peer game with ticdup 1 and a
+// capped framerate. This shows how latency, extra tics and resends behave
+// under given conditions without several machines.
+
+
+#include <string.h>
+#include "doomtype.h"
+#include "doomdef.h"
+#include "d_net.h"
+#include "d_netsim.h"
+#include "d_protocol.h"
+#include "d_ticcmd.h"
+#include "i_system.h"
+#include "i_net.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "templates.h"
+
+static FNetSimQueue OutQueue;
+static void ConfigureOutQueue ();
+
+CUSTOM_CVAR (Int, net_simlatency, 0, CVAR_NOSAVE)
+{
+	if (self < 0)
+		self = 0;
+	else
+		ConfigureOutQueue ();
+}
+CUSTOM_CVAR (Int, net_simjitter, 0, CVAR_NOSAVE)
+{
+	if (self < 0)
+		self = 0;
+	else
+		ConfigureOutQueue ();
+}
+CUSTOM_CVAR (Float, net_simloss, 0, CVAR_NOSAVE)
+{
+	if (self < 0)
+		self = 0;
+	else if (self > 100)
+		self = 100;
+	else
+		ConfigureOutQueue ();
+}
+CUSTOM_CVAR (Float, net_simreorder, 0, CVAR_NOSAVE)
+{
+	if (self < 0)
+		self = 0;
+	else if (self > 100)
+		self = 100;
+	else
+		ConfigureOutQueue ();
+}
+
+EXTERN_CVAR (Int, net_extratic)
+
+//==========================================================================
+//
+// FNetSimQueue
+//
+//==========================================================================
+
+FNetSimQueue::FNetSimQueue ()
+{
+	Configure (0, 0, 0, 0, 1);
+	Clear ();
+}
+
+void FNetSimQueue::Clear ()
+{
+	Packets.Clear ();
+	memset (LastTime, 0, sizeof(LastTime));
+	NextSeq = 0;
+	Sent = Dropped = Reordered = 0;
+}
+
+void FNetSimQueue::Configure (int latency, int jitter, float loss, float reorder, DWORD seed)
+{
+	Latency = latency;
+	Jitter = jitter;
+	Loss = loss;
+	Reorder = reorder;
+	Seed = seed != 0 ? seed : 1;
+}
+
+// xorshift32. The game's RNGs must not be touched by this.
+DWORD FNetSimQueue::Random ()
+{
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 17;
+	Seed ^= Seed << 5;
+	return Seed;
+}
+
+//==========================================================================
+//
+// FNetSimQueue :: Push
+//
+// Queues a packet for node. Returns false if it was lost. Unless it is
+// picked for reordering, a packet is never delivered before one that
+// was pushed earlier for the same node, so jitter alone only delays.
+//
+//==========================================================================
+
+bool FNetSimQueue::Push (DWORD now, int node, const BYTE *data, int len)
+{
+	Sent++;
+	if (Loss > 0 && (Random() % 10000) < Loss * 100)
+	{
+		Dropped++;
+		return false;
+	}
+
+	DWORD time = now + Latency;
+	if (Jitter > 0)
+	{
+		time += Random() % (Jitter + 1);
+	}
+	if (Reorder > 0 && (Random() % 10000) < Reorder * 100)
+	{
+		// Hold it back long enough for the next few packets to pass it.
+		time += 1000 / TICRATE * (1 + Random() % 3) + Jitter;
+		Reordered++;
+	}
+	else
+	{
+		time = MAX (time, LastTime[node]);
+		LastTime[node] = time;
+	}
+
+	FPacket &packet = Packets[Packets.Reserve (1)];
+	packet.Time = time;
+	packet.Seq = NextSeq++;
+	packet.Node = node;
+	packet.Data.Resize (len);
+	memcpy (&packet.Data[0], data, len);
+	return true;
+}
+
+//==========================================================================
+//
+// FNetSimQueue :: Pop
+//
+// Takes out the packet that is due first, if any is due by now.
+//
+//==========================================================================
+
+bool FNetSimQueue::Pop (DWORD now, int &node, BYTE *data, int &len)
+{
+	int best = -1;
+
+	for (unsigned int i = 0; i < Packets.Size(); ++i)
+	{
+		const FPacket &p = Packets[i];
+		if (p.Time <= now && (best < 0 || p.Time < Packets[best].Time ||
+			(p.Time == Packets[best].Time && p.Seq < Packets[best].Seq)))
+		{
+			best = i;
+		}
+	}
+	if (best < 0)
+	{
+		return false;
+	}
+	node = Packets[best].Node;
+	len = Packets[best].Data.Size();
+	memcpy (data, &Packets[best].Data[0], len);
+	Packets.Delete (best);
+	return true;
+}
+
+//==========================================================================
+//
+// NetSim_Active
+//
+//==========================================================================
+
+bool NetSim_Active ()
+{
+	return net_simlatency > 0 || net_simjitter > 0 || net_simloss > 0 || net_simreorder > 0;
+}
+
+//==========================================================================
+//
+// ConfigureOutQueue
+//
+// Called when one of the cvars changes. The queue is seeded here and not
+// for every packet, so losses and delays follow one random sequence.
+//
+//==========================================================================
+
+static void ConfigureOutQueue ()
+{
+	OutQueue.Configure (net_simlatency, net_simjitter, net_simloss, net_simreorder, I_MSTime() | 1);
+}
+
+//==========================================================================
+//
+// NetSim_Send
+//
+// Called by HSendPacket instead of sending doomcom right away.
+//
+//==========================================================================
+
+void NetSim_Send ()
+{
+	OutQueue.Push (I_MSTime(), doomcom.remotenode, doomcom.data, doomcom.datalength);
+}
+
+//==========================================================================
+//
+// NetSim_Flush
+//
+// Sends the packets that are due. This overwrites doomcom.
+//
+//==========================================================================
+
+void NetSim_Flush ()
+{
+	int node, len;
+
+	while (OutQueue.Pop (I_MSTime(), node, doomcom.data, len))
+	{
+		doomcom.command = CMD_SEND;
+		doomcom.remotenode = node;
+		doomcom.datalength = len;
+		I_NetCmd ();
+	}
+}
+
+//==========================================================================
+//
+// The lockstep harness
+//
+//==========================================================================
+
+namespace
+{
+	// What travels in a simulated packet. Its size on the wire is
+	// worked out separately from the real encoding.
+	struct FSimPacket
+	{
+		int From;
+		int Start, NumTics;
+		int RetransmitFrom;		// -1 for none
+	};
+
+	struct FSimNode
+	{
+		int MakeTic, GameTic;
+		int WaitCounts;					// Tics TryRunTics is waiting to run, or 0
+		int NetTics[MAXNETNODES];
+		int ResendTo[MAXNETNODES];
+		int ResendCount[MAXNETNODES];
+		bool RemoteResend[MAXNETNODES];
+		TArray<DWORD> MakeTime;			// When each local tic was made
+		TArray<usercmd_t> Cmds;
+		FNetSimQueue Inbox;
+		DWORD Seed;
+
+		// Results
+		double LatencySum;
+		DWORD LatencyMax;
+		int Stalls;						// Tics the node waited without running anything
+		int Throttled;					// Tics the node couldn't make a command
+		int ResendRequests, Retransmits, Resent, Late;
+		DWORD PacketsSent;
+		QWORD BytesSent;
+	};
+
+	DWORD SimRandom (DWORD &seed)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
+	}
+}
+
+// Mouse turning with occasional key and button changes, as in netpacktest.
+static void MakeSimCmd (FSimNode &node)
+{
+	usercmd_t cmd;
+	DWORD r = SimRandom (node.Seed) % 100;
+
+	if (node.Cmds.Size() > 0)
+	{
+		cmd = node.Cmds.Last();
+	}
+	else
+	{
+		memset (&cmd, 0, sizeof(cmd));
+	}
+	if (r < 70)			cmd.yaw += short(SimRandom (node.Seed) % 2041) - 1020;
+	if (r < 20)			cmd.pitch = short(SimRandom (node.Seed) % 1021) - 510;
+	if (r >= 90)		cmd.forwardmove = (int(SimRandom (node.Seed) % 3) - 1) * 0x3200;
+	if (r >= 97)		cmd.buttons ^= 1 << (SimRandom (node.Seed) % 8);
+	node.Cmds.Push (cmd);
+}
+
+// The size NetUpdate would give this packet, without NCMD_MULTI.
+static int SimPacketSize (FSimNode &node, const FSimPacket &packet)
+{
+	DWORD savedbytes = NetUserCmdBytes, savedunpacked = NetUserCmdUnpackedBytes;
+	BYTE buffer[32];
+	int len = 3;		// flags, start tic, delay
+
+	if (packet.RetransmitFrom >= 0)	len++;
+	if (packet.NumTics >= 3)		len++;
+	for (int tic = packet.Start; tic < packet.Start + packet.NumTics; ++tic)
+	{
+		BYTE *p = buffer;
+		len += 2 + WriteNetUserCmdMessage (&node.Cmds[tic], tic > 0 ? &node.Cmds[tic - 1] : NULL, &p);
+	}
+	// Keep these out of packetstats.
+	NetUserCmdBytes = savedbytes;
+	NetUserCmdUnpackedBytes = savedunpacked;
+	return len;
+}
+
+// NetUpdate: make a tic if one is due and there's room, then send to
+// everybody who needs a packet.
+static bool SimNetUpdate (TArray<FSimNode> &nodes, int n, DWORD now, bool newtic, int extratic)
+{
+	FSimNode &node = nodes[n];
+	bool resendOnly = true;
+
+	if (newtic)
+	{
+		if (Net_CanMakeTic (node.MakeTic - node.GameTic))
+		{
+			MakeSimCmd (node);
+			node.MakeTime.Push (now);
+			node.MakeTic++;
+			node.NetTics[n] = node.MakeTic;
+			resendOnly = false;
+		}
+		else
+		{
+			node.Throttled++;
+		}
+	}
+
+	for (unsigned int m = 0; m < nodes.Size(); ++m)
+	{
+		if (int(m) == n)
+		{
+			continue;
+		}
+		if (resendOnly && !Net_SendResendOnly (1, node.ResendCount[m], node.RemoteResend[m], node.NetTics[m]))
+		{
+			continue;
+		}
+
+		FSimPacket packet;
+		packet.From = n;
+		packet.Start = node.ResendTo[m];
+		packet.NumTics = MAX (0, node.MakeTic - packet.Start);
+		packet.RetransmitFrom = node.RemoteResend[m] ? node.NetTics[m] : -1;
+		if (packet.NumTics > BACKUPTICS)
+		{
+			return false;		// "Node missed too many tics"
+		}
+		node.ResendTo[m] = Net_NextResendTo (extratic, node.MakeTic, node.NetTics[m]);
+
+		if (resendOnly && !Net_SendResendOnly (packet.NumTics, node.ResendCount[m], node.RemoteResend[m], node.NetTics[m]))
+		{
+			continue;
+		}
+		if (packet.NumTics > 1)
+		{
+			node.Resent += packet.NumTics - 1;
+		}
+		node.PacketsSent++;
+		node.BytesSent += SimPacketSize (node, packet);
+		nodes[m].Inbox.Push (now, n, (BYTE *)&packet, sizeof(packet));
+	}
+	return true;
+}
+
+// GetPackets
+static void SimGetPackets (FSimNode &node, DWORD now)
+{
+	FSimPacket packet;
+	int from, len;
+
+	while (node.Inbox.Pop (now, from, (BYTE *)&packet, len))
+	{
+		int src = packet.From;
+		int realend = packet.Start + packet.NumTics;
+		bool wasmissing = node.RemoteResend[src];
+
+		if (Net_CheckRetransmit (packet.RetransmitFrom >= 0, packet.RetransmitFrom,
+			node.ResendTo[src], node.ResendCount[src]))
+		{
+			node.Retransmits++;
+		}
+		switch (Net_ReceiveTics (packet.Start, realend, node.NetTics[src], node.RemoteResend[src]))
+		{
+		case NETRECV_Duplicate:
+			break;
+
+		case NETRECV_Late:
+			node.Late++;
+			break;
+
+		case NETRECV_Missed:
+			if (!wasmissing)
+			{
+				node.ResendRequests++;
+			}
+			break;
+
+		case NETRECV_Tics:
+			node.NetTics[src] = realend;
+			break;
+		}
+	}
+}
+
+static int SimLowTic (const TArray<FSimNode> &nodes, int n)
+{
+	int lowtic = INT_MAX;
+
+	for (unsigned int m = 0; m < nodes.Size(); ++m)
+	{
+		lowtic = MIN (lowtic, nodes[n].NetTics[m]);
+	}
+	return lowtic;
+}
+
+// The part of TryRunTics that runs the tics once they are all there.
+static bool SimRunTics (TArray<FSimNode> &nodes, int n, DWORD now)
+{
+	FSimNode &node = nodes[n];
+
+	if (SimLowTic (nodes, n) < node.GameTic + node.WaitCounts)
+	{
+		return false;
+	}
+	for (; node.WaitCounts > 0; --node.WaitCounts)
+	{
+		DWORD latency = now - node.MakeTime[node.GameTic];
+		node.LatencySum += latency;
+		node.LatencyMax = MAX (node.LatencyMax, latency);
+		node.GameTic++;
+	}
+	return true;
+}
+
+// TryRunTics, once per tic of time: update, decide how many tics to run
+// and run them as soon as every node's commands for them are there. If
+// they still aren't by the next tic, TryRunTics has given up waiting.
+static bool SimTryRunTics (TArray<FSimNode> &nodes, int n, DWORD now, int extratic)
+{
+	FSimNode &node = nodes[n];
+
+	if (node.WaitCounts > 0)
+	{
+		node.Stalls++;
+	}
+	if (!SimNetUpdate (nodes, n, now, true, extratic))
+	{
+		return false;
+	}
+	node.WaitCounts = MAX (1, Net_TicsToRun (1, SimLowTic (nodes, n) - node.GameTic));
+	SimRunTics (nodes, n, now);
+	return true;
+}
+
+CCMD (netsim)
+{
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: netsim <nodes> [seconds] [extratic]\n"
+			"Uses net_simlatency, net_simjitter, net_simloss and net_simreorder.\n");
+		return;
+	}
+
+	const int numnodes = clamp (atoi (argv[1]), 2, MAXNETNODES);
+	const int seconds = argv.argc() > 2 ? MAX (atoi (argv[2]), 1) : 60;
+	const int extratic = argv.argc() > 3 ? clamp (atoi (argv[3]), 0, 2) : *net_extratic;
+	const int tics = seconds * TICRATE;
+	TArray<FSimNode> nodes;
+	int n, m;
+
+	nodes.Resize (numnodes);
+	for (n = 0; n < numnodes; ++n)
+	{
+		FSimNode &node = nodes[n];
+		node.MakeTic = node.GameTic = node.WaitCounts = 0;
+		for (m = 0; m < MAXNETNODES; ++m)
+		{
+			node.NetTics[m] = node.ResendTo[m] = node.ResendCount[m] = 0;
+			node.RemoteResend[m] = false;
+		}
+		node.Inbox.Configure (net_simlatency, net_simjitter, net_simloss, net_simreorder, 0x9E3779B9u * (n + 1));
+		node.Seed = 0x85EBCA77u * (n + 1);
+		node.LatencySum = 0;
+		node.LatencyMax = 0;
+		node.Stalls = node.Throttled = node.ResendRequests = node.Retransmits = node.Resent = node.Late = 0;
+		node.PacketsSent = 0;
+		node.BytesSent = 0;
+	}
+
+	// Step through time one millisecond at a time. Every node enters
+	// TryRunTics on each tic of the clock. In between, a node that is
+	// waiting for tics keeps calling NetUpdate, which only looks for
+	// packets when no new tic is due.
+	bool ok = true;
+	int clock = 0;
+	DWORD now;
+	for (now = 0; ok && clock < tics; ++now)
+	{
+		bool tick = now * TICRATE / 1000 >= DWORD(clock + 1);
+		if (tick)
+		{
+			clock++;
+		}
+		for (n = 0; n < numnodes; ++n)
+		{
+			SimGetPackets (nodes[n], now);
+			if (tick)
+			{
+				ok = SimTryRunTics (nodes, n, now, extratic) && ok;
+			}
+			else if (nodes[n].WaitCounts > 0)
+			{
+				SimRunTics (nodes, n, now);
+			}
+		}
+	}
+
+	Printf ("%d nodes, %d tics, extratic %d, latency %d+%d ms, %.1f%% loss, %.1f%% reordered%s\n",
+		numnodes, clock, extratic, *net_simlatency, *net_simjitter, *net_simloss, *net_simreorder,
+		ok ? "" : " -- a node missed too many tics");
+	Printf ("node  ran   lat avg  max  stalls throttled  rreq  rtx  resent  late  packets  bytes\n");
+	for (n = 0; n < numnodes; ++n)
+	{
+		const FSimNode &node = nodes[n];
+		Printf ("%4d %5d %7.1f %5u %7d %9d %5d %4d %7d %5d %8u %6u\n", n, node.GameTic,
+			node.GameTic > 0 ? node.LatencySum / node.GameTic : 0., node.LatencyMax,
+			node.Stalls, node.Throttled, node.ResendRequests, node.Retransmits, node.Resent, node.Late,
+			node.PacketsSent, unsigned(node.BytesSent / MAX<DWORD>(node.PacketsSent, 1)));
+	}
+}
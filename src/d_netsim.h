@@ -0,0 +1,45 @@
+#ifndef __D_NETSIM_H__
+#define __D_NETSIM_H__
+
+#include "doomtype.h"
+#include "tarray.h"
+#include "d_net.h"
+
+// Delivers packets after a simulated delay, losing and reordering some
+class FNetSimQueue
+{
+public:
+	FNetSimQueue ();
+
+	void Clear ();
+	void Configure (int latency, int jitter, float loss, float reorder, DWORD seed);
+	bool Push (DWORD now, int node, const BYTE *data, int len);
+	bool Pop (DWORD now, int &node, BYTE *data, int &len);
+	unsigned int Size () const { return Packets.Size(); }
+
+	DWORD Sent, Dropped, Reordered;
+
+private:
+	struct FPacket
+	{
+		DWORD Time;
+		DWORD Seq;
+		int Node;
+		TArray<BYTE> Data;
+	};
+
+	TArray<FPacket> Packets;
+	DWORD LastTime[MAXNETNODES];		// Latest delivery per node, to keep the order
+	DWORD NextSeq;
+	DWORD Seed;
+	int Latency, Jitter;
+	float Loss, Reorder;
+
+	DWORD Random ();
+};
+
+bool NetSim_Active ();
+void NetSim_Send ();
+void NetSim_Flush ();
+
+#endif //__D_NETSIM_H__
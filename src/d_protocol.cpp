@@ -345,6 +345,245 @@ int WriteUserCmdMessage (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream)
 	return 1;
 }
 
+//==========================================================================
+//
+// Bit-packed usercmds
+//
+// Only used between network nodes; demos keep the byte-aligned format
+// above. The fields are written as a bit stream in the same order as
+// PackUserCmd's. If only the angles changed, which is most of the time,
+// the field mask is shortened to two bits. Angles are sent as the
+// difference from the basis in groups of five bits, each followed by a
+// bit that says whether another group follows, so that normal turning
+// needs 6 or 12 bits. Movement is usually either zero or the same as it
+// was, so zero costs a single bit. Button changes are sent as the bits
+// that flipped, in groups of seven.
+//
+//==========================================================================
+
+namespace
+{
+	struct FBitWriter
+	{
+		BYTE *Out;
+		int Bits;		// Bits used in the current byte
+
+		FBitWriter (BYTE *out) : Out(out), Bits(8) {}
+
+		void Write (DWORD value, int count)
+		{
+			while (count-- > 0)
+			{
+				if (Bits == 8)
+				{
+					*++Out = 0;
+					Bits = 0;
+				}
+				*Out |= ((value >> count) & 1) << (7 - Bits);
+				Bits++;
+			}
+		}
+
+		void WriteGroups (DWORD value, int groupbits)
+		{
+			for (;;)
+			{
+				Write (value, groupbits);
+				value >>= groupbits;
+				Write (value != 0, 1);
+				if (value == 0)
+				{
+					break;
+				}
+			}
+		}
+	};
+
+	struct FBitReader
+	{
+		const BYTE *In;
+		int Bits;
+
+		FBitReader (const BYTE *in) : In(in), Bits(8) {}
+
+		DWORD Read (int count)
+		{
+			DWORD value = 0;
+			while (count-- > 0)
+			{
+				if (Bits == 8)
+				{
+					++In;
+					Bits = 0;
+				}
+				value = (value << 1) | ((*In >> (7 - Bits)) & 1);
+				Bits++;
+			}
+			return value;
+		}
+
+		DWORD ReadGroups (int groupbits)
+		{
+			DWORD value = 0;
+			for (int shift = 0; shift < 32; shift += groupbits)
+			{
+				value |= Read (groupbits) << shift;
+				if (!Read (1))
+				{
+					break;
+				}
+			}
+			return value;
+		}
+	};
+}
+
+static inline DWORD ZigZag (short delta)
+{
+	return (delta < 0) ? ((DWORD(~delta) << 1) | 1) : DWORD(delta) << 1;
+}
+
+static inline short UnZigZag (DWORD v)
+{
+	return (v & 1) ? short(~(v >> 1)) : short(v >> 1);
+}
+
+static void PackAngle (FBitWriter &bits, short value, short basis)
+{
+	bits.WriteGroups (ZigZag (short(value - basis)), 5);
+}
+
+static short UnpackAngle (FBitReader &bits, short basis)
+{
+	return short(basis + UnZigZag (bits.ReadGroups (5)));
+}
+
+static void PackMove (FBitWriter &bits, short value)
+{
+	bits.Write (value == 0, 1);
+	if (value != 0)
+	{
+		bits.Write (WORD(value), 16);
+	}
+}
+
+static short UnpackMove (FBitReader &bits)
+{
+	return bits.Read (1) ? 0 : short(bits.Read (16));
+}
+
+// Returns the number of bytes written
+int PackNetUserCmd (const usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream)
+{
+	usercmd_t blank;
+	BYTE flags = 0;
+
+	if (basis == NULL)
+	{
+		memset (&blank, 0, sizeof(blank));
+		basis = &blank;
+	}
+	if (ucmd->buttons != basis->buttons)			flags |= UCMDF_BUTTONS;
+	if (ucmd->pitch != basis->pitch)				flags |= UCMDF_PITCH;
+	if (ucmd->yaw != basis->yaw)					flags |= UCMDF_YAW;
+	if (ucmd->forwardmove != basis->forwardmove)	flags |= UCMDF_FORWARDMOVE;
+	if (ucmd->sidemove != basis->sidemove)			flags |= UCMDF_SIDEMOVE;
+	if (ucmd->upmove != basis->upmove)				flags |= UCMDF_UPMOVE;
+	if (ucmd->roll != basis->roll)					flags |= UCMDF_ROLL;
+
+	// The writer advances before storing each byte.
+	FBitWriter bits (*stream - 1);
+
+	if (!(flags & ~(UCMDF_PITCH|UCMDF_YAW)))
+	{
+		bits.Write (1, 1);
+		bits.Write (!!(flags & UCMDF_PITCH), 1);
+		bits.Write (!!(flags & UCMDF_YAW), 1);
+	}
+	else
+	{
+		bits.Write (0, 1);
+		bits.Write (flags, 7);
+	}
+	if (flags & UCMDF_BUTTONS)		bits.WriteGroups (ucmd->buttons ^ basis->buttons, 7);
+	if (flags & UCMDF_PITCH)		PackAngle (bits, ucmd->pitch, basis->pitch);
+	if (flags & UCMDF_YAW)			PackAngle (bits, ucmd->yaw, basis->yaw);
+	if (flags & UCMDF_FORWARDMOVE)	PackMove (bits, ucmd->forwardmove);
+	if (flags & UCMDF_SIDEMOVE)		PackMove (bits, ucmd->sidemove);
+	if (flags & UCMDF_UPMOVE)		PackMove (bits, ucmd->upmove);
+	if (flags & UCMDF_ROLL)			PackAngle (bits, ucmd->roll, basis->roll);
+
+	int len = int(bits.Out + 1 - *stream);
+	*stream = bits.Out + 1;
+	return len;
+}
+
+// Returns the number of bytes read. ucmd may be NULL to skip the command.
+int UnpackNetUserCmd (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream)
+{
+	usercmd_t scratch;
+	BYTE flags;
+
+	if (ucmd == NULL)
+	{
+		ucmd = &scratch;
+		basis = NULL;
+	}
+	if (basis == NULL)
+	{
+		memset (ucmd, 0, sizeof(usercmd_t));
+	}
+	else if (basis != ucmd)
+	{
+		memcpy (ucmd, basis, sizeof(usercmd_t));
+	}
+
+	FBitReader bits (*stream - 1);
+
+	if (bits.Read (1))
+	{
+		flags = bits.Read (1) ? UCMDF_PITCH : 0;
+		flags |= bits.Read (1) ? UCMDF_YAW : 0;
+	}
+	else
+	{
+		flags = BYTE(bits.Read (7));
+	}
+	if (flags & UCMDF_BUTTONS)		ucmd->buttons ^= bits.ReadGroups (7);
+	if (flags & UCMDF_PITCH)		ucmd->pitch = UnpackAngle (bits, ucmd->pitch);
+	if (flags & UCMDF_YAW)			ucmd->yaw = UnpackAngle (bits, ucmd->yaw);
+	if (flags & UCMDF_FORWARDMOVE)	ucmd->forwardmove = UnpackMove (bits);
+	if (flags & UCMDF_SIDEMOVE)		ucmd->sidemove = UnpackMove (bits);
+	if (flags & UCMDF_UPMOVE)		ucmd->upmove = UnpackMove (bits);
+	if (flags & UCMDF_ROLL)			ucmd->roll = UnpackAngle (bits, ucmd->roll);
+
+	int len = int(bits.In + 1 - *stream);
+	*stream = (BYTE *)bits.In + 1;
+	return len;
+}
+
+DWORD NetUserCmdBytes, NetUserCmdUnpackedBytes;
+
+int WriteNetUserCmdMessage (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream)
+{
+	BYTE *start = *stream;
+	BYTE scratch[32];
+	BYTE *old = scratch;
+
+	// For packetstats, see what the demo format would have needed.
+	NetUserCmdUnpackedBytes += WriteUserCmdMessage (ucmd, basis, &old);
+	if (scratch[0] == DEM_EMPTYUSERCMD)
+	{
+		WriteByte (DEM_EMPTYUSERCMD, stream);
+	}
+	else
+	{
+		WriteByte (DEM_NETUSERCMD, stream);
+		PackNetUserCmd (ucmd, basis, stream);
+	}
+	NetUserCmdBytes += int(*stream - start);
+	return int(*stream - start);
+}
 
 int SkipTicCmd (BYTE **stream, int count)
 {
@@ -385,6 +624,11 @@ int SkipTicCmd (BYTE **stream, int count)
 				}
 				flow += skip;
 			}
+			else if (type == DEM_NETUSERCMD)
+			{
+				moreticdata = false;
+				UnpackNetUserCmd (NULL, NULL, &flow);
+			}
 			else if (type == DEM_EMPTYUSERCMD)
 			{
 				moreticdata = false;
@@ -417,7 +661,7 @@ void ReadTicCmd (BYTE **stream, int player, int tic)
 
 	start = *stream;
 
-	while ((type = ReadByte (stream)) != DEM_USERCMD && type != DEM_EMPTYUSERCMD)
+	while ((type = ReadByte (stream)) != DEM_USERCMD && type != DEM_NETUSERCMD && type != DEM_EMPTYUSERCMD)
 		Net_SkipCommand (type, stream);
 
 	NetSpecs[player][ticmod].SetData (start, int(*stream - start - 1));
@@ -427,6 +671,11 @@ void ReadTicCmd (BYTE **stream, int player, int tic)
 		UnpackUserCmd (&tcmd->ucmd,
 			tic ? &netcmds[player][(tic-1)%BACKUPTICS].ucmd : NULL, stream);
 	}
+	else if (type == DEM_NETUSERCMD)
+	{
+		UnpackNetUserCmd (&tcmd->ucmd,
+			tic ? &netcmds[player][(tic-1)%BACKUPTICS].ucmd : NULL, stream);
+	}
 	else
 	{
 		if (tic)
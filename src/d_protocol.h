@@ -49,6 +49,8 @@
 #define BODY_ID		BIGE_ID('B','O','D','Y')
 #define NETD_ID		BIGE_ID('N','E','T','D')
 #define WEAP_ID		BIGE_ID('W','E','A','P')
+#define BCHK_ID		BIGE_ID('B','C','H','K')
+#define BIDX_ID		BIGE_ID('B','I','D','X')
 
 #define	ANGLE2SHORT(x)	((((x)/360) & 65535)
 #define	SHORT2ANGLE(x)	((x)*360)
@@ -165,6 +167,8 @@ enum EDemoCommand
 	DEM_REVERTCAMERA,	// 66
 	DEM_SETSLOTPNUM,	// 67 Byte: player number, the rest is the same as DEM_SETSLOT
 	DEM_REMOVE,	// 68
+	DEM_SYNCHASH,		// 69 Long: tic, Longs: actor, RNG, sector and ACS hashes
+	DEM_NETUSERCMD,		// 70 Player movement, bit-packed. Only sent over the network.
 };
 
 // The following are implemented by cht_DoCheat in m_cheat.cpp
@@ -232,6 +236,11 @@ void SkipChunk (BYTE **stream);
 int UnpackUserCmd (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
 int PackUserCmd (const usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
 int WriteUserCmdMessage (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
+int UnpackNetUserCmd (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
+int PackNetUserCmd (const usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
+int WriteNetUserCmdMessage (usercmd_t *ucmd, const usercmd_t *basis, BYTE **stream);
+
+extern DWORD NetUserCmdBytes, NetUserCmdUnpackedBytes;
 
 struct ticcmd_t;
 
@@ -57,7 +57,8 @@ ClassReg DObject::RegistrationInfo =
 	NULL,							// ParentType
 	sizeof(DObject),				// SizeOf
 	NULL,							// Pointers
-	&DObject::InPlaceConstructor	// ConstructNative
+	&DObject::InPlaceConstructor,	// ConstructNative
+	false							// OverridesSubstitution
 };
 _DECLARE_TI(DObject)
 
@@ -374,7 +375,7 @@ void DObject::InPlaceConstructor (void *mem)
 DObject::DObject ()
 : Class(0), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = (GC::CurrentWhite & OF_WhiteBits) | OF_Young;
 	ObjNext = GC::Root;
 	GC::Root = this;
 }
@@ -382,7 +383,7 @@ DObject::DObject ()
 DObject::DObject (PClass *inClass)
 : Class(inClass), ObjectFlags(0)
 {
-	ObjectFlags = GC::CurrentWhite & OF_WhiteBits;
+	ObjectFlags = (GC::CurrentWhite & OF_WhiteBits) | OF_Young;
 	ObjNext = GC::Root;
 	GC::Root = this;
 }
@@ -413,9 +414,17 @@ DObject::~DObject ()
 				{
 					GC::SweepPos = probe;
 				}
+				if (this == GC::OldHead)
+				{
+					GC::OldHead = ObjNext;
+				}
 				break;
 			}
 		}
+		if (ObjectFlags & OF_Remembered)
+		{
+			GC::Forget(this);
+		}
 
 		// If it's gray, also unlink it from the gray list.
 		if (this->IsGray())
@@ -486,10 +495,27 @@ size_t DObject::StaticPointerSubstitution (DObject *old, DObject *notOld)
 	size_t changed = 0;
 	int i;
 
-	// Go through all objects.
+	if (old == NULL)
+	{
+		return 0;
+	}
+
+	// Go through all objects. Classes that declare no pointers cannot
+	// reference anything, so skip them without a virtual call, unless
+	// they handle the substitution themselves.
 	for (probe = GC::Root; probe != NULL; probe = probe->ObjNext)
 	{
-		changed += probe->PointerSubstitution(old, notOld);
+		const PClass *info = probe->GetClass();
+		const size_t *offsets = info->FlatPointers;
+		if (offsets == NULL)
+		{
+			const_cast<PClass *>(info)->BuildFlatPointers();
+			offsets = info->FlatPointers;
+		}
+		if (*offsets != ~(size_t)0 || info->bOverridesSubstitution)
+		{
+			changed += probe->PointerSubstitution(old, notOld);
+		}
 	}
 
 	// Go through the bodyque.
@@ -532,9 +558,69 @@ size_t DObject::StaticPointerSubstitution (DObject *old, DObject *notOld)
 	if (bglobal.body1.p == (AActor *)old)			bglobal.body1 = (AActor *)notOld, ++changed;
 	if (bglobal.body2.p == (AActor *)old)			bglobal.body2 = (AActor *)notOld, ++changed;
 
+	// The object pointers were changed without write barriers.
+	if (changed != 0)
+	{
+		GC::NurseryBarrier(notOld);
+	}
 	return changed;
 }
 
+//==========================================================================
+//
+// CCMD subbench
+//
+// Times StaticPointerSubstitution against a walk that calls
+// PointerSubstitution for every object. The object being replaced is a
+// new one that nothing points to, so neither of them changes anything.
+//
+//==========================================================================
+
+CCMD (subbench)
+{
+	const int passes = 20;
+	DObject *unused = new DObject;
+	DObject *probe;
+	cycle_t reftime, opttime;
+	size_t changed = 0;
+	int objects = 0, skipped = 0;
+
+	for (probe = GC::Root; probe != NULL; probe = probe->ObjNext)
+	{
+		const PClass *info = probe->GetClass();
+		if (info->FlatPointers == NULL)
+		{
+			const_cast<PClass *>(info)->BuildFlatPointers();
+		}
+		if (*info->FlatPointers == ~(size_t)0 && !info->bOverridesSubstitution)
+		{
+			skipped++;
+		}
+		objects++;
+	}
+
+	reftime.Reset();
+	opttime.Reset();
+	for (int i = 0; i < passes; i++)
+	{
+		reftime.Clock();
+		for (probe = GC::Root; probe != NULL; probe = probe->ObjNext)
+		{
+			changed += probe->PointerSubstitution(unused, NULL);
+		}
+		reftime.Unclock();
+
+		opttime.Clock();
+		changed += DObject::StaticPointerSubstitution(unused, NULL);
+		opttime.Unclock();
+	}
+	unused->Destroy();
+
+	Printf ("%d objects, %d without pointers, %d pointers changed\n", objects, skipped, (int)changed);
+	Printf ("all objects: %2.3f ms, StaticPointerSubstitution: %2.3f ms per call\n",
+		reftime.TimeMS() / passes, opttime.TimeMS() / passes);
+}
+
 void DObject::SerializeUserVars(FArchive &arc)
 {
 	PSymbolTable *symt;
@@ -142,10 +142,17 @@ struct ClassReg
 	unsigned int SizeOf;
 	const size_t *Pointers;
 	void (*ConstructNative)(void *);
+	bool OverridesSubstitution;
 
 	void RegisterClass() const;
 };
 
+// Tells whether a class overrides DObject::PointerSubstitution. The address
+// of an inherited member function is a pointer to a member of the class
+// that declared it.
+template<class F> struct TOverridesSubstitution { enum { Value = true }; };
+template<class R, class A1, class A2> struct TOverridesSubstitution<R (DObject::*)(A1, A2)> { enum { Value = false }; };
+
 enum EInPlace { EC_InPlace };
 
 #define DECLARE_ABSTRACT_CLASS(cls,parent) \
@@ -185,7 +192,8 @@ private: \
 		RUNTIME_CLASS(cls::Super), \
 		sizeof(cls), \
 		ptrs, \
-		create }; \
+		create, \
+		TOverridesSubstitution<decltype(&cls::PointerSubstitution)>::Value }; \
 	_DECLARE_TI(cls)
 
 #define _IMP_CREATE_OBJ(cls) \
@@ -227,6 +235,8 @@ enum EObjectFlags
 	OF_JustSpawned		= 1 << 8,		// Thinker was spawned this tic
 	OF_SerialSuccess	= 1 << 9,		// For debugging Serialize() calls
 	OF_Sentinel			= 1 << 10,		// Object is serving as the sentinel in a ring list
+	OF_Young			= 1 << 11,		// Object was allocated since the last collection
+	OF_Remembered		= 1 << 12,		// Old object that may point to young objects
 };
 
 template<class T> class TObjPtr;
@@ -238,10 +248,12 @@ namespace GC
 		GCS_Pause,
 		GCS_Propagate,
 		GCS_Sweep,
-		GCS_Finalize
+		GCS_Finalize,
+		GCS_Minor
 	};
 
-	// Number of bytes currently allocated through M_Malloc/M_Realloc.
+	// Number of bytes currently allocated through M_Malloc/M_Realloc and
+	// the object pools.
 	extern size_t AllocBytes;
 
 	// Amount of memory to allocate before triggering a collection.
@@ -253,6 +265,10 @@ namespace GC
 	// List of every object.
 	extern DObject *Root;
 
+	// First object in Root that is not part of the nursery. All young
+	// objects are found before it.
+	extern DObject *OldHead;
+
 	// Current white value for potentially-live objects.
 	extern uint32 CurrentWhite;
 
@@ -268,6 +284,12 @@ namespace GC
 	// Size of GC steps.
 	extern int StepMul;
 
+	// Amount of memory to allocate between minor collections. 0 disables them.
+	extern size_t NurserySize;
+
+	// Amount of memory to allocate before triggering a minor collection.
+	extern size_t MinorThreshold;
+
 	// Current white value for known-dead objects.
 	static inline uint32 OtherWhite()
 	{
@@ -292,6 +314,28 @@ namespace GC
 	// Handles a write barrier for a pointer that isn't inside an object.
 	static inline void WriteBarrier(DObject *pointed);
 
+	// Promotes a young object that gets stored in a pointer whose owner
+	// is not known.
+	static inline void NurseryBarrier(DObject *pointed);
+
+	// Adds an old object to the remembered set for the next minor collection.
+	void Remember(DObject *obj);
+
+	// Removes an object from the remembered set before it gets freed.
+	void Forget(DObject *obj);
+
+	// Turns a young object into an old one that is never collected by minor
+	// collections.
+	void Promote(DObject *obj);
+
+	// Collects the objects allocated since the last collection.
+	void MinorCollect();
+
+	// Allocates and frees the memory for objects. Small objects come from
+	// pools of equally sized blocks.
+	void *AllocObject(size_t len);
+	void FreeObject(void *mem);
+
 	// Handles a read barrier.
 	template<class T> inline T *ReadBarrier(T *&obj)
 	{
@@ -307,6 +351,8 @@ namespace GC
 	{
 		if (AllocBytes >= Threshold)
 			Step();
+		else if (AllocBytes >= MinorThreshold)
+			MinorCollect();
 	}
 
 	// Forces a collection to start now.
@@ -343,8 +389,10 @@ namespace GC
 }
 
 // A template class to help with handling read barriers. It does not
-// handle write barriers, because those can be handled more efficiently
-// with knowledge of the object that holds the pointer.
+// handle write barriers for the incremental collector, because those can
+// be handled more efficiently with knowledge of the object that holds the
+// pointer. Young objects get promoted though, because without knowing the
+// holder, a minor collection could not find them.
 template<class T>
 class TObjPtr
 {
@@ -367,9 +415,17 @@ public:
 	}
 	T *operator=(T *q) throw()
 	{
-		return p = q;
+		p = q;
+		GC::NurseryBarrier(o);
+		return q;
 		// The caller must now perform a write barrier.
 	}
+	TObjPtr<T> &operator=(const TObjPtr<T> &q) throw()
+	{
+		p = q.p;
+		GC::NurseryBarrier(o);
+		return *this;
+	}
 	operator T*() throw()
 	{
 		return GC::ReadBarrier(p);
@@ -475,7 +531,8 @@ public:
 
 	// If you need to replace one object with another and want to
 	// change any pointers from the old object to the new object,
-	// use this method.
+	// use this method. StaticPointerSubstitution only calls it for
+	// objects whose class declares at least one pointer or overrides it.
 	virtual size_t PointerSubstitution (DObject *old, DObject *notOld);
 	static size_t StaticPointerSubstitution (DObject *old, DObject *notOld);
 
@@ -497,12 +554,12 @@ public:
 
 	void *operator new(size_t len)
 	{
-		return M_Malloc(len);
+		return GC::AllocObject(len);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	// GC fiddling
@@ -569,23 +626,47 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		GC::FreeObject (mem);
 	}
 };
 
 static inline void GC::WriteBarrier(DObject *pointing, DObject *pointed)
 {
-	if (pointed != NULL && pointed->IsWhite() && pointing->IsBlack())
+	if (pointed != NULL)
 	{
-		Barrier(pointing, pointed);
+		if (pointed->IsWhite() && pointing->IsBlack())
+		{
+			Barrier(pointing, pointed);
+		}
+		else if ((pointed->ObjectFlags & OF_Young) && !(pointing->ObjectFlags & (OF_Young | OF_Remembered)))
+		{
+			Remember(pointing);
+		}
 	}
 }
 
 static inline void GC::WriteBarrier(DObject *pointed)
 {
-	if (pointed != NULL && State == GCS_Propagate && pointed->IsWhite())
+	if (pointed != NULL)
+	{
+		if (State == GCS_Propagate && pointed->IsWhite())
+		{
+			Barrier(NULL, pointed);
+		}
+		// We don't know what points to this object, so it can't be left
+		// for a minor collection to decide about.
+		else if (pointed->ObjectFlags & OF_Young)
+		{
+			Promote(pointed);
+		}
+	}
+}
+
+static inline void GC::NurseryBarrier(DObject *pointed)
+{
+	if (pointed != NULL && (pointed->ObjectFlags & OF_Young))
 	{
-		Barrier(NULL, pointed);
+		Promote(pointed);
 	}
 }
 
@@ -58,6 +58,7 @@
 
 #include "dobject.h"
 #include "templates.h"
+#include "i_system.h"
 #include "b_bot.h"
 #include "p_local.h"
 #include "g_game.h"
@@ -96,6 +97,13 @@
 */
 #define DEFAULT_GCMUL		400 // GC runs 'quadruple the speed' of memory allocation
 
+/*
+@@ DEFAULT_GCNURSERY defines how much memory may be allocated between minor
+@* collections, which only collect objects allocated since the previous
+@* collection. 0 disables them.
+*/
+#define DEFAULT_GCNURSERY	(256*1024)
+
 // Number of sectors to mark for each step.
 #define SECTORSTEPSIZE	32
 #define POLYSTEPSIZE 120
@@ -106,6 +114,13 @@
 #define GCSWEEPCOST		10
 #define GCFINALIZECOST	100
 
+// Objects up to POOL_MAXSIZE bytes are allocated from slabs of blocks of
+// the same size. Sizes are rounded up to POOL_GRANULARITY.
+#define POOL_GRANULARITY	16
+#define POOL_MAXSIZE		4096
+#define POOL_NUMCLASSES		(POOL_MAXSIZE / POOL_GRANULARITY)
+#define POOL_SLABSIZE		(64*1024)
+
 // TYPES -------------------------------------------------------------------
 
 // This object is responsible for marking sectors during the propagate
@@ -123,6 +138,37 @@ public:
 };
 IMPLEMENT_CLASS(DSectorMarker)
 
+// Every object is preceded by one of these. Slab is NULL for objects that
+// are too large for the pools and were allocated with M_Malloc. NextFree
+// links the free blocks of a slab together.
+struct FObjectSlab;
+struct FObjectBlock
+{
+	FObjectSlab *Slab;
+	FObjectBlock *NextFree;
+};
+
+// A single allocation from the system that is carved up into blocks of the
+// same size. Slabs that have free blocks are linked into their pool.
+struct FObjectSlab
+{
+	FObjectSlab *Next, *Prev;
+	FObjectBlock *FreeList;
+	unsigned SizeClass;
+	unsigned NumBlocks;
+	unsigned NumUsed;
+};
+
+// Size of a slab's header, rounded so that its blocks stay aligned.
+#define SLABHEADERSIZE	((sizeof(FObjectSlab) + POOL_GRANULARITY - 1) & ~(size_t)(POOL_GRANULARITY - 1))
+
+struct FObjectPool
+{
+	FObjectSlab *Partial;	// Slabs with at least one free block
+	unsigned NumSlabs;
+	unsigned NumUsed;
+};
+
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -142,6 +188,7 @@ size_t Threshold;
 size_t Estimate;
 DObject *Gray;
 DObject *Root;
+DObject *OldHead;
 DObject *SoftRoots;
 DObject **SweepPos;
 DWORD CurrentWhite = OF_White0 | OF_Fixed;
@@ -150,11 +197,32 @@ int Pause = DEFAULT_GCPAUSE;
 int StepMul = DEFAULT_GCMUL;
 int StepCount;
 size_t Dept;
+size_t NurserySize = DEFAULT_GCNURSERY;
+size_t MinorThreshold;
+int MinorCount;
+int MinorFreed;
+int MinorKept;
+size_t MinorBytes;
+cycle_t MinorCycles;
 
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 static DSectorMarker *SectorMarker;
 
+// Old objects that had a pointer to a young object stored in them since
+// the last collection. It is a hash set so that objects can be removed
+// quickly when they get deleted.
+static TMap<DObject *, bool> Remembered;
+
+// Set while a minor collection marks the root set. Old objects reached
+// from there are not marked, but they have their own pointers scanned.
+static bool ScanOld;
+
+static FObjectPool Pools[POOL_NUMCLASSES];
+static size_t PoolBytes;
+static int PoolAllocs;
+static int PoolLarge;
+
 // CODE --------------------------------------------------------------------
 
 //==========================================================================
@@ -168,6 +236,7 @@ static DSectorMarker *SectorMarker;
 void SetThreshold()
 {
 	Threshold = (Estimate / 100) * Pause;
+	MinorThreshold = NurserySize == 0 ? ~(size_t)0 : AllocBytes + NurserySize;
 }
 
 //==========================================================================
@@ -228,12 +297,21 @@ static DObject **SweepList(DObject **p, size_t count, size_t *finalize_count)
 		{
 			assert(!curr->IsDead() || (curr->ObjectFlags & OF_Fixed));
 			curr->MakeWhite();	// make it white (for next cycle)
+			curr->ObjectFlags &= ~OF_Young;
 			p = &curr->ObjNext;
 		}
 		else	// must erase 'curr'
 		{
 			assert(curr->IsDead());
 			*p = curr->ObjNext;
+			if (curr == OldHead)
+			{
+				OldHead = curr->ObjNext;
+			}
+			if (curr->ObjectFlags & OF_Remembered)
+			{
+				Forget(curr);
+			}
 			if (!(curr->ObjectFlags & OF_EuthanizeMe))
 			{	// The object must be destroyed before it can be finalized.
 				// Note that thinkers must already have been destroyed. If they get here without
@@ -279,22 +357,31 @@ void Mark(DObject **obj)
 		}
 		else if (lobj->IsWhite())
 		{
-			lobj->White2Gray();
-			lobj->GCNext = Gray;
-			Gray = lobj;
+			if (State != GCS_Minor || (lobj->ObjectFlags & OF_Young))
+			{
+				lobj->White2Gray();
+				lobj->GCNext = Gray;
+				Gray = lobj;
+			}
+			else if (ScanOld)
+			{
+				ScanOld = false;
+				lobj->PropagateMark();
+				ScanOld = true;
+			}
 		}
 	}
 }
 
 //==========================================================================
 //
-// MarkRoot
+// MarkRootSet
 //
 // Mark the root set of objects.
 //
 //==========================================================================
 
-static void MarkRoot()
+static void MarkRootSet()
 {
 	int i;
 
@@ -333,6 +420,8 @@ static void MarkRoot()
 	else
 	{
 		SectorMarker->SecNum = 0;
+		SectorMarker->PolyNum = 0;
+		SectorMarker->SideNum = 0;
 	}
 	Mark(SectorMarker);
 	Mark(interpolator.Head);
@@ -356,6 +445,19 @@ static void MarkRoot()
 			}
 		}
 	}
+}
+
+//==========================================================================
+//
+// MarkRoot
+//
+// Starts a new collection.
+//
+//==========================================================================
+
+static void MarkRoot()
+{
+	MarkRootSet();
 	// Time to propagate the marks.
 	State = GCS_Propagate;
 	StepCount = 0;
@@ -377,6 +479,15 @@ static void Atomic()
 	SweepPos = &Root;
 	State = GCS_Sweep;
 	Estimate = AllocBytes;
+	// Everything that gets swept will be old afterwards.
+	OldHead = Root;
+	TMapIterator<DObject *, bool> it(Remembered);
+	TMap<DObject *, bool>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		pair->Key->ObjectFlags &= ~OF_Remembered;
+	}
+	Remembered.Clear();
 }
 
 //==========================================================================
@@ -531,6 +642,356 @@ void Barrier(DObject *pointing, DObject *pointed)
 	{
 		pointing->MakeWhite();
 	}
+	if (pointing != NULL && (pointed->ObjectFlags & OF_Young) &&
+		!(pointing->ObjectFlags & (OF_Young | OF_Remembered)))
+	{
+		Remember(pointing);
+	}
+}
+
+//==========================================================================
+//
+// Remember
+//
+// Adds an old object to the remembered set. Its pointers will be scanned
+// by the next minor collection.
+//
+//==========================================================================
+
+void Remember(DObject *obj)
+{
+	obj->ObjectFlags |= OF_Remembered;
+	Remembered[obj] = true;
+}
+
+//==========================================================================
+//
+// Forget
+//
+// Removes an object from the remembered set.
+//
+//==========================================================================
+
+void Forget(DObject *obj)
+{
+	Remembered.Remove(obj);
+	obj->ObjectFlags &= ~OF_Remembered;
+}
+
+//==========================================================================
+//
+// Promote
+//
+// Makes a young object old, so that only a full collection can free it.
+//
+//==========================================================================
+
+void Promote(DObject *obj)
+{
+	obj->ObjectFlags &= ~OF_Young;
+	if (!(obj->ObjectFlags & OF_Remembered))
+	{
+		Remember(obj);
+	}
+}
+
+//==========================================================================
+//
+// SweepNursery
+//
+// Frees all young objects that were not marked by a minor collection and
+// makes the survivors old.
+//
+//==========================================================================
+
+static void SweepNursery()
+{
+	DObject **p = &Root;
+	DObject *curr;
+
+	while ((curr = *p) != NULL && curr != OldHead)
+	{
+		if (!(curr->ObjectFlags & OF_Young) || !curr->IsWhite() || (curr->ObjectFlags & OF_Fixed))
+		{
+			if (curr->ObjectFlags & OF_Young)
+			{
+				curr->ObjectFlags &= ~OF_Young;
+				MinorKept++;
+			}
+			curr->MakeWhite();
+			p = &curr->ObjNext;
+		}
+		else
+		{
+			*p = curr->ObjNext;
+			if (!(curr->ObjectFlags & OF_EuthanizeMe))
+			{
+				curr->Destroy();
+			}
+			curr->ObjectFlags |= OF_Cleanup;
+			delete curr;
+			MinorFreed++;
+		}
+	}
+	OldHead = Root;
+}
+
+//==========================================================================
+//
+// MarkYoungThinkers
+//
+// All thinkers that have not been destroyed are alive because they are in
+// a thinker list. The lists are linked with plain pointers, so instead of
+// scanning them, the young thinkers are found at the start of the object
+// list.
+//
+//==========================================================================
+
+static void MarkYoungThinkers()
+{
+	for (DObject *curr = Root; curr != NULL && curr != OldHead; curr = curr->ObjNext)
+	{
+		if ((curr->ObjectFlags & OF_Young) && !(curr->ObjectFlags & OF_EuthanizeMe) &&
+			curr->IsKindOf(RUNTIME_CLASS(DThinker)))
+		{
+			DObject *thinker = curr;
+			Mark(&thinker);
+		}
+	}
+}
+
+//==========================================================================
+//
+// MinorCollect
+//
+// Collects only the objects allocated since the last collection. Old
+// objects are neither marked nor swept. Instead, the young objects they
+// point to are found through:
+// - the root set, which is scanned every time,
+// - the young thinkers, which are alive as long as they are in a thinker list,
+// - the remembered set, which the write barriers fill.
+//
+// Pointers in old objects that don't go through a write barrier are:
+// - TObjPtr assignments. TObjPtr promotes any young object stored in it.
+// - The thinker list links, which are covered by the young thinkers.
+// - Pointers changed by FArchive and StaticPointerSubstitution. The latter
+//   promotes the replacement, and objects loaded from an archive are
+//   reachable from the root set or the young thinkers they were loaded with.
+// - DSBarInfo's ammo and armor pointers, which point to items that are
+//   also in their owner's inventory chain.
+// The plain pointer lists of ACS scripts and sound sequences have explicit
+// write barriers.
+//
+// Minor collections are not incremental, so they are only done while the
+// main collector is paused.
+//
+//==========================================================================
+
+void MinorCollect()
+{
+	if (State != GCS_Pause || NurserySize == 0 || PClass::bShutdown)
+	{
+		MinorThreshold = NurserySize == 0 ? ~(size_t)0 : AllocBytes + NurserySize;
+		return;
+	}
+
+	size_t old = AllocBytes;
+
+	MinorCycles.Reset();
+	MinorCycles.Clock();
+	MinorFreed = MinorKept = 0;
+	State = GCS_Minor;
+
+	ScanOld = true;
+	MarkRootSet();
+	ScanOld = false;
+	MarkYoungThinkers();
+
+	TMap<DObject *, bool> remembered;
+	remembered.TransferFrom(Remembered);
+	TMapIterator<DObject *, bool> it(remembered);
+	TMap<DObject *, bool>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		DObject *obj = pair->Key;
+		obj->ObjectFlags &= ~OF_Remembered;
+		if (!(obj->ObjectFlags & OF_EuthanizeMe))
+		{
+			obj->PropagateMark();
+		}
+	}
+	PropagateAll();
+	SweepNursery();
+
+	State = GCS_Pause;
+	MinorCount++;
+	MinorBytes = old > AllocBytes ? old - AllocBytes : 0;
+	MinorThreshold = AllocBytes + NurserySize;
+	MinorCycles.Unclock();
+}
+
+//==========================================================================
+//
+// PoolBlockSize
+//
+// Returns the number of bytes a block of the given size class takes up,
+// including its header.
+//
+//==========================================================================
+
+static inline size_t PoolBlockSize(unsigned sizeclass)
+{
+	return (sizeclass + 1) * POOL_GRANULARITY + sizeof(FObjectBlock);
+}
+
+//==========================================================================
+//
+// NewSlab
+//
+// Allocates a new slab for a pool and puts all of its blocks on its free
+// list. The slab itself is not counted in AllocBytes; only the blocks that
+// are handed out are.
+//
+//==========================================================================
+
+static FObjectSlab *NewSlab(unsigned sizeclass)
+{
+	size_t blocksize = PoolBlockSize(sizeclass);
+	unsigned count = unsigned((POOL_SLABSIZE - SLABHEADERSIZE) / blocksize);
+	size_t size = SLABHEADERSIZE + count * blocksize;
+
+	FObjectSlab *slab = (FObjectSlab *)malloc(size);
+	if (slab == NULL)
+	{
+		I_FatalError("Could not allocate %zu bytes for object pool", size);
+	}
+	slab->Next = slab->Prev = NULL;
+	slab->SizeClass = sizeclass;
+	slab->NumBlocks = count;
+	slab->NumUsed = 0;
+
+	// Link the blocks in address order, so they are handed out that way.
+	BYTE *mem = (BYTE *)slab + SLABHEADERSIZE;
+	FObjectBlock *next = NULL;
+	for (unsigned i = count; i-- > 0; )
+	{
+		FObjectBlock *block = (FObjectBlock *)(mem + i * blocksize);
+		block->Slab = slab;
+		block->NextFree = next;
+		next = block;
+	}
+	slab->FreeList = next;
+	PoolBytes += size;
+	Pools[sizeclass].NumSlabs++;
+	return slab;
+}
+
+//==========================================================================
+//
+// AllocObject
+//
+// Allocates memory for an object. Objects of the same size share slabs,
+// so this is normally just a free list pop.
+//
+//==========================================================================
+
+void *AllocObject(size_t len)
+{
+	FObjectBlock *block;
+	unsigned sizeclass = unsigned((MAX<size_t>(len, 1) - 1) / POOL_GRANULARITY);
+
+	if (sizeclass >= POOL_NUMCLASSES)
+	{
+		block = (FObjectBlock *)M_Malloc(sizeof(FObjectBlock) + len);
+		block->Slab = NULL;
+		PoolLarge++;
+		return block + 1;
+	}
+
+	FObjectPool *pool = &Pools[sizeclass];
+	FObjectSlab *slab = pool->Partial;
+	if (slab == NULL)
+	{
+		slab = pool->Partial = NewSlab(sizeclass);
+	}
+	block = slab->FreeList;
+	slab->FreeList = block->NextFree;
+	slab->NumUsed++;
+	if (slab->FreeList == NULL)
+	{ // Slab is full, so take it off the list.
+		pool->Partial = slab->Next;
+		if (slab->Next != NULL)
+		{
+			slab->Next->Prev = NULL;
+		}
+		slab->Next = NULL;
+	}
+	pool->NumUsed++;
+	PoolAllocs++;
+	AllocBytes += PoolBlockSize(sizeclass);
+	return block + 1;
+}
+
+//==========================================================================
+//
+// FreeObject
+//
+// Returns an object's memory to its slab. A slab that becomes empty is
+// released, unless it is the only one left in the pool with free blocks.
+//
+//==========================================================================
+
+void FreeObject(void *mem)
+{
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	FObjectBlock *block = (FObjectBlock *)mem - 1;
+	FObjectSlab *slab = block->Slab;
+
+	if (slab == NULL)
+	{
+		M_Free(block);
+		return;
+	}
+
+	FObjectPool *pool = &Pools[slab->SizeClass];
+	if (slab->FreeList == NULL)
+	{ // Slab was full, so put it back on the list.
+		slab->Prev = NULL;
+		slab->Next = pool->Partial;
+		if (pool->Partial != NULL)
+		{
+			pool->Partial->Prev = slab;
+		}
+		pool->Partial = slab;
+	}
+	block->NextFree = slab->FreeList;
+	slab->FreeList = block;
+	slab->NumUsed--;
+	pool->NumUsed--;
+	AllocBytes -= PoolBlockSize(slab->SizeClass);
+
+	if (slab->NumUsed == 0 && (slab->Prev != NULL || slab->Next != NULL))
+	{
+		if (slab->Prev != NULL)
+		{
+			slab->Prev->Next = slab->Next;
+		}
+		else
+		{
+			pool->Partial = slab->Next;
+		}
+		if (slab->Next != NULL)
+		{
+			slab->Next->Prev = slab->Prev;
+		}
+		PoolBytes -= SLABHEADERSIZE + slab->NumBlocks * PoolBlockSize(slab->SizeClass);
+		pool->NumSlabs--;
+		free(slab);
+	}
 }
 
 void DelSoftRootHead()
@@ -564,7 +1025,7 @@ void AddSoftRoot(DObject *obj)
 		// it at the end of the object list, so we know that anything
 		// before it is not a soft root.
 		SoftRoots = new DObject;
-		SoftRoots->ObjectFlags |= OF_Fixed;
+		SoftRoots->ObjectFlags = (SoftRoots->ObjectFlags & ~OF_Young) | OF_Fixed;
 		probe = &Root;
 		while (*probe != NULL)
 		{
@@ -581,9 +1042,25 @@ void AddSoftRoot(DObject *obj)
 		probe = &(*probe)->ObjNext;
 	}
 	*probe = (*probe)->ObjNext;
+	if (obj == OldHead)
+	{
+		OldHead = obj->ObjNext;
+	}
 	obj->ObjNext = SoftRoots->ObjNext;
 	SoftRoots->ObjNext = obj;
 	obj->ObjectFlags |= OF_Rooted;
+	// The soft roots are behind OldHead, where SweepNursery never gets to,
+	// so the object must be old before a minor collection can mark it.
+	// Promoting it also remembers it, so the next minor collection still
+	// scans the young objects it points to.
+	if (obj->ObjectFlags & OF_Young)
+	{
+		Promote(obj);
+		if (State == GCS_Pause)
+		{
+			obj->MakeWhite();
+		}
+	}
 	WriteBarrier(obj);
 }
 
@@ -618,71 +1095,139 @@ void DelSoftRoot(DObject *obj)
 	}
 }
 
-}
-
 //==========================================================================
 //
-// DSectorMarker :: PropagateMark
+// CheckHeap
 //
-// Propagates marks across a few sectors and reinserts itself into the
-// gray list if it didn't do them all.
+// Does a minor collection followed by a full one and checks what each of
+// them relies on the other to leave behind:
+// - After the minor collection, everything behind OldHead must be old and
+//   white. A marked object there would not be scanned by the next full
+//   collection, so the old objects only it points to would be freed.
+// - After the full collection, no object may still point to an object
+//   that has been freed.
+// Returns the number of problems found.
 //
 //==========================================================================
 
-size_t DSectorMarker::PropagateMark()
+static int CheckHeap()
 {
-	int i;
-	int marked = 0;
-	bool moretodo = false;
+	DObject *curr;
+	int errors = 0;
 
-	if (sectors != NULL)
+	if (State != GCS_Pause)
 	{
-		for (i = 0; i < SECTORSTEPSIZE && SecNum + i < numsectors; ++i)
-		{
-			sector_t *sec = &sectors[SecNum + i];
-			GC::Mark(sec->SoundTarget);
-			GC::Mark(sec->SkyBoxes[sector_t::ceiling]);
-			GC::Mark(sec->SkyBoxes[sector_t::floor]);
-			GC::Mark(sec->SecActTarget);
-			GC::Mark(sec->floordata);
-			GC::Mark(sec->ceilingdata);
-			GC::Mark(sec->lightingdata);
-			for(int j=0;j<4;j++) GC::Mark(sec->interpolations[j]);
-		}
-		marked += i * sizeof(sector_t);
-		if (SecNum + i < numsectors)
+		FullGC();
+	}
+	MinorCollect();
+	for (curr = OldHead; curr != NULL; curr = curr->ObjNext)
+	{
+		if ((curr->ObjectFlags & OF_Young) || !curr->IsWhite())
 		{
-			SecNum += i;
-			moretodo = true;
+			Printf("%s is %s after a minor collection\n", curr->GetClass()->TypeName.GetChars(),
+				(curr->ObjectFlags & OF_Young) ? "young" : "marked");
+			errors++;
 		}
 	}
-	if (!moretodo && polyobjs != NULL)
+
+	FullGC();
+	TMap<DObject *, bool> alive;
+	for (curr = Root; curr != NULL; curr = curr->ObjNext)
+	{
+		alive[curr] = true;
+	}
+	for (curr = Root; curr != NULL; curr = curr->ObjNext)
 	{
-		for (i = 0; i < POLYSTEPSIZE && PolyNum + i < po_NumPolyobjs; ++i)
+		const size_t *offsets = curr->GetClass()->FlatPointers;
+		if (offsets == NULL)
 		{
-			GC::Mark(polyobjs[PolyNum + i].interpolation);
+			continue;
 		}
-		marked += i * sizeof(FPolyObj);
-		if (PolyNum + i < po_NumPolyobjs)
+		for (; *offsets != ~(size_t)0; offsets++)
 		{
-			PolyNum += i;
-			moretodo = true;
+			DObject *pointed = *(DObject **)((BYTE *)curr + *offsets);
+			if (pointed != NULL && alive.CheckKey(pointed) == NULL)
+			{
+				Printf("%s points to a freed object\n", curr->GetClass()->TypeName.GetChars());
+				errors++;
+			}
 		}
 	}
-	if (!moretodo && sides != NULL)
+	return errors;
+}
+
+}
+
+//==========================================================================
+//
+// DSectorMarker :: PropagateMark
+//
+// Propagates marks across a few sectors and reinserts itself into the
+// gray list if it didn't do them all.
+//
+//==========================================================================
+
+size_t DSectorMarker::PropagateMark()
+{
+	int i;
+	int marked = 0;
+	bool moretodo;
+
+	// Minor collections are not incremental, so they do everything at once.
+	do
 	{
-		for (i = 0; i < SIDEDEFSTEPSIZE && SideNum + i < numsides; ++i)
+		moretodo = false;
+		if (sectors != NULL)
+		{
+			for (i = 0; i < SECTORSTEPSIZE && SecNum + i < numsectors; ++i)
+			{
+				sector_t *sec = &sectors[SecNum + i];
+				GC::Mark(sec->SoundTarget);
+				GC::Mark(sec->SkyBoxes[sector_t::ceiling]);
+				GC::Mark(sec->SkyBoxes[sector_t::floor]);
+				GC::Mark(sec->SecActTarget);
+				GC::Mark(sec->floordata);
+				GC::Mark(sec->ceilingdata);
+				GC::Mark(sec->lightingdata);
+				for(int j=0;j<4;j++) GC::Mark(sec->interpolations[j]);
+			}
+			marked += i * sizeof(sector_t);
+			if (SecNum + i < numsectors)
+			{
+				SecNum += i;
+				moretodo = true;
+			}
+		}
+		if (!moretodo && polyobjs != NULL)
 		{
-			side_t *side = &sides[SideNum + i];
-			for(int j=0;j<3;j++) GC::Mark(side->textures[j].interpolation);
+			for (i = 0; i < POLYSTEPSIZE && PolyNum + i < po_NumPolyobjs; ++i)
+			{
+				GC::Mark(polyobjs[PolyNum + i].interpolation);
+			}
+			marked += i * sizeof(FPolyObj);
+			if (PolyNum + i < po_NumPolyobjs)
+			{
+				PolyNum += i;
+				moretodo = true;
+			}
 		}
-		marked += i * sizeof(side_t);
-		if (SideNum + i < numsides)
+		if (!moretodo && sides != NULL)
 		{
-			SideNum += i;
-			moretodo = true;
+			for (i = 0; i < SIDEDEFSTEPSIZE && SideNum + i < numsides; ++i)
+			{
+				side_t *side = &sides[SideNum + i];
+				for(int j=0;j<3;j++) GC::Mark(side->textures[j].interpolation);
+			}
+			marked += i * sizeof(side_t);
+			if (SideNum + i < numsides)
+			{
+				SideNum += i;
+				moretodo = true;
+			}
 		}
 	}
+	while (moretodo && GC::State == GC::GCS_Minor);
+
 	// If there are more sectors to mark, put ourself back into the gray
 	// list.
 	if (moretodo)
@@ -708,7 +1253,8 @@ ADD_STAT(gc)
 		"  Pause  ",
 		"Propagate",
 		"  Sweep  ",
-		"Finalize " };
+		"Finalize ",
+		"  Minor  " };
 	FString out;
 	out.Format("[%s] Alloc:%6zuK  Thresh:%6zuK  Est:%6zuK  Steps: %d",
 		StateStrings[GC::State],
@@ -720,6 +1266,39 @@ ADD_STAT(gc)
 	{
 		out.AppendFormat("  %zuK", (GC::Dept + 1023) >> 10);
 	}
+	if (GC::NurserySize != 0)
+	{
+		out.AppendFormat("\nMinor: %d  Freed:%5d (%zuK)  Promoted:%5d  Time: %.2f ms",
+			GC::MinorCount,
+			GC::MinorFreed,
+			(GC::MinorBytes + 1023) >> 10,
+			GC::MinorKept,
+			GC::MinorCycles.TimeMS());
+	}
+	return out;
+}
+
+//==========================================================================
+//
+// STAT objpool
+//
+// Shows how much memory the object pools use.
+//
+//==========================================================================
+
+ADD_STAT(objpool)
+{
+	unsigned slabs = 0, used = 0, classes = 0;
+	for (int i = 0; i < POOL_NUMCLASSES; ++i)
+	{
+		slabs += GC::Pools[i].NumSlabs;
+		used += GC::Pools[i].NumUsed;
+		classes += GC::Pools[i].NumSlabs != 0;
+	}
+	FString out;
+	out.Format("Objects:%6u  Sizes:%4u  Slabs:%5u (%zuK)  Allocs: %d  Large: %d",
+		used, classes, slabs, (GC::PoolBytes + 1023) >> 10,
+		GC::PoolAllocs, GC::PoolLarge);
 	return out;
 }
 
@@ -735,7 +1314,7 @@ CCMD(gc)
 {
 	if (argv.argc() == 1)
 	{
-		Printf ("Usage: gc stop|now|full|pause [size]|stepmul [size]\n");
+		Printf ("Usage: gc stop|now|full|minor|check|pause [size]|stepmul [size]|nursery [size]\n");
 		return;
 	}
 	if (stricmp(argv[1], "stop") == 0)
@@ -750,6 +1329,15 @@ CCMD(gc)
 	{
 		GC::FullGC();
 	}
+	else if (stricmp(argv[1], "minor") == 0)
+	{
+		GC::MinorCollect();
+	}
+	else if (stricmp(argv[1], "check") == 0)
+	{
+		int errors = GC::CheckHeap();
+		Printf ("%d problem%s found\n", errors, errors == 1 ? "" : "s");
+	}
 	else if (stricmp(argv[1], "pause") == 0)
 	{
 		if (argv.argc() == 2)
@@ -772,4 +1360,16 @@ CCMD(gc)
 			GC::StepMul = MAX(100, atoi(argv[2]));
 		}
 	}
+	else if (stricmp(argv[1], "nursery") == 0)
+	{
+		if (argv.argc() == 2)
+		{
+			Printf ("Current GC nursery size is %zuK\n", GC::NurserySize >> 10);
+		}
+		else
+		{
+			GC::NurserySize = (size_t)MAX(0, atoi(argv[2])) << 10;
+			GC::MinorThreshold = GC::NurserySize == 0 ? ~(size_t)0 : GC::AllocBytes + GC::NurserySize;
+		}
+	}
 }
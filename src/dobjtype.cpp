@@ -191,6 +191,7 @@ void ClassReg::RegisterClass () const
 	MyClass->Size = SizeOf;
 	MyClass->Pointers = Pointers;
 	MyClass->ConstructNative = ConstructNative;
+	MyClass->bOverridesSubstitution = OverridesSubstitution;
 	MyClass->InsertIntoHash ();
 }
 
@@ -255,7 +256,7 @@ const PClass *PClass::FindClass (FName zaname)
 // Create a new object that this class represents
 DObject *PClass::CreateNew () const
 {
-	BYTE *mem = (BYTE *)M_Malloc (Size);
+	BYTE *mem = (BYTE *)GC::AllocObject (Size);
 	assert (mem != NULL);
 
 	// Set this object's defaults before constructing it.
@@ -316,6 +317,7 @@ PClass *PClass::CreateDerivedClass (FName name, unsigned int size)
 
 	type->FlatPointers = NULL;
 	type->bRuntimeClass = true;
+	type->bOverridesSubstitution = bOverridesSubstitution;
 	type->ActorInfo = NULL;
 	type->Symbols.SetParentTable (&this->Symbols);
 	if (!notnew) type->InsertIntoHash();
@@ -397,6 +399,7 @@ const PClass *PClass::FindClassTentative (FName name)
 	type->Defaults = NULL;
 	type->FlatPointers = NULL;
 	type->bRuntimeClass = true;
+	type->bOverridesSubstitution = bOverridesSubstitution;
 	type->ActorInfo = NULL;
 	type->InsertIntoHash();
 	return type;
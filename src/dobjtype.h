@@ -138,6 +138,7 @@ struct PClass
 	FMetaTable			 Meta;
 	BYTE				*Defaults;
 	bool				 bRuntimeClass;	// class was defined at run-time, not compile-time
+	bool				 bOverridesSubstitution;	// class has its own PointerSubstitution
 	unsigned short		 ClassIndex;
 	PSymbolTable		 Symbols;
 
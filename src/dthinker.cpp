@@ -43,6 +43,9 @@
 
 static cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
+extern cycle_t ActorMoveCycles;
+extern int ActorMoveCount;
+extern bool ActorMoveTiming;
 extern int BotWTG;
 
 IMPLEMENT_CLASS (DThinker)
@@ -406,8 +409,13 @@ void DThinker::RunThinkers ()
 
 	ThinkCycles.Reset();
 	BotSupportCycles.Reset();
+	ActorMoveCycles.Reset();
+	ActorMoveCount = 0;
 	BotWTG = 0;
 
+	static FStat *movementstat = FStat::FindStat("movement");
+	ActorMoveTiming = movementstat != NULL && movementstat->isActive();
+
 	ThinkCycles.Clock();
 
 	// Tick every thinker left from last time
@@ -41,6 +41,7 @@
 #include <string.h>
 #include <zlib.h>
 #include <stdlib.h>
+#include <thread>
 
 #include "doomtype.h"
 #include "farchive.h"
@@ -53,6 +54,8 @@
 #include "d_player.h"
 #include "m_misc.h"
 #include "dobject.h"
+#include "stats.h"
+#include "m_workerpool.h"
 
 // These are special tokens found in the data stream of an archive.
 // Whenever a new object is encountered, it gets created using new and
@@ -126,10 +129,6 @@ static inline void SWAP_FLOAT(float &x)
 }
 #endif
 
-// Output buffer size for compression; need some extra space.
-// I assume the description in zlib.h is accurate.
-#define OUT_LEN(a)		((a) + (a) / 1000 + 12)
-
 void FCompressedFile::BeEmpty ()
 {
 	m_Pos = 0;
@@ -326,30 +325,240 @@ FFile &FCompressedFile::Seek (int pos, ESeekPos ofs)
 
 CVAR (Bool, nofilecompression, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
+//==========================================================================
+//
+// Save payload codecs
+//
+// Every codec produces a standard zlib stream, so saves written with any
+// of them load with plain uncompress(). Large buffers are split into blocks
+// that are deflated in parallel and stitched back into one stream the way
+// pigz does it: each block but the last ends on a sync flush, and the
+// Adler-32 checksums of the blocks are combined for the trailer.
+//
+//==========================================================================
+
+struct FSaveCodec
+{
+	const char *Name;
+	int Level;			// zlib level; 0 stores the data as-is
+};
+
+static const FSaveCodec SaveCodecs[] =
+{
+	{ "zlib",	Z_DEFAULT_COMPRESSION },
+	{ "fast",	Z_BEST_SPEED },
+	{ "best",	Z_BEST_COMPRESSION },
+	{ "store",	0 },
+};
+
+CUSTOM_CVAR (Int, save_codec, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 0 || self >= (int)countof(SaveCodecs))
+		self = 0;
+}
+
+// 0 = one per hardware thread
+CUSTOM_CVAR (Int, save_threads, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 0)
+		self = 0;
+}
+
+int M_NumSaveCodecs ()
+{
+	return countof(SaveCodecs);
+}
+
+const char *M_SaveCodecName (int codec)
+{
+	return SaveCodecs[codec].Name;
+}
+
+int M_SaveCodecLevel (int codec)
+{
+	return SaveCodecs[codec].Level;
+}
+
+int M_SaveCompressionLevel ()
+{
+	return nofilecompression ? 0 : SaveCodecs[save_codec].Level;
+}
+
+int M_SaveCompressionThreads ()
+{
+	if (save_threads > 0)
+	{
+		return save_threads;
+	}
+	return MAX<int> (1, std::thread::hardware_concurrency());
+}
+
+enum { DEFLATE_BLOCKSIZE = 256*1024 };
+
+struct FDeflateBlock
+{
+	const Bytef *In;
+	uLong InLen;
+	Bytef *Out;
+	uLong OutLen;
+	uLong Adler;
+	bool Last;
+	bool Ok;
+};
+
+static void DeflateBlock (FDeflateBlock &block, int level)
+{
+	z_stream stream;
+	int r;
+
+	memset (&stream, 0, sizeof(stream));
+	block.Ok = false;
+	block.Adler = adler32 (adler32 (0, Z_NULL, 0), block.In, block.InLen);
+	if (deflateInit2 (&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return;
+	}
+	stream.next_in = (Bytef *)block.In;
+	stream.avail_in = block.InLen;
+	stream.next_out = block.Out;
+	stream.avail_out = block.OutLen;
+	r = deflate (&stream, block.Last ? Z_FINISH : Z_SYNC_FLUSH);
+	block.OutLen = stream.total_out;
+	if (block.Last)
+	{
+		block.Ok = r == Z_STREAM_END;
+	}
+	else
+	{
+		block.Ok = r == Z_OK && stream.avail_in == 0 && stream.avail_out != 0;
+	}
+	deflateEnd (&stream);
+}
+
+struct FDeflateJob
+{
+	FDeflateBlock *Blocks;
+	int Level;
+};
+
+static void DeflateBlocks (unsigned int index, int thread, void *data)
+{
+	FDeflateJob *job = (FDeflateJob *)data;
+	DeflateBlock (job->Blocks[index], job->Level);
+}
+
+//==========================================================================
+//
+// M_DeflateBound
+//
+// Size of the output buffer M_DeflateBuffer needs in the worst case.
+//
+//==========================================================================
+
+unsigned int M_DeflateBound (unsigned int len)
+{
+	return (unsigned int)compressBound (len) + (len / DEFLATE_BLOCKSIZE + 1) * 16;
+}
+
+//==========================================================================
+//
+// M_DeflateBuffer
+//
+// Compresses in into a zlib stream at out using up to threads threads.
+// Returns the compressed size, or 0 if it did not fit. Uses nothing but
+// malloc, zlib and the worker pool, so it may be called from any thread.
+//
+//==========================================================================
+
+unsigned int M_DeflateBuffer (BYTE *out, unsigned int outlen, const BYTE *in, unsigned int len,
+	int level, int threads)
+{
+	int numblocks = (len + DEFLATE_BLOCKSIZE - 1) / DEFLATE_BLOCKSIZE;
+	int i;
+
+	if (threads <= 1 || numblocks <= 1)
+	{
+		uLongf size = outlen;
+		if (compress2 (out, &size, in, len, level) != Z_OK)
+		{
+			return 0;
+		}
+		return (unsigned int)size;
+	}
+
+	FDeflateBlock *blocks = new FDeflateBlock[numblocks];
+	bool ok = true;
+
+	for (i = 0; i < numblocks; ++i)
+	{
+		blocks[i].In = in + i * DEFLATE_BLOCKSIZE;
+		blocks[i].InLen = MIN<unsigned int> (DEFLATE_BLOCKSIZE, len - i * DEFLATE_BLOCKSIZE);
+		blocks[i].OutLen = compressBound (blocks[i].InLen) + 16;
+		blocks[i].Out = (Bytef *)malloc (blocks[i].OutLen);
+		blocks[i].Last = i == numblocks - 1;
+		blocks[i].Ok = false;
+		ok = ok && blocks[i].Out != NULL;
+	}
+
+	if (ok)
+	{
+		FDeflateJob job = { blocks, level };
+		WorkerPool.Run (MIN (threads, numblocks), numblocks, DeflateBlocks, &job);
+	}
+
+	// Stitch the blocks together between a zlib header and trailer.
+	uLong adler = adler32 (0, Z_NULL, 0);
+	unsigned int pos = 2;
+
+	ok = ok && outlen >= 6;
+	if (ok)
+	{
+		out[0] = 0x78;
+		out[1] = 0x9c;
+	}
+	for (i = 0; i < numblocks; ++i)
+	{
+		ok = ok && blocks[i].Ok && pos + blocks[i].OutLen + 4 <= outlen;
+		if (ok)
+		{
+			memcpy (out + pos, blocks[i].Out, blocks[i].OutLen);
+			pos += blocks[i].OutLen;
+			adler = adler32_combine (adler, blocks[i].Adler, blocks[i].InLen);
+		}
+		if (blocks[i].Out != NULL)
+		{
+			free (blocks[i].Out);
+		}
+	}
+	delete[] blocks;
+
+	if (!ok)
+	{
+		return 0;
+	}
+	out[pos++] = BYTE(adler >> 24);
+	out[pos++] = BYTE(adler >> 16);
+	out[pos++] = BYTE(adler >> 8);
+	out[pos++] = BYTE(adler);
+	return pos;
+}
+
 void FCompressedFile::Implode ()
 {
 	uLong outlen;
 	uLong len = m_BufferSize;
 	Byte *compressed = NULL;
 	BYTE *oldbuf = m_Buffer;
-	int r;
+	int level = M_SaveCompressionLevel ();
 
-	if (!nofilecompression && !m_NoCompress)
+	if (level != 0 && !m_NoCompress)
 	{
-		outlen = OUT_LEN(len);
-		do
-		{
-			compressed = new Bytef[outlen];
-			r = compress (compressed, &outlen, m_Buffer, len);
-			if (r == Z_BUF_ERROR)
-			{
-				delete[] compressed;
-				outlen += 1024;
-			}
-		} while (r == Z_BUF_ERROR);
+		outlen = M_DeflateBound (len);
+		compressed = new Bytef[outlen];
+		outlen = M_DeflateBuffer (compressed, outlen, m_Buffer, len, level, M_SaveCompressionThreads ());
 
 		// If the data could not be compressed, store it as-is.
-		if (r != Z_OK || outlen >= len)
+		if (outlen == 0 || outlen >= len)
 		{
 			DPrintf ("cfile could not be compressed\n");
 			outlen = 0;
@@ -583,6 +792,97 @@ void FCompressedMemFile::GetSizes(unsigned int &compressed, unsigned int &uncomp
 	}
 }
 
+//==========================================================================
+//
+// FCompressedMemFile :: GetStoredData
+//
+// Returns the contents of a file that was closed after StoreUncompressed,
+// or NULL if it holds compressed data.
+//
+//==========================================================================
+
+const BYTE *FCompressedMemFile::GetStoredData (unsigned int &len) const
+{
+	if (m_ImplodedBuffer == NULL || ((DWORD *)m_ImplodedBuffer)[0] != 0)
+	{
+		len = 0;
+		return NULL;
+	}
+	len = BigLong(((DWORD *)m_ImplodedBuffer)[1]);
+	return m_ImplodedBuffer + 8;
+}
+
+//==========================================================================
+//
+// FCompressedMemFile :: WritePNGChunk								static
+//
+// Writes a PNG chunk holding header's data followed by body in the form
+// Serialize stores it, compressing body on the way. Both files must have
+// been closed with StoreUncompressed set. level and threads are as for
+// M_DeflateBuffer. Only malloc and stdio are used, so this may run on a
+// thread other than the game's.
+//
+//==========================================================================
+
+bool FCompressedMemFile::WritePNGChunk (FILE *file, DWORD id, const FCompressedMemFile &header,
+	const FCompressedMemFile &body, int level, int threads, unsigned int *packedsize)
+{
+	unsigned int headlen, len;
+	const BYTE *head = header.GetStoredData (headlen);
+	const BYTE *data = body.GetStoredData (len);
+	Bytef *compressed = NULL;
+	uLong outlen = 0;
+
+	if (head == NULL || data == NULL)
+	{
+		return false;
+	}
+	if (level != 0)
+	{
+		outlen = M_DeflateBound (len);
+		compressed = (Bytef *)malloc (outlen);
+		if (compressed != NULL)
+		{
+			outlen = M_DeflateBuffer (compressed, (unsigned int)outlen, data, len, level, threads);
+		}
+		// If the data could not be compressed, store it as-is.
+		if (compressed == NULL || outlen >= len)
+		{
+			outlen = 0;
+		}
+	}
+
+	const BYTE *out = outlen != 0 ? compressed : data;
+	unsigned int outsize = outlen != 0 ? (unsigned int)outlen : len;
+	DWORD sizes[2] = { BigLong((unsigned int)outlen), BigLong(len) };
+	DWORD chunk[2] = { BigLong(headlen + 4 + 8 + outsize), id };
+	DWORD crc;
+
+	crc = CalcCRC32 ((BYTE *)&id, 4);
+	crc = AddCRC32 (crc, head, headlen);
+	crc = AddCRC32 (crc, (const BYTE *)ZSig, 4);
+	crc = AddCRC32 (crc, (BYTE *)sizes, 8);
+	crc = AddCRC32 (crc, out, outsize);
+	crc = BigLong((unsigned int)crc);
+
+	bool ok = fwrite (chunk, 8, 1, file) == 1 &&
+		(headlen == 0 || fwrite (head, headlen, 1, file) == 1) &&
+		fwrite (ZSig, 4, 1, file) == 1 &&
+		fwrite (sizes, 8, 1, file) == 1 &&
+		(outsize == 0 || fwrite (out, outsize, 1, file) == 1) &&
+		fwrite (&crc, 4, 1, file) == 1;
+
+	if (compressed != NULL)
+	{
+		free (compressed);
+	}
+	if (packedsize != NULL)
+	{
+		*packedsize = outsize;
+	}
+	return ok;
+}
+
 FPNGChunkFile::FPNGChunkFile (FILE *file, DWORD id)
 	: FCompressedFile (file, EWriting, true, false), m_ChunkID (id)
 {
@@ -684,11 +984,8 @@ void FArchive::AttachToFile (FFile &file)
 		m_TypeMap[i].toCurrent = NULL;
 	}
 	m_ClassCount = 0;
-	for (i = 0; i < EObjectHashSize; i++)
-	{
-		m_ObjectHash[i] = ~0;
-		m_NameHash[i] = NameMap::NO_INDEX;
-	}
+	m_ObjectHash.Clear();
+	m_NameHash.Clear();
 	m_NumSprites = 0;
 	m_SpriteMap = new int[sprites.Size()];
 	for (size_t s = 0; s < sprites.Size(); ++s)
@@ -1340,47 +1637,97 @@ int FArchive::ReadSprite ()
 DWORD FArchive::AddName (const char *name)
 {
 	DWORD index;
-	unsigned int hash = MakeKey (name) % EObjectHashSize;
+	unsigned int hash = MakeKey (name);
 
 	index = FindName (name, hash);
 	if (index == NameMap::NO_INDEX)
 	{
 		DWORD namelen = (DWORD)(strlen (name) + 1);
 		DWORD strpos = (DWORD)m_NameStorage.Reserve (namelen);
-		NameMap mapper = { strpos, (DWORD)m_NameHash[hash] };
+		NameMap mapper = { strpos, (DWORD)hash };
 
 		memcpy (&m_NameStorage[strpos], name, namelen);
-		m_NameHash[hash] = index = (DWORD)m_Names.Push (mapper);
+		index = (DWORD)m_Names.Push (mapper);
+		HashNameIndex (index);
 	}
 	return index;
 }
 
+// Names read from an archive are only ever looked up by their index, so
+// they don't need to go into the hash table.
 DWORD FArchive::AddName (unsigned int start)
 {
-	DWORD hash = MakeKey (&m_NameStorage[start]) % EObjectHashSize;
-	NameMap mapper = { (DWORD)start, (DWORD)m_NameHash[hash] };
-	return (DWORD)(m_NameHash[hash] = m_Names.Push (mapper));
+	NameMap mapper = { (DWORD)start, 0 };
+	return (DWORD)m_Names.Push (mapper);
 }
 
 DWORD FArchive::FindName (const char *name) const
 {
-	return FindName (name, MakeKey (name) % EObjectHashSize);
+	return FindName (name, MakeKey (name));
 }
 
-DWORD FArchive::FindName (const char *name, unsigned int bucket) const
+DWORD FArchive::FindName (const char *name, unsigned int hash) const
 {
-	unsigned int map = m_NameHash[bucket];
+	if (m_NameHash.Size() == 0)
+	{
+		return NameMap::NO_INDEX;
+	}
 
-	while (map != NameMap::NO_INDEX)
+	unsigned int mask = m_NameHash.Size() - 1;
+	for (unsigned int slot = hash & mask; ; slot = (slot + 1) & mask)
 	{
+		DWORD map = m_NameHash[slot];
+		if (map == NameMap::NO_INDEX)
+		{
+			return map;
+		}
 		const NameMap *mapping = &m_Names[map];
-		if (strcmp (name, &m_NameStorage[mapping->StringStart]) == 0)
+		if (mapping->Hash == hash && strcmp (name, &m_NameStorage[mapping->StringStart]) == 0)
 		{
-			return (DWORD)map;
+			return map;
 		}
-		map = mapping->HashNext;
 	}
-	return (DWORD)map;
+}
+
+//==========================================================================
+//
+// FArchive :: HashNameIndex
+//
+// Enters a name into the hash table, growing the table first if it would
+// become more than half full.
+//
+//==========================================================================
+
+void FArchive::HashNameIndex (DWORD index)
+{
+	if ((index + 1) * 2 > m_NameHash.Size())
+	{
+		GrowNameHash ();
+		return;
+	}
+
+	unsigned int mask = m_NameHash.Size() - 1;
+	unsigned int slot = m_Names[index].Hash & mask;
+	while (m_NameHash[slot] != NameMap::NO_INDEX)
+	{
+		slot = (slot + 1) & mask;
+	}
+	m_NameHash[slot] = index;
+}
+
+void FArchive::GrowNameHash ()
+{
+	unsigned int size = MAX<unsigned int> (m_NameHash.Size() * 2, 256);
+
+	m_NameHash.Resize (size);
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		m_NameHash[i] = NameMap::NO_INDEX;
+	}
+	for (unsigned int i = 0; i < m_Names.Size(); ++i)
+	{
+		HashNameIndex (i);
+	}
 }
 
 DWORD FArchive::WriteClass (const PClass *info)
@@ -1400,6 +1747,50 @@ DWORD FArchive::WriteClass (const PClass *info)
 	return m_ClassCount++;
 }
 
+//==========================================================================
+//
+// FindClassIndex
+//
+// Returns the index in PClass::m_Types of the class with the given name,
+// or -1 if there is none. The table is built the first time a class is
+// read, so that loading a level with many new classes does not need to
+// search the whole type list for each of them. If several classes share a
+// name, the last one is used, as the search from the end of the list did.
+// The table is rebuilt if the type list has changed since then.
+//
+//==========================================================================
+
+static TMap<FName, unsigned int> ClassNameTable;
+static unsigned int ClassNameTableSize;
+
+static int FindClassIndex (FName name)
+{
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 1 || ClassNameTableSize != PClass::m_Types.Size())
+		{
+			ClassNameTable.Clear ();
+			for (unsigned int i = 0; i < PClass::m_Types.Size(); ++i)
+			{
+				if (PClass::m_Types[i] != NULL)
+				{
+					ClassNameTable[PClass::m_Types[i]->TypeName] = i;
+				}
+			}
+			ClassNameTableSize = PClass::m_Types.Size();
+		}
+		unsigned int *index = ClassNameTable.CheckKey (name);
+		if (index != NULL && *index < PClass::m_Types.Size() &&
+			PClass::m_Types[*index] != NULL && PClass::m_Types[*index]->TypeName == name)
+		{
+			return int(*index);
+		}
+		// The type list may have been rebuilt with the same size,
+		// so try again with a fresh table before giving up.
+	}
+	return -1;
+}
+
 const PClass *FArchive::ReadClass ()
 {
 	struct String {
@@ -1417,15 +1808,13 @@ const PClass *FArchive::ReadClass ()
 	FName zaname(typeName.val, true);
 	if (zaname != NAME_None)
 	{
-		for (unsigned int i = PClass::m_Types.Size(); i-- > 0; )
+		int i = FindClassIndex (zaname);
+		if (i >= 0)
 		{
-			if (PClass::m_Types[i]->TypeName == zaname)
-			{
-				m_TypeMap[i].toArchive = m_ClassCount;
-				m_TypeMap[m_ClassCount].toCurrent = PClass::m_Types[i];
-				m_ClassCount++;
-				return PClass::m_Types[i];
-			}
+			m_TypeMap[i].toArchive = m_ClassCount;
+			m_TypeMap[m_ClassCount].toCurrent = PClass::m_Types[i];
+			m_ClassCount++;
+			return PClass::m_Types[i];
 		}
 	}
 	I_Error ("Unknown class '%s'\n", typeName.val);
@@ -1471,34 +1860,88 @@ DWORD FArchive::MapObject (const DObject *obj)
 		m_ObjectMap = (ObjectMap *)M_Realloc (m_ObjectMap, sizeof(ObjectMap)*m_MaxObjectCount);
 		for (i = m_ObjectCount; i < m_MaxObjectCount; i++)
 		{
-			m_ObjectMap[i].hashNext = ~0;
 			m_ObjectMap[i].object = NULL;
 		}
 	}
 
 	DWORD index = m_ObjectCount++;
-	DWORD hash = HashObject (obj);
 
 	m_ObjectMap[index].object = obj;
-	m_ObjectMap[index].hashNext = m_ObjectHash[hash];
-	m_ObjectHash[hash] = index;
-
+	if (m_Storing)
+	{
+		HashObjectIndex (index);
+	}
 	return index;
 }
 
 DWORD FArchive::HashObject (const DObject *obj) const
 {
-	return (DWORD)((size_t)obj % EObjectHashSize);
+	// The lowest bits of an object's address are always the same, so
+	// mix all of them together instead of using it directly.
+	QWORD addr = (QWORD)(size_t)obj;
+	DWORD hash = (DWORD)((addr >> 4) ^ (addr >> 32)) * 0x9E3779B1u;
+	return hash ^ (hash >> 16);
+}
+
+//==========================================================================
+//
+// FArchive :: HashObjectIndex
+//
+// Enters an object into the hash table, growing the table first if it
+// would become more than half full. If the object is already in the
+// table, the newer index replaces it.
+//
+//==========================================================================
+
+void FArchive::HashObjectIndex (DWORD index)
+{
+	if ((index + 1) * 2 > m_ObjectHash.Size())
+	{
+		GrowObjectHash ();
+		return;
+	}
+
+	const DObject *obj = m_ObjectMap[index].object;
+	unsigned int mask = m_ObjectHash.Size() - 1;
+	unsigned int slot = HashObject (obj) & mask;
+	while (m_ObjectHash[slot] != TypeMap::NO_INDEX && m_ObjectMap[m_ObjectHash[slot]].object != obj)
+	{
+		slot = (slot + 1) & mask;
+	}
+	m_ObjectHash[slot] = index;
+}
+
+void FArchive::GrowObjectHash ()
+{
+	unsigned int size = MAX<unsigned int> (m_ObjectHash.Size() * 2, 2048);
+
+	m_ObjectHash.Resize (size);
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		m_ObjectHash[i] = TypeMap::NO_INDEX;
+	}
+	for (DWORD i = 0; i < m_ObjectCount; ++i)
+	{
+		HashObjectIndex (i);
+	}
 }
 
 DWORD FArchive::FindObjectIndex (const DObject *obj) const
 {
-	DWORD index = m_ObjectHash[HashObject (obj)];
-	while (index != TypeMap::NO_INDEX && m_ObjectMap[index].object != obj)
+	if (m_ObjectHash.Size() == 0)
 	{
-		index = m_ObjectMap[index].hashNext;
+		return TypeMap::NO_INDEX;
+	}
+
+	unsigned int mask = m_ObjectHash.Size() - 1;
+	for (unsigned int slot = HashObject (obj) & mask; ; slot = (slot + 1) & mask)
+	{
+		DWORD index = m_ObjectHash[slot];
+		if (index == TypeMap::NO_INDEX || m_ObjectMap[index].object == obj)
+		{
+			return index;
+		}
 	}
-	return index;
 }
 
 void FArchive::UserWriteClass (const PClass *type)
@@ -1586,3 +2029,75 @@ FArchive &operator<< (FArchive &arc, side_t *&side)
 {
 	return arc.SerializePointer (sides, (BYTE **)&side, sizeof(*sides));
 }
+
+//==========================================================================
+//
+// CCMD archivebench
+//
+// Writes lots of objects and names to an archive and reads them back, to
+// see how the object and name tables scale. Every object and name is
+// written twice, so the second time only a reference is stored.
+//
+//==========================================================================
+
+CCMD (archivebench)
+{
+	int count = argv.argc() > 1 ? MAX(1, atoi(argv[1])) : 100000;
+	TArray<DObject *> objects(count);
+	FCompressedMemFile file;
+	cycle_t savetime, loadtime;
+	unsigned int compressed, uncompressed;
+	char name[16];
+	int i, pass;
+
+	for (i = 0; i < count; ++i)
+	{
+		objects.Push (new DObject);
+	}
+
+	savetime.Reset();
+	savetime.Clock();
+	file.Open ();
+	{
+		FArchive arc (file);
+		for (pass = 0; pass < 2; ++pass)
+		{
+			for (i = 0; i < count; ++i)
+			{
+				mysnprintf (name, countof(name), "Name%d", i);
+				arc << objects[i];
+				arc.WriteName (name);
+			}
+		}
+	}
+	savetime.Unclock();
+	file.GetSizes (compressed, uncompressed);
+
+	loadtime.Reset();
+	loadtime.Clock();
+	file.Reopen ();
+	{
+		FArchive arc (file);
+		for (pass = 0; pass < 2; ++pass)
+		{
+			for (i = 0; i < count; ++i)
+			{
+				DObject *obj;
+				arc << obj;
+				arc.ReadName ();
+				if (pass == 1)
+				{
+					obj->Destroy ();
+				}
+			}
+		}
+	}
+	loadtime.Unclock();
+
+	for (i = 0; i < count; ++i)
+	{
+		objects[i]->Destroy ();
+	}
+	Printf ("%d objects: save %.2f ms, load %.2f ms, %u bytes (%u uncompressed)\n",
+		count, savetime.TimeMS(), loadtime.TimeMS(), compressed, uncompressed);
+}
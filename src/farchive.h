@@ -124,7 +124,13 @@ public:
 	bool IsOpen () const;
 	void GetSizes(unsigned int &one, unsigned int &two) const;
 
+	// Call after Open() to make Close() keep the data uncompressed.
+	void StoreUncompressed () { m_NoCompress = true; }
+	const BYTE *GetStoredData (unsigned int &len) const;
+
 	void Serialize (FArchive &arc);
+	static bool WritePNGChunk (FILE *file, DWORD id, const FCompressedMemFile &header,
+		const FCompressedMemFile &body, int level, int threads, unsigned int *packedsize = NULL);
 
 protected:
 	bool FreeOnExplode () { return !m_SourceFromMem; }
@@ -146,6 +152,16 @@ private:
 	DWORD m_ChunkID;
 };
 
+// Compression of save and snapshot payloads
+int M_NumSaveCodecs ();
+const char *M_SaveCodecName (int codec);
+int M_SaveCodecLevel (int codec);
+int M_SaveCompressionLevel ();
+int M_SaveCompressionThreads ();
+unsigned int M_DeflateBound (unsigned int len);
+unsigned int M_DeflateBuffer (BYTE *out, unsigned int outlen, const BYTE *in, unsigned int len,
+	int level, int threads);
+
 class FArchive
 {
 public:
@@ -201,8 +217,6 @@ inline	FArchive& operator<< (bool &b) { return operator<< ((BYTE &)b); }
 inline  FArchive& operator<< (DObject* &object) { return ReadObject (object, RUNTIME_CLASS(DObject)); }
 
 protected:
-		enum { EObjectHashSize = 137 };
-
 		DWORD FindObjectIndex (const DObject *obj) const;
 		DWORD MapObject (const DObject *obj);
 		DWORD WriteClass (const PClass *info);
@@ -210,10 +224,14 @@ protected:
 		const PClass *ReadClass (const PClass *wanttype);
 		const PClass *ReadStoredClass (const PClass *wanttype);
 		DWORD HashObject (const DObject *obj) const;
+		void HashObjectIndex (DWORD index);
+		void GrowObjectHash ();
 		DWORD AddName (const char *name);
 		DWORD AddName (unsigned int start);	// Name has already been added to storage
 		DWORD FindName (const char *name) const;
-		DWORD FindName (const char *name, unsigned int bucket) const;
+		DWORD FindName (const char *name, unsigned int hash) const;
+		void HashNameIndex (DWORD index);
+		void GrowNameHash ();
 
 		bool m_Persistent;		// meant for persistent storage (disk)?
 		bool m_Loading;			// extracting objects?
@@ -235,19 +253,23 @@ protected:
 		struct ObjectMap
 		{
 			const DObject *object;
-			DWORD hashNext;
 		} *m_ObjectMap;
-		DWORD m_ObjectHash[EObjectHashSize];
+
+		// Open addressing tables of indices into m_ObjectMap and m_Names,
+		// using linear probing. Their sizes are powers of two, and they are
+		// grown before they get more than half full. They are only needed
+		// for storing, since loading looks everything up by index.
+		TArray<DWORD> m_ObjectHash;
 
 		struct NameMap
 		{
 			DWORD StringStart;	// index into m_NameStorage
-			DWORD HashNext;		// next in hash bucket
+			DWORD Hash;			// MakeKey of the name
 			enum { NO_INDEX = 0xffffffff };
 		};
 		TArray<NameMap> m_Names;
 		TArray<char> m_NameStorage;
-		unsigned int m_NameHash[EObjectHashSize];
+		TArray<DWORD> m_NameHash;
 
 		int *m_SpriteMap;
 		size_t m_NumSprites;
@@ -62,6 +62,10 @@ void FParser::NextToken()
 {
 	if(Tokens[NumTokens-1][0] || TokenType[NumTokens-1]==string_)
     {
+		if(NumTokens >= T_MAXTOKENS)
+		{
+			script_error("too many tokens in statement\n");
+		}
 		NumTokens++;
 		Tokens[NumTokens-1] = Tokens[NumTokens-2] + strlen(Tokens[NumTokens-2]) + 1;
 		Tokens[NumTokens-1][0] = 0;
@@ -122,7 +126,7 @@ void FParser::NextToken()
 	else if(*Rover == '\"')
     {
 		TokenType[NumTokens-1] = string_;
-		if(TokenType[NumTokens-2] == string_) NumTokens--;   // join strings
+		if(NumTokens > 1 && TokenType[NumTokens-2] == string_) NumTokens--;   // join strings
 		Rover++;
     }
 	else
@@ -166,7 +170,7 @@ static void add_char(char *tokn, char c)
 
 //==========================================================================
 //
-// get_tokens.
+// Tokenize.
 // Take a string, break it into tokens.
 //
 // individual tokens are stored inside the tokens[] array
@@ -186,7 +190,7 @@ static void add_char(char *tokn, char c)
 //
 //==========================================================================
 
-char *FParser::GetTokens(char *s)
+void FParser::Tokenize(char *s)
 {
 	char *tokn = NULL;
 
@@ -291,6 +295,149 @@ char *FParser::GetTokens(char *s)
 	}
 	
 	Rover++;
+}
+
+//==========================================================================
+//
+// ClassifyTokens
+//
+// Precalculates the operator index and bracket depth of each token
+// so that expression evaluation doesn't have to compare strings and
+// count brackets each time it looks for an operator.
+//
+//==========================================================================
+
+void FParser::ClassifyTokens()
+{
+	int depth = 0;
+
+	for(int i = 0; i < NumTokens; i++)
+	{
+		TokenOp[i] = -1;
+		TokenDepth[i] = depth;
+		if(TokenType[i] != operator_) continue;
+
+		if(Tokens[i][0] == '(') depth++;
+		else if(Tokens[i][0] == ')') depth--;
+
+		for(int j = 0; j < num_operators; j++)
+		{
+			if(!strcmp(operators[j].string, Tokens[i]))
+			{
+				TokenOp[i] = j;
+				break;
+			}
+		}
+	}
+	TokenDepth[NumTokens] = depth;
+}
+
+//==========================================================================
+//
+// LoadStatement
+//
+// Restores a statement that was previously tokenized.
+//
+//==========================================================================
+
+bool FParser::LoadStatement(int index)
+{
+	unsigned *pst = Script->StatementMap.CheckKey(index);
+	if(pst == NULL) return false;
+
+	const FsStatement &st = Script->Statements[*pst];
+
+	NumTokens = st.numtokens;
+	if(st.textlen > 0)
+	{
+		memcpy(Tokens[0], &Script->TokenText[st.text], st.textlen);
+	}
+	else
+	{
+		Tokens[0][0] = 0;
+	}
+	for(int i = 0; i < NumTokens; i++)
+	{
+		const FsTokenInfo &info = Script->TokenInfo[st.firsttoken + i];
+
+		Tokens[i] = Tokens[0] + info.offset;
+		TokenType[i] = (tokentype_t)info.type;
+		TokenOp[i] = info.op;
+		TokenDepth[i] = info.depth;
+	}
+	TokenDepth[NumTokens] = st.enddepth;
+
+	Section = st.section;
+	if(Section) BraceType = st.bracetype;
+	LineStart = Script->data + st.linestart;
+	Rover = Script->data + st.next;
+	return true;
+}
+
+//==========================================================================
+//
+// SaveStatement
+//
+// Stores the current token list in the script.
+//
+//==========================================================================
+
+void FParser::SaveStatement(int index)
+{
+	FsStatement st;
+
+	st.firsttoken = Script->TokenInfo.Reserve(NumTokens);
+	st.numtokens = NumTokens;
+	st.textlen = NumTokens > 0 ? 
+		int(Tokens[NumTokens-1] + strlen(Tokens[NumTokens-1]) + 1 - Tokens[0]) : 0;
+	st.text = Script->TokenText.Reserve(st.textlen);
+	if(st.textlen > 0)
+	{
+		memcpy(&Script->TokenText[st.text], Tokens[0], st.textlen);
+	}
+	for(int i = 0; i < NumTokens; i++)
+	{
+		FsTokenInfo &info = Script->TokenInfo[st.firsttoken + i];
+
+		info.offset = int(Tokens[i] - Tokens[0]);
+		info.type = (BYTE)TokenType[i];
+		info.op = (SBYTE)TokenOp[i];
+		info.depth = (SWORD)TokenDepth[i];
+	}
+	st.enddepth = TokenDepth[NumTokens];
+	st.section = Section;
+	st.bracetype = BraceType;
+	st.linestart = Script->MakeIndex(LineStart);
+	st.next = Script->MakeIndex(Rover);
+
+	Script->StatementMap[index] = Script->Statements.Push(st);
+}
+
+//==========================================================================
+//
+// GetTokens
+//
+// Returns the tokens of the statement starting at s. Statements inside
+// the script's own data are only tokenized once; included lumps are
+// always processed from scratch.
+//
+//==========================================================================
+
+char *FParser::GetTokens(char *s)
+{
+	bool cacheable = (s >= Script->data && s < Script->data + Script->len);
+	int index = cacheable ? Script->MakeIndex(s) : 0;
+
+	if(cacheable && LoadStatement(index))
+	{
+		return Rover;
+	}
+	Tokenize(s);
+	ClassifyTokens();
+	if(cacheable)
+	{
+		SaveStatement(index);
+	}
 	return Rover;
 }
 
@@ -482,20 +629,14 @@ void FParser::RunStatement()
 int FParser::FindOperator(int start, int stop, const char *value)
 {
 	int i;
-	int bracketlevel = 0;
 	
 	for(i=start; i<=stop; i++)
     {
 		// only interested in operators
 		if(TokenType[i] != operator_) continue;
 		
-		// use bracketlevel to check the number of brackets
-		// which we are inside
-		bracketlevel += Tokens[i][0]=='(' ? 1 :
-		Tokens[i][0]==')' ? -1 : 0;
-		
 		// only check when we are not in brackets
-		if(!bracketlevel && !strcmp(value, Tokens[i]))
+		if(TokenDepth[i+1] == TokenDepth[start] && !strcmp(value, Tokens[i]))
 			return i;
     }
 	
@@ -511,24 +652,15 @@ int FParser::FindOperator(int start, int stop, const char *value)
 int FParser::FindOperatorBackwards(int start, int stop, const char *value)
 {
 	int i;
-	int bracketlevel = 0;
 	
 	for(i=stop; i>=start; i--)      // check backwards
     {
 		// operators only
-		
 		if(TokenType[i] != operator_) continue;
 		
-		// use bracketlevel to check the number of brackets
-		// which we are inside
-		
-		bracketlevel += Tokens[i][0]=='(' ? -1 :
-		Tokens[i][0]==')' ? 1 : 0;
-		
 		// only check when we are not in brackets
 		// if we find what we want, return it
-		
-		if(!bracketlevel && !strcmp(value, Tokens[i]))
+		if(TokenDepth[i] == TokenDepth[stop+1] && !strcmp(value, Tokens[i]))
 			return i;
     }
 	
@@ -658,29 +790,37 @@ void FParser::EvaluateExpression(svalue_t &result, int start, int stop)
 		return;
     }
 	
-	// go through each operator in order of precedence
-	for(i=0; i<num_operators; i++)
-    {
-		// check backwards for the token. it has to be
-		// done backwards for left-to-right reading: eg so
-		// 5-3-2 is (5-3)-2 not 5-(3-2)
-		
-		if (operators[i].direction==forward)
-		{
-			n = FindOperatorBackwards(start, stop, operators[i].string);
-		}
-		else
+	if(start <= stop)
+	{
+		// collect the first and last unbracketed occurence of each
+		// operator in one pass instead of searching once per operator.
+		int first[MAXOPERATORS], last[MAXOPERATORS];
+		int startdepth = TokenDepth[start], stopdepth = TokenDepth[stop+1];
+
+		for(i=0; i<num_operators; i++) first[i] = last[i] = -1;
+		for(i=start; i<=stop; i++)
 		{
-			n = FindOperator(start, stop, operators[i].string);
+			int op = TokenOp[i];
+			if(op < 0) continue;
+			if(first[op] == -1 && TokenDepth[i+1] == startdepth) first[op] = i;
+			if(TokenDepth[i] == stopdepth) last[op] = i;
 		}
 
-		if( n != -1)
+		// go through each operator in order of precedence
+		for(i=0; i<num_operators; i++)
 		{
-			// call the operator function and evaluate this chunk of tokens
-			(this->*operators[i].handler)(result, start, n, stop);
-			return;
+			// use the last occurence for left-to-right operators
+			// so that 5-3-2 is (5-3)-2 not 5-(3-2)
+			n = operators[i].direction==forward ? last[i] : first[i];
+
+			if( n != -1)
+			{
+				// call the operator function and evaluate this chunk of tokens
+				(this->*operators[i].handler)(result, start, n, stop);
+				return;
+			}
 		}
-    }
+	}
 	
 	if(TokenType[start] == function)
 	{
@@ -139,6 +139,22 @@ void DFsScript::ClearSections()
 		}
 		sections[i] = NULL;
 	}
+	// the tokenized statements reference the sections.
+	ClearStatements();
+}
+
+//==========================================================================
+//
+// discards all tokenized statements
+//
+//==========================================================================
+
+void DFsScript::ClearStatements()
+{
+	StatementMap.Clear();
+	Statements.Clear();
+	TokenInfo.Clear();
+	TokenText.Clear();
 }
 
 //==========================================================================
@@ -397,6 +413,7 @@ void DFsScript::DryRunScript()
 void DFsScript::Preprocess()
 {
 	len = (int)strlen(data);
+	ClearStatements();
 	ProcessFindChar(data, 0);  // fill in everything
 	DryRunScript();
 }
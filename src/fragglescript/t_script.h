@@ -123,6 +123,7 @@ enum
 	TOKENLENGTH = 128,
 	MAXARGS = 128,
 	MAXSCRIPTS = 257,
+	MAXOPERATORS = 32,
 };
 
 //==========================================================================
@@ -240,6 +241,38 @@ enum    // brace types: where current_section is a { or }
 	bracket_close
 };
 
+//==========================================================================
+//
+// Tokenized statements
+//
+// The first time a statement is parsed its tokens are stored in the
+// owning script so that loops and repeatedly run scripts don't have to
+// go through the tokenizer again. This data is not serialized; after
+// loading a savegame it gets rebuilt on demand.
+//
+//==========================================================================
+
+struct FsTokenInfo
+{
+	int offset;			// offset into the statement's token text
+	BYTE type;			// tokentype_t
+	SBYTE op;			// index into FParser::operators or -1
+	SWORD depth;		// bracket depth before this token
+};
+
+struct FsStatement
+{
+	int firsttoken;		// index into DFsScript::TokenInfo
+	int numtokens;
+	int text;			// index into DFsScript::TokenText
+	int textlen;
+	int linestart;		// offsets into the script data
+	int next;
+	int bracetype;
+	int enddepth;		// bracket depth after the last token
+	DFsSection *section;
+};
+
 //==========================================================================
 //
 // Errors
@@ -310,6 +343,12 @@ public:
 	bool lastiftrue;     // haleyjd: whether last "if" statement was 
 	// true or false
 
+	// tokenized statements, keyed by their offset in data
+	TMap<int, unsigned> StatementMap;
+	TArray<FsStatement> Statements;
+	TArray<FsTokenInfo> TokenInfo;
+	TArray<char> TokenText;
+
 	DFsScript();
 	void Destroy();
 	void Serialize(FArchive &ar);
@@ -328,6 +367,7 @@ public:
 	char *SectionLoop(const DFsSection *sec);
 	void ClearSections();
 	void ClearChildren();
+	void ClearStatements();
 
 	int MakeIndex(const char *p) { return int(p-data); }
 
@@ -374,6 +414,8 @@ struct FParser
 
 	char *Tokens[T_MAXTOKENS];
 	tokentype_t TokenType[T_MAXTOKENS];
+	int TokenOp[T_MAXTOKENS];			// index into operators[] or -1
+	int TokenDepth[T_MAXTOKENS+1];		// bracket depth before each token
 	int NumTokens;
 	DFsScript *Script;       // the current script
 	DFsSection *Section;
@@ -402,6 +444,10 @@ struct FParser
 	}
 
 	void NextToken();
+	void Tokenize(char *s);
+	void ClassifyTokens();
+	bool LoadStatement(int index);
+	void SaveStatement(int index);
 	char *GetTokens(char *s);
 	void PrintTokens();
 	void ErrorMessage(FString msg);
@@ -19,6 +19,8 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <time.h>
+#include <thread>
+#include <atomic>
 #ifdef __APPLE__
 #include <CoreServices/CoreServices.h>
 #endif
@@ -73,10 +75,13 @@
 #include "farchive.h"
 #include "r_renderer.h"
 #include "r_data/colormaps.h"
+#include "stats.h"
 
 #include <zlib.h>
 
 #include "g_hub.h"
+#include "g_rewind.h"
+#include "g_synchash.h"
 
 
 static FRandom pr_dmspawn ("DMSpawn");
@@ -93,6 +98,9 @@ void	G_PlayerReborn (int player);
 void	G_DoNewGame (void);
 void	G_DoLoadGame (void);
 void	G_DoPlayDemo (void);
+void	G_DoDemoSeek (void);
+void	G_DemoSeekTicker (void);
+void	G_StreamDemo (bool force);
 void	G_DoCompleted (void);
 void	G_DoVictory (void);
 void	G_DoWorldDone (void);
@@ -109,7 +117,9 @@ CVAR (Bool, storesavepic, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (Bool, longsavemessages, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR (String, save_dir, "", CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
 CVAR (Bool, cl_waitforsave, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR (Bool, save_async, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 EXTERN_CVAR (Float, con_midtime);
+EXTERN_CVAR (Bool, showloadtimes);
 
 //==========================================================================
 //
@@ -156,6 +166,23 @@ int 			consoleplayer;			// player taking events
 int 			gametic;
 
 CVAR(Bool, demo_compress, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
+CVAR(Bool, demo_stream, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
+CUSTOM_CVAR(Int, demo_flushinterval, 10, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 1)
+		self = 1;
+}
+CVAR(Bool, demo_seekindex, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
+CUSTOM_CVAR(Int, demo_seekinterval, 350, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < TICRATE)
+		self = TICRATE;
+}
+CUSTOM_CVAR(Int, demo_seeklimit, 256, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 16)
+		self = 16;
+}
 FString			newdemoname;
 FString			newdemomap;
 FString			demoname;
@@ -222,6 +249,11 @@ void R_ExecuteSetViewSize (void);
 FString savename;
 FString BackupSaveName;
 
+// Timings of the last save and load, for the savecodecs command
+static double LastSaveCaptureMS, LastSaveWriteMS, LastLoadMS;
+static FString LastLoadTimes;
+static unsigned int LastSaveRawSize, LastSavePackedSize;
+
 bool SendLand;
 const AInventory *SendItemUse, *SendItemDrop;
 
@@ -1007,6 +1039,8 @@ void G_Ticker ()
 	int i;
 	gamestate_t	oldgamestate;
 
+	G_CheckSaveGame ();
+
 	// do player reborns if needed
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
@@ -1095,6 +1129,12 @@ void G_Ticker ()
 			AM_ToggleMap ();
 			gameaction = ga_nothing;
 			break;
+		case ga_rewind:
+			G_DoRewind ();
+			break;
+		case ga_demoseek:
+			G_DoDemoSeek ();
+			break;
 		case ga_nothing:
 			break;
 		}
@@ -1124,6 +1164,9 @@ void G_Ticker ()
 	//Added by MC: For some of that bot stuff. The main bot function.
 	bglobal.Main ();
 
+	G_RewindTicker (buf);
+	G_DemoSeekTicker ();
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (playeringame[i])
@@ -1181,6 +1224,11 @@ void G_Ticker ()
 		}
 	}
 
+	if (demorecording)
+	{
+		G_StreamDemo (false);
+	}
+
 	// do main actions
 	switch (gamestate)
 	{
@@ -1216,6 +1264,8 @@ void G_Ticker ()
 	default:
 		break;
 	}
+
+	G_SyncHashTicker ();
 }
 
 
@@ -1625,6 +1675,7 @@ void G_DoReborn (int playernum, bool freshbot)
 {
 	if (!multiplayer && !(level.flags2 & LEVEL2_ALLOWRESPAWN))
 	{
+		G_WaitForSaveGame ();
 		if (BackupSaveName.Len() > 0 && FileExists (BackupSaveName.GetChars()))
 		{ // Load game from the last point it was saved
 			savename = BackupSaveName;
@@ -1807,6 +1858,15 @@ void G_DoLoadGame ()
 	hidecon = gameaction == ga_loadgamehidecon;
 	gameaction = ga_nothing;
 
+	G_WaitForSaveGame ();
+
+	cycle_t loadtime, snaptime, inittime, extratime;
+	loadtime.Reset();
+	snaptime.Reset();
+	inittime.Reset();
+	extratime.Reset();
+	loadtime.Clock();
+
 	FILE *stdfile = fopen (savename.GetChars(), "rb");
 	if (stdfile == NULL)
 	{
@@ -1921,16 +1981,22 @@ void G_DoLoadGame ()
 		level.time = 0;
 	}
 
+	// Hub snapshots stay compressed until their level is entered again.
+	snaptime.Clock();
 	G_ReadSnapshots (png);
+	snaptime.Unclock();
 
 	// load a base level
 	savegamerestore = true;		// Use the player actors in the savegame
 	bool demoplaybacksave = demoplayback;
+	inittime.Clock();
 	G_InitNew (map, false);
+	inittime.Unclock();
 	demoplayback = demoplaybacksave;
 	delete[] map;
 	savegamerestore = false;
 
+	extratime.Clock();
 	STAT_Read(png);
 	FRandom::StaticReadRNGState(png);
 	P_ReadACSDefereds(png);
@@ -1954,6 +2020,36 @@ void G_DoLoadGame ()
 
 	delete png;
 	fclose (stdfile);
+	extratime.Unclock();
+
+	loadtime.Unclock();
+	LastLoadMS = loadtime.TimeMS();
+
+	unsigned int packed, unpacked, hubpacked = 0, hubcount = 0;
+	for (unsigned int i = 0; i < wadlevelinfos.Size(); ++i)
+	{
+		if (wadlevelinfos[i].snapshot != NULL)
+		{
+			wadlevelinfos[i].snapshot->GetSizes (packed, unpacked);
+			hubpacked += packed != 0 ? packed : unpacked;
+			hubcount++;
+		}
+	}
+	double levelms = inittime.TimeMS() - UnSnapshotInflateMS - UnSnapshotReadMS;
+	LastLoadTimes.Format ("%.2f ms header, %.2f ms hub snapshots (%u kept packed, %u bytes), "
+		"%.2f ms level setup, %.2f ms inflate, %.2f ms objects, %.2f ms globals",
+		LastLoadMS - snaptime.TimeMS() - inittime.TimeMS() - extratime.TimeMS(),
+		snaptime.TimeMS(), hubcount, hubpacked, levelms, UnSnapshotInflateMS,
+		UnSnapshotReadMS, extratime.TimeMS());
+	// Same switch as the map loader's breakdown of its load times.
+	if (showloadtimes)
+	{
+		Printf ("Loaded %s in %.2f ms: %s\n", savename.GetChars(), LastLoadMS, LastLoadTimes.GetChars());
+	}
+	else
+	{
+		DPrintf ("Loaded %s in %.2f ms: %s\n", savename.GetChars(), LastLoadMS, LastLoadTimes.GetChars());
+	}
 
 	// At this point, the GC threshold is likely a lot higher than the
 	// amount of memory in use, so bring it down now by starting a
@@ -2138,6 +2234,254 @@ static void PutSavePic (FILE *file, int width, int height)
 	}
 }
 
+//==========================================================================
+//
+// Background savegame writer
+//
+// G_DoSaveGame captures the current level uncompressed and writes all other
+// chunks to a temporary file through a large stdio buffer. A worker thread
+// then packs the level, appends it, closes the file and renames it over the
+// real savegame, so an interrupted save never leaves a truncated file.
+// Completion is reported from G_Ticker on the game thread.
+//
+//==========================================================================
+
+enum { SAVEBUFFERSIZE = 1024*1024 };
+
+struct FSaveJob
+{
+	FString Filename;
+	FString TempName;
+	FString Description;
+	bool OkForQuicksave;
+	bool Written;
+	DWORD SnapshotID;
+	int Level;
+	int Threads;
+	unsigned int PackedSize;
+	cycle_t CaptureTime;
+	cycle_t WriteTime;
+	FILE *File;
+	char *Buffer;
+	FCompressedMemFile SnapHeader;
+	FCompressedMemFile Snapshot;
+	std::thread Thread;
+	std::atomic<bool> Done;
+};
+
+static FSaveJob *SaveJob;
+
+static void SaveWorker (FSaveJob *job)
+{
+	bool ok = true;
+
+	job->WriteTime.Clock();
+	if (job->SnapshotID != 0)
+	{
+		ok = FCompressedMemFile::WritePNGChunk (job->File, job->SnapshotID,
+			job->SnapHeader, job->Snapshot, job->Level, job->Threads, &job->PackedSize);
+	}
+	ok = M_FinishPNG (job->File) && ok;
+	ok = fclose (job->File) == 0 && ok;
+	job->File = NULL;
+
+	if (ok)
+	{
+#ifdef _WIN32
+		// rename does not replace an existing file here.
+		remove (job->Filename.GetChars());
+#endif
+		ok = rename (job->TempName.GetChars(), job->Filename.GetChars()) == 0;
+	}
+	if (!ok)
+	{
+		remove (job->TempName.GetChars());
+	}
+	job->WriteTime.Unclock();
+	job->Written = ok;
+	job->Done = true;
+}
+
+static void G_FinishSaveGame (bool notify)
+{
+	FSaveJob *job = SaveJob;
+
+	SaveJob = NULL;
+	if (job->Thread.joinable())
+	{
+		job->Thread.join();
+	}
+
+	LastSaveCaptureMS = job->CaptureTime.TimeMS();
+	LastSaveWriteMS = job->WriteTime.TimeMS();
+	job->Snapshot.GetStoredData (LastSaveRawSize);
+	LastSavePackedSize = job->PackedSize;
+
+	if (notify)
+	{
+		// Check whether the file is ok.
+		bool success = false;
+		if (job->Written)
+		{
+			M_NotifyNewSave (job->Filename.GetChars(), job->Description.GetChars(), job->OkForQuicksave);
+
+			FILE *stdfile = fopen (job->Filename.GetChars(), "rb");
+			if (stdfile != NULL)
+			{
+				PNGHandle *pngh = M_VerifyPNG(stdfile);
+				if (pngh != NULL)
+				{
+					success = true;
+					delete pngh;
+				}
+				fclose(stdfile);
+			}
+		}
+		if (success) 
+		{
+			if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), job->Filename.GetChars());
+			else Printf ("%s\n", GStrings("GGSAVED"));
+		}
+		else Printf(PRINT_HIGH, "Save failed\n");
+	}
+
+	delete[] job->Buffer;
+	delete job;
+}
+
+static void G_ShutdownSaveWriter ()
+{
+	if (SaveJob != NULL)
+	{
+		G_FinishSaveGame (false);
+	}
+}
+
+//==========================================================================
+//
+// G_CheckSaveGame
+//
+// Reports a finished background save. Called every tic.
+//
+//==========================================================================
+
+void G_CheckSaveGame ()
+{
+	if (SaveJob != NULL && SaveJob->Done)
+	{
+		G_FinishSaveGame (true);
+	}
+}
+
+//==========================================================================
+//
+// G_WaitForSaveGame
+//
+// Blocks until the savegame being written in the background, if any, is
+// on disk.
+//
+//==========================================================================
+
+void G_WaitForSaveGame ()
+{
+	if (SaveJob != NULL)
+	{
+		G_FinishSaveGame (true);
+	}
+}
+
+//==========================================================================
+//
+// CCMD savecodecs
+//
+// Reports the timings of the last save and load, the memory held by hub
+// snapshots, and how each save codec does on the current level.
+//
+//==========================================================================
+
+CCMD (savecodecs)
+{
+	unsigned int i, packed, unpacked;
+	unsigned int hubpacked = 0, hubunpacked = 0, hubcount = 0;
+
+	G_WaitForSaveGame ();
+
+	Printf ("Last save: %.2f ms snapshot, %.2f ms compress+write, %u -> %u bytes\n",
+		LastSaveCaptureMS, LastSaveWriteMS, LastSaveRawSize, LastSavePackedSize);
+	Printf ("Last load: %.2f ms\n", LastLoadMS);
+	if (LastLoadTimes.IsNotEmpty())
+	{
+		Printf ("  %s\n", LastLoadTimes.GetChars());
+	}
+
+	for (i = 0; i < wadlevelinfos.Size(); ++i)
+	{
+		if (wadlevelinfos[i].snapshot != NULL)
+		{
+			wadlevelinfos[i].snapshot->GetSizes (packed, unpacked);
+			hubpacked += packed != 0 ? packed : unpacked;
+			hubunpacked += unpacked;
+			hubcount++;
+		}
+	}
+	Printf ("Hub snapshots: %u, %u bytes in memory (%u uncompressed)\n", hubcount, hubpacked, hubunpacked);
+
+	if (gamestate != GS_LEVEL)
+	{
+		return;
+	}
+
+	FCompressedMemFile header, body;
+	unsigned int len;
+	const BYTE *data;
+
+	if (G_SnapshotLevelForSave (header, body) == 0 || (data = body.GetStoredData (len)) == NULL)
+	{
+		return;
+	}
+
+	int maxthreads = M_SaveCompressionThreads ();
+	unsigned int bound = M_DeflateBound (len);
+	BYTE *out = new BYTE[bound];
+	BYTE *check = new BYTE[len];
+
+	Printf ("Current level: %u bytes\n", len);
+	for (int c = 0; c < M_NumSaveCodecs(); ++c)
+	{
+		int level = M_SaveCodecLevel (c);
+		if (level == 0)
+		{
+			continue;
+		}
+		for (int threads = 1; ; threads = maxthreads)
+		{
+			cycle_t packtime, unpacktime;
+			uLongf checklen = len;
+
+			packtime.Reset();
+			unpacktime.Reset();
+			packtime.Clock();
+			packed = M_DeflateBuffer (out, bound, data, len, level, threads);
+			packtime.Unclock();
+			unpacktime.Clock();
+			bool ok = packed != 0 && uncompress (check, &checklen, out, packed) == Z_OK &&
+				checklen == len && memcmp (check, data, len) == 0;
+			unpacktime.Unclock();
+
+			Printf ("  %-5s %2d thread%s: %9u bytes (%5.1f%%), %7.2f ms compress, %7.2f ms decompress%s\n",
+				M_SaveCodecName (c), threads, threads == 1 ? " " : "s", packed,
+				packed * 100. / len, packtime.TimeMS(), unpacktime.TimeMS(), ok ? "" : " FAILED");
+
+			if (threads == maxthreads)
+			{
+				break;
+			}
+		}
+	}
+	delete[] out;
+	delete[] check;
+}
+
 void G_DoSaveGame (bool okForQuicksave, FString filename, const char *description)
 {
 	char buf[100];
@@ -2154,22 +2498,46 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 		filename = G_BuildSaveName ("demosave.zds", -1);
 	}
 
+	// Only one save may be in flight, and it may be the same file.
+	G_WaitForSaveGame ();
+
 	if (cl_waitforsave)
 		I_FreezeTime(true);
 
 	insave = true;
-	G_SnapshotLevel ();
 
-	FILE *stdfile = fopen (filename, "wb");
+	FSaveJob *job = new FSaveJob;
+	job->Filename = filename;
+	job->TempName.Format ("%s.tmp", filename.GetChars());
+	job->Description = description;
+	job->OkForQuicksave = okForQuicksave;
+	job->Level = M_SaveCompressionLevel ();
+	job->Threads = M_SaveCompressionThreads ();
+	job->PackedSize = 0;
+	job->Written = false;
+	job->Done = false;
+	job->CaptureTime.Reset();
+	job->WriteTime.Reset();
+	job->CaptureTime.Clock();
+	job->SnapshotID = G_SnapshotLevelForSave (job->SnapHeader, job->Snapshot);
+	job->CaptureTime.Unclock();
+
+	FILE *stdfile = fopen (job->TempName, "wb");
 
 	if (stdfile == NULL)
 	{
 		Printf ("Could not create savegame '%s'\n", filename.GetChars());
+		delete job;
 		insave = false;
 		I_FreezeTime(false);
 		return;
 	}
 
+	// Let the worker do the actual disk writes when it closes the file.
+	job->Buffer = new char[SAVEBUFFERSIZE];
+	setvbuf (stdfile, job->Buffer, _IOFBF, SAVEBUFFERSIZE);
+	job->File = stdfile;
+
 	SaveVersion = SAVEVER;
 	PutSavePic (stdfile, SAVEPICWIDTH, SAVEPICHEIGHT);
 	mysnprintf(buf, countof(buf), GAMENAME " %s", GetVersionString());
@@ -2195,6 +2563,7 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 		M_AppendPNGChunk (stdfile, MAKE_ID('p','t','I','c'), (BYTE *)&time, 8);
 	}
 
+	// The current level's snapshot is appended by the worker.
 	G_WriteSnapshots (stdfile);
 	STAT_Write(stdfile);
 	FRandom::StaticWriteRNGState (stdfile);
@@ -2208,40 +2577,20 @@ void G_DoSaveGame (bool okForQuicksave, FString filename, const char *descriptio
 		M_AppendPNGChunk (stdfile, MAKE_ID('s','n','X','t'), &next, 1);
 	}
 
-	M_FinishPNG (stdfile);
-	fclose (stdfile);
-
-	M_NotifyNewSave (filename.GetChars(), description, okForQuicksave);
+	BackupSaveName = filename;
 
-	// Check whether the file is ok.
-	bool success = false;
-	stdfile = fopen (filename.GetChars(), "rb");
-	if (stdfile != NULL)
+	SaveJob = job;
+	if (save_async)
 	{
-		PNGHandle *pngh = M_VerifyPNG(stdfile);
-		if (pngh != NULL)
-		{
-			success = true;
-			delete pngh;
-		}
-		fclose(stdfile);
+		atterm (G_ShutdownSaveWriter);
+		job->Thread = std::thread (SaveWorker, job);
 	}
-	if (success) 
+	else
 	{
-		if (longsavemessages) Printf ("%s (%s)\n", GStrings("GGSAVED"), filename.GetChars());
-		else Printf ("%s\n", GStrings("GGSAVED"));
+		SaveWorker (job);
+		G_FinishSaveGame (true);
 	}
-	else Printf(PRINT_HIGH, "Save failed\n");
-
-	BackupSaveName = filename;
 
-	// We don't need the snapshot any longer.
-	if (level.info->snapshot != NULL)
-	{
-		delete level.info->snapshot;
-		level.info->snapshot = NULL;
-	}
-		
 	insave = false;
 	I_FreezeTime(false);
 }
@@ -2354,6 +2703,197 @@ void G_WriteDemoTiccmd (ticcmd_t *cmd, int player, int buf)
 
 
 
+//==========================================================================
+//
+// Streamed demo recording
+//
+// With demo_stream on, the header chunks go to the file as soon as
+// recording starts. The body follows as a series of BCHK chunks, written
+// whenever DEMO_CHUNKSIZE bytes have collected or demo_flushinterval
+// seconds have passed, so demobuffer never holds more than one chunk.
+// Each BCHK holds the uncompressed size, the tic it starts at and the
+// data, which is zlib-compressed unless it is the same size as the
+// uncompressed data. The FORM length is updated after every chunk, so
+// if the game crashes the demo can still be played up to the last chunk.
+// When recording stops, a BIDX chunk is appended that lists the file
+// offset, body offset and starting tic of every BCHK.
+//
+//==========================================================================
+
+enum { DEMO_CHUNKSIZE = 0x10000 };
+
+static FILE *DemoFile;
+static TArray<DWORD> DemoChunkIndex;	// File offset, body offset and tic of each chunk
+static DWORD DemoBodySize;				// Uncompressed body size written so far
+static int DemoChunkTic;				// gametic the current chunk started at
+
+static void G_UpdateDemoFormLength ()
+{
+	BYTE len[4];
+	BYTE *p = len;
+	long end = ftell (DemoFile);
+
+	WriteLong (int(end - 8), &p);
+	fseek (DemoFile, 4, SEEK_SET);
+	fwrite (len, 1, 4, DemoFile);
+	fseek (DemoFile, end, SEEK_SET);
+	fflush (DemoFile);
+}
+
+static void G_FlushDemoChunk ()
+{
+	DWORD len = DWORD(demo_p - demobuffer);
+	uLong datalen = compressBound (len);
+	TArray<BYTE> chunk;
+	BYTE *p;
+
+	if (len == 0)
+	{
+		return;
+	}
+	chunk.Resize (16 + datalen + 1);
+	p = &chunk[8];
+	WriteLong (len, &p);
+	WriteLong (DemoChunkTic, &p);
+	if (!demo_compress || compress2 (p, &datalen, demobuffer, len, 9) != Z_OK || datalen >= len)
+	{
+		memcpy (p, demobuffer, len);
+		datalen = len;
+	}
+	p = &chunk[0];
+	WriteLong (BCHK_ID, &p);
+	WriteLong (int(datalen + 8), &p);
+	chunk[16 + datalen] = 0;		// IFF pad byte
+
+	DemoChunkIndex.Push (DWORD(ftell (DemoFile)));
+	DemoChunkIndex.Push (DemoBodySize);
+	DemoChunkIndex.Push (DemoChunkTic);
+	fwrite (&chunk[0], 1, 16 + datalen + (datalen & 1), DemoFile);
+	G_UpdateDemoFormLength ();
+
+	DemoBodySize += len;
+	DemoChunkTic = gametic;
+	demo_p = demobuffer;
+}
+
+//==========================================================================
+//
+// G_StreamDemo
+//
+// Called every tic while recording. Writes out the body collected so far
+// if it is time to.
+//
+//==========================================================================
+
+void G_StreamDemo (bool force)
+{
+	if (DemoFile != NULL && (force || demo_p - demobuffer >= DEMO_CHUNKSIZE ||
+		(demo_p > demobuffer && gametic - DemoChunkTic >= demo_flushinterval * TICRATE)))
+	{
+		G_FlushDemoChunk ();
+	}
+}
+
+// Returns true if the whole demo made it to disk.
+static bool G_FinishDemoFile ()
+{
+	G_FlushDemoChunk ();
+
+	BYTE header[8];
+	BYTE *p = header;
+	WriteLong (BIDX_ID, &p);
+	WriteLong (DemoChunkIndex.Size() * 4, &p);
+	fwrite (header, 1, 8, DemoFile);
+	for (unsigned int i = 0; i < DemoChunkIndex.Size(); ++i)
+	{
+		p = header;
+		WriteLong (DemoChunkIndex[i], &p);
+		fwrite (header, 1, 4, DemoFile);
+	}
+	G_UpdateDemoFormLength ();
+
+	bool saved = !ferror (DemoFile);
+	saved = fclose (DemoFile) == 0 && saved;
+	DemoFile = NULL;
+	DemoChunkIndex.Clear ();
+	return saved;
+}
+
+//==========================================================================
+//
+// G_InflateDemoChunks
+//
+// Joins the BCHK chunks of a streamed demo, starting with the one at p,
+// into a new demobuffer. Returns true on failure, like G_ProcessIFFDemo.
+//
+//==========================================================================
+
+static bool G_InflateDemoChunks (BYTE *start)
+{
+	uLong total = 0, pos = 0;
+	BYTE *body = NULL;
+
+	// The first pass adds up the sizes, the second one unpacks.
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		BYTE *chunk = start;
+		while (chunk + 8 <= zdemformend)
+		{
+			BYTE *p = chunk;
+			int id = ReadLong (&p);
+			int len = ReadLong (&p);
+			if (len < 0 || p + len > zdemformend)
+			{
+				break;
+			}
+			chunk = p + len + (len & 1);
+			if (id != BCHK_ID || len < 8)
+			{
+				continue;
+			}
+
+			uLong size = (DWORD)ReadLong (&p);
+			uLong datalen = len - 8;
+			p += 4;		// starting tic
+			if (pass == 0)
+			{
+				total += size;
+			}
+			else if (datalen == size)
+			{
+				memcpy (body + pos, p, size);
+				pos += size;
+			}
+			else
+			{
+				uLong outlen = size;
+				int r = uncompress (body + pos, &outlen, p, datalen);
+				if (r != Z_OK || outlen != size)
+				{
+					Printf ("Could not decompress demo! %s\n", M_ZLibError(r).GetChars());
+					M_Free (body);
+					return true;
+				}
+				pos += size;
+			}
+		}
+		if (total == 0)
+		{
+			Printf ("Demo has no BODY chunk!\n");
+			return true;
+		}
+		if (pass == 0)
+		{
+			body = (BYTE *)M_Malloc (total);
+		}
+	}
+
+	M_Free (demobuffer);
+	demobuffer = demo_p = body;
+	zdembodyend = body + total;
+	return false;
+}
+
 //
 // G_RecordDemo
 //
@@ -2430,6 +2970,23 @@ void G_BeginRecording (const char *startmap)
 	P_WriteDemoWeaponsChunk(&demo_p);
 	FinishChunk (&demo_p);
 
+	if (demo_stream)
+	{
+		DemoFile = fopen (demoname, "wb");
+		if (DemoFile != NULL)
+		{
+			// The body follows in BCHK chunks.
+			fwrite (demobuffer, 1, demo_p - demobuffer, DemoFile);
+			demo_p = demobuffer;
+			DemoChunkIndex.Clear ();
+			DemoBodySize = 0;
+			DemoChunkTic = gametic;
+			G_UpdateDemoFormLength ();
+			return;
+		}
+		Printf ("Could not open %s, recording to memory\n", demoname.GetChars());
+	}
+
 	// Indicate body is compressed
 	StartChunk (COMP_ID, &demo_p);
 	democompspot = demo_p;
@@ -2492,6 +3049,7 @@ bool G_ProcessIFFDemo (FString &mapname)
 	int id, len, i;
 	uLong uncompSize = 0;
 	BYTE *nextchunk;
+	BYTE *streamstart = NULL;
 
 	demoplayback = true;
 
@@ -2586,6 +3144,11 @@ bool G_ProcessIFFDemo (FString &mapname)
 			zdembodyend = demo_p + len;
 			break;
 
+		case BCHK_ID:
+			bodyHit = true;
+			streamstart = demo_p - 8;
+			break;
+
 		case COMP_ID:
 			uncompSize = ReadLong (&demo_p);
 			break;
@@ -2617,6 +3180,11 @@ bool G_ProcessIFFDemo (FString &mapname)
 	if (numPlayers > 1)
 		multiplayer = netgame = true;
 
+	if (streamstart != NULL)
+	{
+		return G_InflateDemoChunks (streamstart);
+	}
+
 	if (uncompSize > 0)
 	{
 		BYTE *uncompressed = new BYTE[uncompSize];
@@ -2635,6 +3203,285 @@ bool G_ProcessIFFDemo (FString &mapname)
 	return false;
 }
 
+//==========================================================================
+//
+// Demo seek index
+//
+// Once a demo has been seeked in, or from the start with demo_seekindex,
+// the level is snapshotted every demo_seekinterval tics while it plays,
+// along with the position in the demo stream. Seeking restores the
+// closest snapshot before the target and runs the remaining tics without
+// drawing them. The index is kept when the same demo is restarted, so
+// seeking backwards past the current level replays the demo from the
+// start and picks the snapshots up again.
+//
+// Once the index has more than demo_seeklimit entries, every other
+// keyframe group is dropped and the interval is doubled. Timedemos are
+// not indexed so that the snapshots don't affect the results.
+//
+//==========================================================================
+
+struct FDemoSeekPoint
+{
+	int Tic;
+	unsigned int Offset;		// Position of demo_p
+	bool InGame[MAXPLAYERS];
+	ticcmd_t Cmds[MAXPLAYERS];	// Demo commands are deltas against these
+};
+
+static FLevelSnapshotList DemoIndex;
+static FString DemoIndexName;
+static int DemoTic;				// Number of tics read from the demo so far
+static int DemoSeekTarget;
+static int DemoSeekSpacing = 1;	// demo_seekinterval multiplier after thinning out the index
+static bool DemoSeekUsed;		// A seek command has been used on this demo
+static bool DemoSeekMuted;
+static cycle_t DemoSeekCycles;
+
+static FDemoSeekPoint *GetSeekPoint (unsigned int index)
+{
+	return (FDemoSeekPoint *)&DemoIndex[index].Extra[0];
+}
+
+//==========================================================================
+//
+// MuteDemoSeek
+//
+// Sound effects are paused while fast-forwarding, or all the sounds of
+// the skipped tics would start playing.
+//
+//==========================================================================
+
+static void MuteDemoSeek (bool mute)
+{
+	if (mute != DemoSeekMuted)
+	{
+		DemoSeekMuted = mute;
+		if (mute)
+		{
+			S_PauseSound (true, false);
+		}
+		else if (!paused)
+		{
+			S_ResumeSound (false);
+		}
+	}
+}
+
+//==========================================================================
+//
+// G_DemoSeekTicker
+//
+// Called by G_Ticker before the demo commands for this tic are read.
+//
+//==========================================================================
+
+void G_DemoSeekTicker ()
+{
+	MuteDemoSeek (G_DemoFastForwarding ());
+	if (!demoplayback)
+	{
+		return;
+	}
+	if ((demo_seekindex || DemoSeekUsed) && !timingdemo && gamestate == GS_LEVEL && (DemoIndex.Size() == 0 ||
+		DemoTic >= GetSeekPoint(DemoIndex.Size() - 1)->Tic + demo_seekinterval * DemoSeekSpacing))
+	{
+		FLevelSnapshot &snap = DemoIndex.Take ();
+		FDemoSeekPoint point;
+
+		point.Tic = DemoTic;
+		point.Offset = unsigned(demo_p - demobuffer);
+		for (int i = 0; i < MAXPLAYERS; ++i)
+		{
+			point.InGame[i] = playeringame[i];
+			point.Cmds[i] = players[i].cmd;
+		}
+		snap.Extra.Resize (sizeof(point));
+		memcpy (&snap.Extra[0], &point, sizeof(point));
+
+		if (DemoIndex.Size() > (unsigned)demo_seeklimit && DemoIndex.Thin (demo_seeklimit))
+		{
+			DemoSeekSpacing *= 2;
+		}
+	}
+	DemoTic++;
+}
+
+//==========================================================================
+//
+// G_DemoFastForwarding
+//
+// True while the main loop should run demo tics without drawing them.
+//
+//==========================================================================
+
+bool G_DemoFastForwarding ()
+{
+	return demoplayback && DemoTic < DemoSeekTarget;
+}
+
+//==========================================================================
+//
+// G_DoDemoSeek
+//
+//==========================================================================
+
+void G_DoDemoSeek ()
+{
+	gameaction = ga_nothing;
+	if (!demoplayback)
+	{
+		return;
+	}
+
+	DemoSeekCycles.Reset ();
+	DemoSeekCycles.Clock ();
+
+	// Snapshots can only be restored into the level they were taken on.
+	int best = -1;
+	for (int i = DemoIndex.Size() - 1; i >= 0; --i)
+	{
+		if (GetSeekPoint(i)->Tic <= DemoSeekTarget &&
+			DemoIndex[i].MapName.CompareNoCase (level.MapName) == 0)
+		{
+			best = i;
+			break;
+		}
+	}
+
+	if (DemoSeekTarget < DemoTic && (best < 0 || gamestate != GS_LEVEL))
+	{
+		// The target is on an earlier level, so start over.
+		int target = DemoSeekTarget;
+
+		C_RestoreCVars ();
+		M_Free (demobuffer);
+		demobuffer = NULL;
+		P_SetupWeapons_ntohton ();
+		for (int i = 1; i < MAXPLAYERS; i++)
+		{
+			playeringame[i] = 0;
+		}
+		G_DoPlayDemo ();
+		if (!demoplayback)
+		{
+			DemoSeekCycles.Unclock ();
+			return;
+		}
+		DemoSeekTarget = target;
+		best = DemoIndex.Size() > 0 && GetSeekPoint(0)->Tic <= target &&
+			DemoIndex[0].MapName.CompareNoCase (level.MapName) == 0 ? 0 : -1;
+		for (unsigned int i = 1; best >= 0 && i < DemoIndex.Size(); ++i)
+		{
+			if (GetSeekPoint(i)->Tic > target || DemoIndex[i].MapName.CompareNoCase (level.MapName) != 0)
+			{
+				break;
+			}
+			best = i;
+		}
+	}
+
+	if (best >= 0 && gamestate == GS_LEVEL && (DemoSeekTarget < DemoTic || GetSeekPoint(best)->Tic > DemoTic))
+	{
+		if (!DemoIndex.Restore (best, false))
+		{
+			Printf ("Demo seek index is corrupt\n");
+		}
+		else
+		{
+			FDemoSeekPoint *point = GetSeekPoint (best);
+
+			DemoTic = point->Tic;
+			demo_p = demobuffer + point->Offset;
+			for (int i = 0; i < MAXPLAYERS; ++i)
+			{
+				playeringame[i] = point->InGame[i];
+				players[i].cmd = point->Cmds[i];
+			}
+		}
+	}
+	DemoSeekCycles.Unclock ();
+	// G_DemoFastForwarding takes it from here.
+}
+
+//==========================================================================
+//
+// ParseDemoTime
+//
+// Accepts seconds or minutes:seconds.
+//
+//==========================================================================
+
+static int ParseDemoTime (const char *str)
+{
+	const char *colon = strchr (str, ':');
+	double seconds = atof (colon != NULL ? colon + 1 : str);
+
+	if (colon != NULL)
+	{
+		seconds += atoi (str) * 60.;
+	}
+	return int(seconds * TICRATE);
+}
+
+static void StartDemoSeek (int target)
+{
+	DemoSeekUsed = true;
+	DemoSeekTarget = MAX (target, 0);
+	if (DemoSeekTarget != DemoTic)
+	{
+		gameaction = ga_demoseek;
+	}
+}
+
+CCMD (demoseek)
+{
+	if (!demoplayback)
+	{
+		Printf ("No demo is playing\n");
+		return;
+	}
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: demoseek <[mm:]ss>\n");
+		return;
+	}
+	StartDemoSeek (ParseDemoTime (argv[1]));
+}
+
+CCMD (demoskip)
+{
+	if (!demoplayback)
+	{
+		Printf ("No demo is playing\n");
+		return;
+	}
+	double seconds = argv.argc() > 1 ? atof (argv[1]) : 10.;
+	StartDemoSeek (DemoTic + int(seconds * TICRATE));
+}
+
+// Runs the rest of the demo without drawing it.
+CCMD (demoend)
+{
+	if (demoplayback)
+	{
+		DemoSeekTarget = INT_MAX;
+	}
+}
+
+ADD_STAT (demoseek)
+{
+	FString out;
+
+	out.Format ("tic %d (%d:%02d), %u index entries (%d keyframes), %u KB\n"
+		"last snapshot %.2f ms, last seek %.2f ms%s",
+		DemoTic, DemoTic / TICRATE / 60, (DemoTic / TICRATE) % 60,
+		DemoIndex.Size(), DemoIndex.NumKeyframes(), DemoIndex.MemoryUsage() >> 10,
+		DemoIndex.TakeCycles.TimeMS(), DemoSeekCycles.TimeMS(),
+		G_DemoFastForwarding() ? ", fast-forwarding" : "");
+	return out;
+}
+
 void G_DoPlayDemo (void)
 {
 	FString mapname;
@@ -2657,6 +3504,15 @@ void G_DoPlayDemo (void)
 		M_ReadFileMalloc (defdemoname, &demobuffer);
 	}
 	demo_p = demobuffer;
+	DemoTic = 0;
+	DemoSeekTarget = 0;
+	if (DemoIndexName.CompareNoCase (defdemoname) != 0)
+	{
+		DemoIndex.Clear ();
+		DemoIndexName = defdemoname;
+		DemoSeekSpacing = 1;
+		DemoSeekUsed = false;
+	}
 
 	Printf ("Playing demo %s\n", defdemoname.GetChars());
 
@@ -2794,33 +3650,41 @@ bool G_CheckDemoStatus (void)
 	if (demorecording)
 	{
 		BYTE *formlen;
+		bool saved;
 
 		WriteByte (DEM_STOP, &demo_p);
 
-		if (demo_compress)
-		{
-			// Now that the entire BODY chunk has been created, replace it with
-			// a compressed version. If the BODY successfully compresses, the
-			// contents of the COMP chunk will be changed to indicate the
-			// uncompressed size of the BODY.
-			uLong len = uLong(demo_p - demobodyspot);
-			uLong outlen = (len + len/100 + 12);
-			Byte *compressed = new Byte[outlen];
-			int r = compress2 (compressed, &outlen, demobodyspot, len, 9);
-			if (r == Z_OK && outlen < len)
+		if (DemoFile != NULL)
+		{
+			saved = G_FinishDemoFile ();
+		}
+		else
+		{
+			if (demo_compress)
 			{
-				formlen = democompspot;
-				WriteLong (len, &democompspot);
-				memcpy (demobodyspot, compressed, outlen);
-				demo_p = demobodyspot + outlen;
+				// Now that the entire BODY chunk has been created, replace it with
+				// a compressed version. If the BODY successfully compresses, the
+				// contents of the COMP chunk will be changed to indicate the
+				// uncompressed size of the BODY.
+				uLong len = uLong(demo_p - demobodyspot);
+				uLong outlen = (len + len/100 + 12);
+				Byte *compressed = new Byte[outlen];
+				int r = compress2 (compressed, &outlen, demobodyspot, len, 9);
+				if (r == Z_OK && outlen < len)
+				{
+					formlen = democompspot;
+					WriteLong (len, &democompspot);
+					memcpy (demobodyspot, compressed, outlen);
+					demo_p = demobodyspot + outlen;
+				}
+				delete[] compressed;
 			}
-			delete[] compressed;
-		}
-		FinishChunk (&demo_p);
-		formlen = demobuffer + 4;
-		WriteLong (int(demo_p - demobuffer - 8), &formlen);
+			FinishChunk (&demo_p);
+			formlen = demobuffer + 4;
+			WriteLong (int(demo_p - demobuffer - 8), &formlen);
 
-		bool saved = M_WriteFile (demoname, demobuffer, int(demo_p - demobuffer)); 
+			saved = M_WriteFile (demoname, demobuffer, int(demo_p - demobuffer));
+		}
 		M_Free (demobuffer); 
 		demorecording = false;
 		stoprecording = false;
@@ -43,6 +43,8 @@ void G_DoLoadGame (void);
 
 // Called by M_Responder.
 void G_SaveGame (const char *filename, const char *description);
+void G_CheckSaveGame ();
+void G_WaitForSaveGame ();
 
 // Only called by startup code.
 void G_RecordDemo (const char* name);
@@ -52,6 +54,7 @@ void G_BeginRecording (const char *startmap);
 void G_PlayDemo (char* name);
 void G_TimeDemo (const char* name);
 bool G_CheckDemoStatus (void);
+bool G_DemoFastForwarding ();
 
 void G_WorldDone (void);
 
@@ -83,6 +83,7 @@
 #include "r_data/colormaps.h"
 #include "farchive.h"
 #include "r_renderer.h"
+#include "stats.h"
 
 #include "gi.h"
 
@@ -1621,20 +1622,34 @@ void G_SnapshotLevel ()
 //
 //==========================================================================
 
+double UnSnapshotInflateMS, UnSnapshotReadMS;
+
 void G_UnSnapshotLevel (bool hubLoad)
 {
+	UnSnapshotInflateMS = UnSnapshotReadMS = 0;
+
 	if (level.info->snapshot == NULL)
 		return;
 
 	if (level.info->isValid())
 	{
+		cycle_t inflatetime, readtime;
+
+		inflatetime.Reset();
+		readtime.Reset();
 		SaveVersion = level.info->snapshotVer;
+		inflatetime.Clock();
 		level.info->snapshot->Reopen ();
+		inflatetime.Unclock();
+		readtime.Clock();
 		FArchive arc (*level.info->snapshot);
 		if (hubLoad)
 			arc.SetHubTravel ();
 		G_SerializeLevel (arc, hubLoad);
 		arc.Close ();
+		readtime.Unclock();
+		UnSnapshotInflateMS = inflatetime.TimeMS();
+		UnSnapshotReadMS = readtime.TimeMS();
 		level.FromSnapshot = true;
 
 		TThinkerIterator<APlayerPawn> it;
@@ -1683,6 +1698,47 @@ static void writeSnapShot (FArchive &arc, level_info_t *i)
 	i->snapshot->Serialize (arc);
 }
 
+//==========================================================================
+//
+// G_SnapshotLevelForSave
+//
+// Like G_SnapshotLevel, but leaves the current level's data uncompressed
+// and outside of level.info so the savegame writer can pack it later.
+// header receives what writeSnapShot puts in front of the level data.
+// Returns the ID of the chunk to store it in, or 0 if there is nothing
+// to store.
+//
+//==========================================================================
+
+DWORD G_SnapshotLevelForSave (FCompressedMemFile &header, FCompressedMemFile &snapshot)
+{
+	level.info->ClearSnapshot();
+
+	if (!level.info->isValid())
+	{
+		return 0;
+	}
+
+	DWORD snapver = SAVEVER;
+	FString mapname = level.info->MapName;
+
+	header.Open ();
+	header.StoreUncompressed ();
+	{
+		FArchive arc (header);
+		arc << snapver << mapname;
+	}
+
+	snapshot.Open ();
+	snapshot.StoreUncompressed ();
+	{
+		FArchive arc (snapshot);
+		SaveVersion = SAVEVER;
+		G_SerializeLevel (arc, false);
+	}
+	return level.info == &TheDefaultLevelInfo ? DSNP_ID : SNAP_ID;
+}
+
 //==========================================================================
 //
 //
@@ -540,9 +540,12 @@ void G_ClearSnapshots (void);
 void P_RemoveDefereds ();
 void G_SnapshotLevel (void);
 void G_UnSnapshotLevel (bool keepPlayers);
+extern double UnSnapshotInflateMS, UnSnapshotReadMS;	// Time spent by the last G_UnSnapshotLevel
 struct PNGHandle;
 void G_ReadSnapshots (PNGHandle *png);
 void G_WriteSnapshots (FILE *file);
+class FCompressedMemFile;
+DWORD G_SnapshotLevelForSave (FCompressedMemFile &header, FCompressedMemFile &snapshot);
 void G_ClearHubInfo();
 
 enum ESkillProperty
@@ -0,0 +1,788 @@
+// DESCRIPTION:
+//      In-memory level snapshots and the rewind buffer built on them.
+//
+// FLevelSnapshotList serializes the level into memory. Most snapshots are
+// stored as a delta against the previous one: runs of bytes that also
+// occur in the previous snapshot are replaced by references to it, which
+// handles the shifting that spawned and removed actors cause in the
+// stream. Every few snapshots a keyframe is stored in full so that no
+// delta chain gets long.
+//
+// The rewind buffer takes a snapshot every rewind_interval tics together
+// with the input of every tic until the next one. Rewinding restores the
+// closest snapshot before the target tic and replays the input from there.
+
+
+#include <zlib.h>
+#include "doomstat.h"
+#include "g_rewind.h"
+#include "g_level.h"
+#include "g_game.h"
+#include "d_event.h"
+#include "d_net.h"
+#include "d_protocol.h"
+#include "d_player.h"
+#include "p_tick.h"
+#include "p_acs.h"
+#include "m_random.h"
+#include "m_swap.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "farchive.h"
+#include "stats.h"
+#include "tarray.h"
+#include "version.h"
+
+CVAR (Bool, cl_rewind, false, 0)
+CUSTOM_CVAR (Int, rewind_interval, 35, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 1)
+		self = 1;
+}
+CUSTOM_CVAR (Int, rewind_snapshots, 60, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 1)
+		self = 1;
+}
+
+void G_SerializeLevel (FArchive &arc, bool hubLoad);
+
+enum
+{
+	KEYFRAME_INTERVAL = 8,		// A full snapshot is stored every this many
+	DELTA_BLOCK = 16,			// Minimum length of a match against the previous snapshot
+	DELTA_HASHBITS = 20,
+	TIC_END = 0xff,
+	TIC_PENDING = 0xff,			// Whether the tic advanced level.time is not known yet
+};
+
+static FLevelSnapshotList Rewind;
+static int RewindTarget;
+static int LastTicTime;			// level.time when the newest tic was recorded
+static unsigned int LastTicPos;	// its position in Rewind.Last().Extra
+static int ReplayedTics;
+
+//==========================================================================
+//
+// Varints for the delta stream
+//
+//==========================================================================
+
+static void WriteVarint (TArray<BYTE> &out, unsigned int v)
+{
+	while (v >= 0x80)
+	{
+		out.Push (BYTE(v | 0x80));
+		v >>= 7;
+	}
+	out.Push (BYTE(v));
+}
+
+static bool ReadVarint (const BYTE *&p, const BYTE *end, unsigned int &v)
+{
+	int shift = 0;
+
+	v = 0;
+	while (p < end && shift < 32)
+	{
+		BYTE b = *p++;
+		v |= (b & 0x7f) << shift;
+		if (!(b & 0x80))
+		{
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+static inline unsigned int HashBlock (const BYTE *p)
+{
+	DWORD w[4];
+
+	memcpy (w, p, sizeof(w));
+	return ((w[0] * 0x9E3779B1u) ^ (w[1] * 0x85EBCA77u) ^ (w[2] * 0xC2B2AE3Du) ^ (w[3] * 0x27D4EB2Fu))
+		>> (32 - DELTA_HASHBITS);
+}
+
+//==========================================================================
+//
+// EncodeDelta
+//
+// Describes data as a list of literal runs and copies from ref. Each op
+// starts with a varint holding its length shifted left by one, with the
+// low bit set for copies, which are followed by the offset into ref.
+//
+//==========================================================================
+
+static void FlushLiterals (TArray<BYTE> &out, const BYTE *data, unsigned int start, unsigned int end)
+{
+	if (end > start)
+	{
+		WriteVarint (out, (end - start) << 1);
+		unsigned int pos = out.Reserve (end - start);
+		memcpy (&out[pos], data + start, end - start);
+	}
+}
+
+static void EncodeDelta (TArray<BYTE> &out, const BYTE *ref, unsigned int reflen, const BYTE *data, unsigned int len)
+{
+	static TArray<int> table;
+	unsigned int i, litstart;
+
+	table.Resize (1 << DELTA_HASHBITS);
+	memset (&table[0], -1, table.Size() * sizeof(int));
+	for (i = 0; i + DELTA_BLOCK <= reflen; i += DELTA_BLOCK)
+	{
+		table[HashBlock (ref + i)] = i;
+	}
+
+	out.Clear ();
+	i = litstart = 0;
+	while (i + DELTA_BLOCK <= len)
+	{
+		int cand = table[HashBlock (data + i)];
+
+		if (cand < 0 || memcmp (ref + cand, data + i, DELTA_BLOCK) != 0)
+		{
+			i++;
+			continue;
+		}
+
+		unsigned int from = cand;
+		unsigned int n = DELTA_BLOCK;
+
+		// Grow the match in both directions.
+		while (i + n < len && from + n < reflen && data[i + n] == ref[from + n])
+		{
+			n++;
+		}
+		while (i > litstart && from > 0 && data[i - 1] == ref[from - 1])
+		{
+			i--;
+			from--;
+			n++;
+		}
+
+		FlushLiterals (out, data, litstart, i);
+		WriteVarint (out, (n << 1) | 1);
+		WriteVarint (out, from);
+		i += n;
+		litstart = i;
+	}
+	FlushLiterals (out, data, litstart, len);
+}
+
+static bool DecodeDelta (TArray<BYTE> &out, unsigned int len, const BYTE *ref, unsigned int reflen,
+	const BYTE *ops, unsigned int opslen)
+{
+	const BYTE *end = ops + opslen;
+	unsigned int pos = 0;
+
+	out.Resize (len);
+	while (ops < end)
+	{
+		unsigned int op, n, from;
+
+		if (!ReadVarint (ops, end, op))
+		{
+			return false;
+		}
+		n = op >> 1;
+		if (pos + n > len)
+		{
+			return false;
+		}
+		if (op & 1)
+		{
+			if (!ReadVarint (ops, end, from) || from + n > reflen)
+			{
+				return false;
+			}
+			memcpy (&out[pos], ref + from, n);
+		}
+		else
+		{
+			if (ops + n > end)
+			{
+				return false;
+			}
+			memcpy (&out[pos], ops, n);
+			ops += n;
+		}
+		pos += n;
+	}
+	return pos == len;
+}
+
+//==========================================================================
+//
+// Deflate / Inflate
+//
+//==========================================================================
+
+static void Deflate (TArray<BYTE> &out, const BYTE *data, unsigned int len)
+{
+	uLongf outlen = compressBound (len);
+
+	out.Resize ((unsigned int)outlen);
+	if (compress2 (&out[0], &outlen, data, len, Z_BEST_SPEED) != Z_OK)
+	{
+		outlen = 0;
+	}
+	out.Resize ((unsigned int)outlen);
+	out.ShrinkToFit ();
+}
+
+static bool Inflate (TArray<BYTE> &out, const TArray<BYTE> &data, unsigned int len)
+{
+	uLongf outlen = len;
+
+	out.Resize (len);
+	return data.Size() > 0 && uncompress (&out[0], &outlen, &data[0], data.Size()) == Z_OK && outlen == len;
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList
+//
+//==========================================================================
+
+FLevelSnapshotList::FLevelSnapshotList ()
+{
+	SinceKeyframe = 0;
+	TakeCycles.Reset ();
+	RestoreCycles.Reset ();
+}
+
+void FLevelSnapshotList::Clear ()
+{
+	Snapshots.Clear ();
+	LastRaw.Clear ();
+	LastRaw.ShrinkToFit ();
+	SinceKeyframe = 0;
+}
+
+unsigned int FLevelSnapshotList::MemoryUsage () const
+{
+	unsigned int mem = LastRaw.Size();
+
+	for (unsigned int i = 0; i < Snapshots.Size(); ++i)
+	{
+		mem += Snapshots[i].Data.Size() + Snapshots[i].Extra.Size();
+	}
+	return mem;
+}
+
+int FLevelSnapshotList::NumKeyframes () const
+{
+	int count = 0;
+
+	for (unsigned int i = 0; i < Snapshots.Size(); ++i)
+	{
+		count += Snapshots[i].Keyframe;
+	}
+	return count;
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList :: Find
+//
+// Returns the newest snapshot of the current level taken at or before
+// time, or -1 if there is none.
+//
+//==========================================================================
+
+int FLevelSnapshotList::Find (int time) const
+{
+	for (int i = Snapshots.Size() - 1; i >= 0; --i)
+	{
+		if (Snapshots[i].Time <= time && Snapshots[i].MapName.CompareNoCase (level.MapName) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList :: Take
+//
+// Appends a snapshot of the current level. The caller can attach its own
+// data to the returned entry.
+//
+//==========================================================================
+
+FLevelSnapshot &FLevelSnapshotList::Take ()
+{
+	FCompressedMemFile file;
+	const BYTE *raw;
+	unsigned int len;
+
+	TakeCycles.Reset ();
+	TakeCycles.Clock ();
+
+	file.Open ();
+	file.StoreUncompressed ();
+	{
+		FArchive arc (file);
+		SaveVersion = SAVEVER;
+		FRandom::StaticSerializeRNGState (arc);
+		G_SerializeLevel (arc, false);
+		P_SerializeACSVars (arc);
+	}
+	raw = file.GetStoredData (len);
+
+	FLevelSnapshot &snap = Snapshots[Snapshots.Reserve (1)];
+	snap.Time = level.time;
+	snap.MapName = level.MapName;
+	snap.RawSize = len;
+	// A delta against another level would be all literals.
+	snap.Keyframe = Snapshots.Size() == 1 || LastRaw.Size() == 0 ||
+		snap.MapName.CompareNoCase (Snapshots[Snapshots.Size() - 2].MapName) != 0 ||
+		++SinceKeyframe >= KEYFRAME_INTERVAL;
+	if (snap.Keyframe)
+	{
+		SinceKeyframe = 0;
+		snap.PackedSize = len;
+		Deflate (snap.Data, raw, len);
+	}
+	else
+	{
+		TArray<BYTE> ops;
+		EncodeDelta (ops, &LastRaw[0], LastRaw.Size(), raw, len);
+		snap.PackedSize = ops.Size();
+		Deflate (snap.Data, &ops[0], ops.Size());
+	}
+	LastRaw.Resize (len);
+	memcpy (&LastRaw[0], raw, len);
+
+	TakeCycles.Unclock ();
+	return snap;
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList :: Trim
+//
+// Drops the oldest snapshots until no more than limit are left. Whole
+// keyframe groups go at once so that every delta keeps its base.
+//
+//==========================================================================
+
+void FLevelSnapshotList::Trim (unsigned int limit)
+{
+	while (Snapshots.Size() > limit)
+	{
+		unsigned int next;
+		for (next = 1; next < Snapshots.Size() && !Snapshots[next].Keyframe; ++next)
+		{
+		}
+		if (next == Snapshots.Size())
+		{
+			break;
+		}
+		Snapshots.Delete (0, next);
+	}
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList :: Thin
+//
+// Drops every other keyframe group until no more than limit snapshots are
+// left, so that the remaining ones still cover the whole time span. The
+// newest group is kept because new snapshots are deltas against it.
+// Returns false if nothing could be dropped.
+//
+//==========================================================================
+
+bool FLevelSnapshotList::Thin (unsigned int limit)
+{
+	bool thinned = false;
+
+	while (Snapshots.Size() > limit)
+	{
+		unsigned int before = Snapshots.Size();
+		unsigned int group = 0;
+		unsigned int i = 0;
+
+		while (i < Snapshots.Size())
+		{
+			unsigned int next;
+			for (next = i + 1; next < Snapshots.Size() && !Snapshots[next].Keyframe; ++next)
+			{
+			}
+			if ((group++ & 1) && next < Snapshots.Size())
+			{
+				Snapshots.Delete (i, next - i);
+			}
+			else
+			{
+				i = next;
+			}
+		}
+		if (Snapshots.Size() == before)
+		{
+			break;
+		}
+		thinned = true;
+	}
+	return thinned;
+}
+
+//==========================================================================
+//
+// FLevelSnapshotList :: Restore
+//
+// Brings the current level back to the state of the given snapshot, which
+// must belong to it. With truncate, everything after the snapshot is
+// discarded and new snapshots continue from it.
+//
+//==========================================================================
+
+bool FLevelSnapshotList::Restore (unsigned int index, bool truncate)
+{
+	unsigned int key, i;
+
+	RestoreCycles.Reset ();
+	RestoreCycles.Clock ();
+
+	for (key = index; !Snapshots[key].Keyframe; --key)
+	{
+	}
+
+	// Rebuild the level data from the keyframe and the deltas after it.
+	TArray<BYTE> buffers[2], ops;
+	TArray<BYTE> *raw = &buffers[0], *next = &buffers[1];
+	bool ok = Inflate (*raw, Snapshots[key].Data, Snapshots[key].RawSize);
+	for (i = key + 1; ok && i <= index; ++i)
+	{
+		ok = Inflate (ops, Snapshots[i].Data, Snapshots[i].PackedSize) &&
+			DecodeDelta (*next, Snapshots[i].RawSize, &(*raw)[0], raw->Size(), &ops[0], ops.Size());
+		TArray<BYTE> *t = raw;
+		raw = next;
+		next = t;
+	}
+	if (!ok)
+	{
+		RestoreCycles.Unclock ();
+		Clear ();
+		return false;
+	}
+
+	// FCompressedMemFile reads from an imploded buffer, so give it a
+	// header that marks the data as stored.
+	unsigned int len = raw->Size();
+	BYTE *block = (BYTE *)M_Malloc (len + 8);
+	((DWORD *)block)[0] = 0;
+	((DWORD *)block)[1] = BigLong(len);
+	memcpy (block + 8, &(*raw)[0], len);
+	{
+		FCompressedMemFile file;
+		file.Open (block);
+		FArchive arc (file);
+		SaveVersion = SAVEVER;
+		FRandom::StaticSerializeRNGState (arc);
+		G_SerializeLevel (arc, false);
+		P_SerializeACSVars (arc);
+	}
+	M_Free (block);
+	level.time = Snapshots[index].Time;
+
+	if (truncate)
+	{
+		Snapshots.Resize (index + 1);
+		SinceKeyframe = index - key;
+		LastRaw = *raw;
+	}
+
+	RestoreCycles.Unclock ();
+	return true;
+}
+
+//==========================================================================
+//
+// G_ClearRewind
+//
+//==========================================================================
+
+void G_ClearRewind ()
+{
+	Rewind.Clear ();
+}
+
+//==========================================================================
+//
+// FinishLastTic
+//
+// Notes whether the newest recorded tic actually ran. It doesn't when the
+// game is paused, but its net commands still need to be replayed.
+//
+//==========================================================================
+
+static void FinishLastTic ()
+{
+	if (Rewind.Size() > 0 && Rewind.Last().Extra.Size() > 0)
+	{
+		BYTE &ran = Rewind.Last().Extra[LastTicPos];
+		if (ran == TIC_PENDING)
+		{
+			ran = level.time != LastTicTime;
+		}
+	}
+}
+
+//==========================================================================
+//
+// G_RewindTicker
+//
+// Called by G_Ticker once the commands for this tic are known but before
+// they are run.
+//
+//==========================================================================
+
+void G_RewindTicker (int buf)
+{
+	if (!cl_rewind || gamestate != GS_LEVEL || netgame || demoplayback || demorecording)
+	{
+		if (Rewind.Size() > 0)
+		{
+			Rewind.Clear ();
+		}
+		return;
+	}
+
+	// A new level or a loaded game invalidates everything recorded so far.
+	if (Rewind.Size() > 0 && (Rewind.Last().MapName.CompareNoCase (level.MapName) != 0 ||
+		level.time < LastTicTime || level.time > LastTicTime + 1))
+	{
+		Rewind.Clear ();
+	}
+	FinishLastTic ();
+	if (Rewind.Size() == 0 || level.time - Rewind.Last().Time >= rewind_interval)
+	{
+		Rewind.Take ();
+		Rewind.Trim (rewind_snapshots);
+	}
+
+	TArray<BYTE> &tics = Rewind.Last().Extra;
+	LastTicTime = level.time;
+	LastTicPos = tics.Push (TIC_PENDING);
+	for (int i = 0; i < MAXPLAYERS; ++i)
+	{
+		if (playeringame[i])
+		{
+			int len;
+			BYTE *spec = NetSpecs[i][buf].GetData (&len);
+			if (spec == NULL)
+			{
+				len = 0;
+			}
+			unsigned int pos = tics.Reserve (1 + sizeof(ticcmd_t) + 2 + len);
+			BYTE *p = &tics[pos];
+			*p++ = BYTE(i);
+			memcpy (p, &netcmds[i][buf], sizeof(ticcmd_t));
+			p += sizeof(ticcmd_t);
+			*p++ = BYTE(len);
+			*p++ = BYTE(len >> 8);
+			if (len > 0)
+			{
+				memcpy (p, spec, len);
+			}
+		}
+	}
+	tics.Push (TIC_END);
+}
+
+//==========================================================================
+//
+// IsPlaysimCommand
+//
+// Only commands that change the level are replayed. Saving, chat, map
+// changes, pausing and setting changes already had their effect when
+// they were recorded and must not happen again.
+//
+//==========================================================================
+
+static bool IsPlaysimCommand (int type)
+{
+	switch (type)
+	{
+	case DEM_GENERICCHEAT:
+	case DEM_GIVECHEAT:
+	case DEM_TAKECHEAT:
+	case DEM_WARPCHEAT:
+	case DEM_KILLCLASSCHEAT:
+	case DEM_MORPHEX:
+	case DEM_SUICIDE:
+	case DEM_ADDBOT:
+	case DEM_KILLBOTS:
+	case DEM_INVUSEALL:
+	case DEM_INVUSE:
+	case DEM_INVDROP:
+	case DEM_SUMMON:
+	case DEM_SUMMONFRIEND:
+	case DEM_SUMMONFOE:
+	case DEM_SUMMON2:
+	case DEM_SUMMONFRIEND2:
+	case DEM_SUMMONFOE2:
+	case DEM_SUMMONMBF:
+	case DEM_REMOVE:
+	case DEM_FOV:
+	case DEM_MYFOV:
+	case DEM_CENTERVIEW:
+	case DEM_CROUCH:
+	case DEM_SPRAY:
+	case DEM_RUNSCRIPT:
+	case DEM_RUNSCRIPT2:
+	case DEM_RUNNAMEDSCRIPT:
+	case DEM_RUNSPECIAL:
+	case DEM_ADDSLOTDEFAULT:
+	case DEM_ADDSLOT:
+	case DEM_SETSLOT:
+	case DEM_SETSLOTPNUM:
+	case DEM_CONVREPLY:
+	case DEM_CONVCLOSE:
+	case DEM_CONVNULL:
+	case DEM_SETPITCHLIMIT:
+	case DEM_REVERTCAMERA:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+//==========================================================================
+//
+// ReplayTic
+//
+// Runs one recorded tic the way G_Ticker would have.
+//
+//==========================================================================
+
+static const BYTE *ReplayTic (const BYTE *p)
+{
+	bool ran = *p++ == 1;
+
+	while (*p != TIC_END)
+	{
+		int i = *p++;
+		ticcmd_t *cmd = &players[i].cmd;
+
+		players[i].oldbuttons = cmd->ucmd.buttons;
+		memcpy (cmd, p, sizeof(ticcmd_t));
+		p += sizeof(ticcmd_t);
+
+		int len = p[0] | (p[1] << 8);
+		BYTE *stream = (BYTE *)p + 2;
+		BYTE *end = stream + len;
+		while (stream < end)
+		{
+			int type = ReadByte (&stream);
+			if (IsPlaysimCommand (type))
+			{
+				Net_DoCommand (type, &stream, i);
+			}
+			else
+			{
+				Net_SkipCommand (type, &stream);
+			}
+		}
+		p += 2 + len;
+	}
+	if (ran)
+	{
+		rewindreplay = true;
+		P_Ticker ();
+		rewindreplay = false;
+	}
+	return p + 1;
+}
+
+//==========================================================================
+//
+// G_DoRewind
+//
+// Brings the level back to RewindTarget. Everything recorded after that
+// point is discarded, since play continues from there with new input.
+//
+//==========================================================================
+
+void G_DoRewind ()
+{
+	gameaction = ga_nothing;
+	FinishLastTic ();
+
+	int index = Rewind.Find (MAX (RewindTarget, Rewind.Size() > 0 ? Rewind[0].Time : 0));
+	if (index < 0)
+	{
+		Printf ("Nothing to rewind to\n");
+		return;
+	}
+	if (!Rewind.Restore (index, true))
+	{
+		Printf ("Rewind data is corrupt\n");
+		return;
+	}
+
+	// Replay the input up to the target tic.
+	FLevelSnapshot &snap = Rewind[index];
+	const BYTE *start = snap.Extra.Size() > 0 ? &snap.Extra[0] : NULL;
+	const BYTE *p = start, *end = start + snap.Extra.Size();
+	unsigned int pos = 0;
+
+	while (level.time < RewindTarget && p < end)
+	{
+		pos = unsigned(p - start);
+		p = ReplayTic (p);
+	}
+	ReplayedTics = level.time - snap.Time;
+	snap.Extra.Resize (unsigned(p - start));
+	LastTicTime = level.time - (snap.Extra.Size() > 0);
+	LastTicPos = pos;
+
+	Printf ("Rewound to %d:%02d\n", level.time / TICRATE / 60, (level.time / TICRATE) % 60);
+}
+
+//==========================================================================
+//
+// CCMD rewind
+//
+//==========================================================================
+
+CCMD (rewind)
+{
+	if (!cl_rewind)
+	{
+		Printf ("Rewinding is off; set cl_rewind to 1 to enable it\n");
+		return;
+	}
+	if (netgame || demoplayback || demorecording || gamestate != GS_LEVEL)
+	{
+		Printf ("Rewinding is only available in single player games\n");
+		return;
+	}
+	double seconds = argv.argc() > 1 ? atof (argv[1]) : 5.;
+	RewindTarget = level.time - int(seconds * TICRATE);
+	gameaction = ga_rewind;
+}
+
+ADD_STAT (rewind)
+{
+	FString out;
+	unsigned int raw = 0;
+
+	for (unsigned int i = 0; i < Rewind.Size(); ++i)
+	{
+		raw += Rewind[i].RawSize;
+	}
+	out.Format ("%u snapshots (%d keyframes), %u KB held for %u KB of level data\n"
+		"last snapshot %.2f ms, last restore %.2f ms (%d tics replayed)",
+		Rewind.Size(), Rewind.NumKeyframes(), Rewind.MemoryUsage() >> 10, raw >> 10,
+		Rewind.TakeCycles.TimeMS(), Rewind.RestoreCycles.TimeMS(), ReplayedTics);
+	return out;
+}
@@ -0,0 +1,50 @@
+#ifndef __G_REWIND_H
+#define __G_REWIND_H
+
+#include "tarray.h"
+#include "zstring.h"
+#include "stats.h"
+
+struct FLevelSnapshot
+{
+	int Time;					// level.time the snapshot was taken at
+	FString MapName;
+	bool Keyframe;
+	unsigned int RawSize;		// size of the serialized level
+	unsigned int PackedSize;	// size of Data once inflated
+	TArray<BYTE> Data;			// deflated level or delta against the previous snapshot
+	TArray<BYTE> Extra;			// the owner's data for this snapshot
+};
+
+// Level snapshots held in memory, delta-encoded against each other
+class FLevelSnapshotList
+{
+public:
+	FLevelSnapshotList ();
+
+	void Clear ();
+	FLevelSnapshot &Take ();
+	void Trim (unsigned int limit);
+	bool Thin (unsigned int limit);
+	int Find (int time) const;
+	bool Restore (unsigned int index, bool truncate);
+
+	unsigned int Size () const { return Snapshots.Size(); }
+	FLevelSnapshot &operator[] (unsigned int index) const { return Snapshots[index]; }
+	FLevelSnapshot &Last () const { return Snapshots.Last(); }
+	unsigned int MemoryUsage () const;
+	int NumKeyframes () const;
+
+	cycle_t TakeCycles, RestoreCycles;
+
+private:
+	TArray<FLevelSnapshot> Snapshots;
+	TArray<BYTE> LastRaw;		// The newest snapshot's level data, for delta encoding
+	int SinceKeyframe;
+};
+
+void G_RewindTicker (int buf);
+void G_DoRewind ();
+void G_ClearRewind ();
+
+#endif
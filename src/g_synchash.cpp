@@ -0,0 +1,373 @@
+// DESCRIPTION:
+//      World state hashing for finding where network games and demos go
+//      out of sync.
+//
+// With net_synchash on, the actors, RNGs, sector heights and ACS variables
+// are hashed separately after every tic. In network games and while
+// recording demos the hashes are also sent as a net command, so other
+// nodes and later demo playback can compare them with their own. After
+// the first mismatch every node writes a report of its state at the same
+// later tic, and diffing those shows what went out of sync.
+
+
+#include <stdio.h>
+#include "doomstat.h"
+#include "g_synchash.h"
+#include "g_level.h"
+#include "d_net.h"
+#include "d_protocol.h"
+#include "d_player.h"
+#include "actor.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "p_acs.h"
+#include "m_random.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+
+enum ESyncHash
+{
+	SYNC_Actors,
+	SYNC_RNG,
+	SYNC_Sectors,
+	SYNC_ACS,
+
+	NUM_SYNCHASHES
+};
+
+enum
+{
+	SYNCHASH_HISTORY = BACKUPTICS * 2,	// Hashes older than this can't arrive anymore
+	REPORT_DELAY = BACKUPTICS * 2,		// Every node has seen the mismatch by then
+};
+
+struct FSyncHash
+{
+	int Tic;
+	DWORD Hash[NUM_SYNCHASHES];
+};
+
+static const char *const SubsystemNames[NUM_SYNCHASHES] = { "actors", "rng", "sectors", "acs" };
+
+static FSyncHash History[SYNCHASH_HISTORY];
+static int LastHashTic;
+static int ReportTic;			// When to write the report, or -1
+static bool Reported;
+static FString Mismatch;		// What the first mismatch was, for the report
+static int Checks, Mismatches;
+static cycle_t HashCycles;
+
+static void ClearSyncHash ()
+{
+	for (int i = 0; i < SYNCHASH_HISTORY; ++i)
+	{
+		History[i].Tic = -1;
+	}
+	LastHashTic = -1;
+	ReportTic = -1;
+	Reported = false;
+	Mismatch = "";
+	Checks = Mismatches = 0;
+}
+
+CUSTOM_CVAR (Bool, net_synchash, false, 0)
+{
+	ClearSyncHash ();
+}
+
+//==========================================================================
+//
+// Hashing
+//
+// 32-bit FNV-1a over whole values. Everything hashed is an integer, so
+// the result is the same on every machine.
+//
+//==========================================================================
+
+static inline DWORD HashValue (DWORD hash, DWORD value)
+{
+	return (hash ^ value) * 0x01000193;
+}
+
+// Dynamic lights are skipped: the renderer spawns and moves them, so
+// they differ between nodes that use different renderers or settings.
+
+static DWORD HashActors (FString *report)
+{
+	AActor *mo;
+	DWORD hash = 0x811c9dc5;
+
+	for (int stat = 0; stat <= MAX_STATNUM; ++stat)
+	{
+		if (stat == STAT_DLIGHT)
+		{
+			continue;
+		}
+		TThinkerIterator<AActor> it (stat);
+		while ((mo = it.Next()) != NULL)
+		{
+			hash = HashValue (hash, mo->X());
+			hash = HashValue (hash, mo->Y());
+			hash = HashValue (hash, mo->Z());
+			hash = HashValue (hash, mo->angle);
+			hash = HashValue (hash, mo->velx);
+			hash = HashValue (hash, mo->vely);
+			hash = HashValue (hash, mo->velz);
+			hash = HashValue (hash, mo->health);
+			if (report != NULL)
+			{
+				report->AppendFormat ("actor %s tid %d pos %d %d %d angle %u vel %d %d %d health %d\n",
+					mo->GetClass()->TypeName.GetChars(), mo->tid, mo->X(), mo->Y(), mo->Z(),
+					mo->angle, mo->velx, mo->vely, mo->velz, mo->health);
+			}
+		}
+	}
+	return hash;
+}
+
+static DWORD HashSectors (FString *report)
+{
+	DWORD hash = 0x811c9dc5;
+
+	for (int i = 0; i < numsectors; ++i)
+	{
+		hash = HashValue (hash, sectors[i].floorplane.d);
+		hash = HashValue (hash, sectors[i].ceilingplane.d);
+		if (report != NULL)
+		{
+			report->AppendFormat ("sector %d floor %d ceiling %d\n",
+				i, sectors[i].floorplane.d, sectors[i].ceilingplane.d);
+		}
+	}
+	return hash;
+}
+
+static DWORD HashACSVars (FString *report, const char *type, int module, const SDWORD *const *vars, int count, DWORD hash)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		hash = HashValue (hash, *vars[i]);
+		if (report != NULL && *vars[i] != 0)
+		{
+			report->AppendFormat ("%s %d %d %d\n", type, module, i, *vars[i]);
+		}
+	}
+	return hash;
+}
+
+static DWORD HashACS (FString *report)
+{
+	const SDWORD *vars[MAX (NUM_WORLDVARS, NUM_GLOBALVARS)];
+	DWORD hash = 0x811c9dc5;
+	FBehavior *module;
+	int i;
+
+	for (i = 0; i < NUM_WORLDVARS; ++i)
+	{
+		vars[i] = &ACS_WorldVars[i];
+	}
+	hash = HashACSVars (report, "world", 0, vars, NUM_WORLDVARS, hash);
+	for (i = 0; i < NUM_GLOBALVARS; ++i)
+	{
+		vars[i] = &ACS_GlobalVars[i];
+	}
+	hash = HashACSVars (report, "global", 0, vars, NUM_GLOBALVARS, hash);
+	for (i = 0; (module = FBehavior::StaticGetModule (i)) != NULL; ++i)
+	{
+		hash = HashACSVars (report, "map", i, module->MapVars, NUM_MAPVARS, hash);
+	}
+	return hash;
+}
+
+static void ComputeHashes (DWORD hash[NUM_SYNCHASHES], FString *report)
+{
+	hash[SYNC_Actors] = HashActors (report);
+	hash[SYNC_RNG] = FRandom::StaticHashStates (report);
+	hash[SYNC_Sectors] = HashSectors (report);
+	hash[SYNC_ACS] = HashACS (report);
+}
+
+//==========================================================================
+//
+// WriteReport
+//
+// Writes everything that goes into the hashes to a text file, one line
+// per item, so that the reports of two nodes can be compared with diff.
+//
+//==========================================================================
+
+static void WriteReport (const char *filename)
+{
+	FString body, report;
+	DWORD hash[NUM_SYNCHASHES];
+
+	ComputeHashes (hash, &body);
+	report.Format ("map %s tic %d\n", level.MapName.GetChars(), level.totaltime);
+	for (int i = 0; i < NUM_SYNCHASHES; ++i)
+	{
+		report.AppendFormat ("%s %08x\n", SubsystemNames[i], hash[i]);
+	}
+	report << Mismatch << body;
+
+	FILE *file = fopen (filename, "w");
+	if (file == NULL)
+	{
+		Printf ("Could not write %s\n", filename);
+		return;
+	}
+	fputs (report, file);
+	fclose (file);
+	Printf ("Wrote sync report %s\n", filename);
+}
+
+static void WriteReport ()
+{
+	FString filename;
+
+	filename.Format ("synchash-%s-%d-p%d.txt", level.MapName.GetChars(), level.totaltime, consoleplayer);
+	WriteReport (filename);
+}
+
+//==========================================================================
+//
+// G_SyncHashTicker
+//
+// Called by G_Ticker after the tic has run.
+//
+//==========================================================================
+
+void G_SyncHashTicker ()
+{
+	if (!net_synchash || gamestate != GS_LEVEL || level.totaltime == LastHashTic)
+	{
+		return;
+	}
+
+	int tic = level.totaltime;
+	FSyncHash &entry = History[tic % SYNCHASH_HISTORY];
+
+	HashCycles.Reset ();
+	HashCycles.Clock ();
+	entry.Tic = tic;
+	ComputeHashes (entry.Hash, NULL);
+	LastHashTic = tic;
+	HashCycles.Unclock ();
+
+	if (!demoplayback && (netgame || demorecording))
+	{
+		Net_WriteByte (DEM_SYNCHASH);
+		Net_WriteLong (tic);
+		for (int i = 0; i < NUM_SYNCHASHES; ++i)
+		{
+			Net_WriteLong (entry.Hash[i]);
+		}
+	}
+
+	if (ReportTic >= 0 && tic >= ReportTic)
+	{
+		ReportTic = -1;
+		WriteReport ();
+	}
+}
+
+//==========================================================================
+//
+// G_ReadSyncHash
+//
+// Handles DEM_SYNCHASH from another node or a demo.
+//
+//==========================================================================
+
+void G_ReadSyncHash (int player, BYTE **stream)
+{
+	DWORD hash[NUM_SYNCHASHES];
+	int tic = ReadLong (stream);
+
+	for (int i = 0; i < NUM_SYNCHASHES; ++i)
+	{
+		hash[i] = ReadLong (stream);
+	}
+	if (!net_synchash || tic < 0 || (player == consoleplayer && !demoplayback))
+	{
+		return;
+	}
+
+	const FSyncHash &entry = History[tic % SYNCHASH_HISTORY];
+	if (entry.Tic != tic)
+	{
+		return;
+	}
+
+	FString differ;
+	Checks++;
+	for (int i = 0; i < NUM_SYNCHASHES; ++i)
+	{
+		if (hash[i] != entry.Hash[i])
+		{
+			if (differ.IsNotEmpty())
+			{
+				differ << ", ";
+			}
+			differ << SubsystemNames[i];
+		}
+	}
+	if (differ.IsEmpty())
+	{
+		return;
+	}
+
+	Mismatches++;
+	if (!Reported)
+	{
+		const char *other = demoplayback ? "the demo" : players[player].userinfo.GetName();
+
+		Reported = true;
+		ReportTic = tic + REPORT_DELAY;
+		Mismatch.Format ("first mismatch with %s at tic %d: %s\n", other, tic, differ.GetChars());
+		Printf (PRINT_BOLD, "Out of sync with %s at tic %d (%s); report follows at tic %d\n",
+			other, tic, differ.GetChars(), ReportTic);
+	}
+}
+
+//==========================================================================
+//
+// CCMD synchashdump
+//
+// Writes a report for the current tic.
+//
+//==========================================================================
+
+CCMD (synchashdump)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf ("Not in a level\n");
+		return;
+	}
+	if (argv.argc() > 1)
+	{
+		WriteReport (argv[1]);
+	}
+	else
+	{
+		WriteReport ();
+	}
+}
+
+ADD_STAT (synchash)
+{
+	FString out;
+
+	if (!net_synchash || LastHashTic < 0)
+	{
+		return "Sync hashing is off";
+	}
+
+	const FSyncHash &entry = History[LastHashTic % SYNCHASH_HISTORY];
+	out.Format ("tic %d: actors %08x rng %08x sectors %08x acs %08x\n"
+		"%d checks, %d mismatches, hashing %.3f ms",
+		entry.Tic, entry.Hash[SYNC_Actors], entry.Hash[SYNC_RNG], entry.Hash[SYNC_Sectors], entry.Hash[SYNC_ACS],
+		Checks, Mismatches, HashCycles.TimeMS());
+	return out;
+}
@@ -0,0 +1,9 @@
+#ifndef __G_SYNCHASH_H
+#define __G_SYNCHASH_H
+
+#include "doomtype.h"
+
+void G_SyncHashTicker ();
+void G_ReadSyncHash (int player, BYTE **stream);
+
+#endif
@@ -473,6 +473,7 @@ void gl_RecalcVertexHeights(vertex_t * v)
 	}
 	if (v->numheights<=2) v->numheights=0;	// is not in need of any special attention
 	v->dirty = false;
+	v->heightstamp++;
 }
 
 
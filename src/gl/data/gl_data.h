@@ -62,5 +62,6 @@ void gl_BuildPortalCoverage(FPortalCoverage *coverage, subsector_t *subsector, F
 void gl_InitData();
 
 extern long gl_frameMS;
+extern long gl_frameCount;
 
 #endif
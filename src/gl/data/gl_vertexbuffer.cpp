@@ -107,6 +107,9 @@ FFlatVertexBuffer::FFlatVertexBuffer()
 		map = &vbo_shadowdata[0];
 	}
 	mNumReserved = mIndex = mCurIndex = 0;
+	mWallCacheNext = mWallCacheEnd = 0;
+	mBatching = false;
+	mBatchType = 0;
 }
 
 FFlatVertexBuffer::~FFlatVertexBuffer()
@@ -142,6 +145,39 @@ void FFlatVertexBuffer::ImmRenderBuffer(unsigned int primtype, unsigned int offs
 #endif
 }
 
+//==========================================================================
+//
+// Submits all draws collected since the last flush
+//
+//==========================================================================
+
+void FFlatVertexBuffer::FlushBatch()
+{
+	unsigned int count = mBatchFirst.Size();
+
+	if (count == 0) return;
+	drawcalls.Clock();
+	if (gl.flags & RFL_BUFFER_STORAGE)
+	{
+		if (count == 1) glDrawArrays(mBatchType, mBatchFirst[0], mBatchCount[0]);
+		else glMultiDrawArrays(mBatchType, &mBatchFirst[0], &mBatchCount[0], count);
+		render_drawcalls++;
+		render_batcheddraws += count - 1;
+	}
+	else
+	{
+		// immediate mode has no way to combine these but still benefits from the skipped state changes.
+		for (unsigned int i = 0; i < count; i++)
+		{
+			ImmRenderBuffer(mBatchType, mBatchFirst[i], mBatchCount[i]);
+		}
+		render_drawcalls += count;
+	}
+	drawcalls.Unclock();
+	mBatchFirst.Clear();
+	mBatchCount.Clear();
+}
+
 //==========================================================================
 //
 // Initialize a single vertex
@@ -323,8 +359,24 @@ void FFlatVertexBuffer::CreateVBO()
 	{
 		vbo_shadowdata.Resize(mNumReserved);
 		CreateFlatVBO();
-		mCurIndex = mIndex = vbo_shadowdata.Size();
 		memcpy(map, &vbo_shadowdata[0], vbo_shadowdata.Size() * sizeof(FFlatVertex));
+
+		// Reserve room for the wall cache behind the flat data.
+		// Never give it more than a quarter of what's left so that the streaming part keeps enough space.
+		unsigned int cachesize = 0;
+		if (vbo_shadowdata.Size() < BUFFER_SIZE_TO_USE)
+		{
+			cachesize = MIN<unsigned int>(WALLCACHE_SIZE, (BUFFER_SIZE_TO_USE - vbo_shadowdata.Size()) / 4);
+		}
+		mWallCacheNext = vbo_shadowdata.Size();
+		mWallCacheEnd = mWallCacheNext + cachesize;
+		mCurIndex = mIndex = mWallCacheEnd;
+
+		FWallCacheEntry empty;
+		memset(&empty, 0, sizeof(empty));
+		empty.frame = -1;
+		mWallCache.Clear();
+		for (int i = 0; i < numsegs * 4; i++) mWallCache.Push(empty);
 	}
 	else if (sectors)
 	{
@@ -339,6 +391,26 @@ void FFlatVertexBuffer::CreateVBO()
 
 }
 
+//==========================================================================
+//
+// Gets static buffer space for a cached wall. The space is kept by the
+// entry until the next level is loaded. Returns NULL if the cache is full
+// in which case the wall needs to use the streaming part of the buffer.
+//
+//==========================================================================
+
+FFlatVertex *FFlatVertexBuffer::AllocWallCache(FWallCacheEntry *entry, unsigned int capacity)
+{
+	if (entry->capacity < capacity)
+	{
+		if (mWallCacheNext + capacity > mWallCacheEnd) return NULL;
+		entry->offset = mWallCacheNext;
+		entry->capacity = capacity;
+		mWallCacheNext += capacity;
+	}
+	return &map[entry->offset];
+}
+
 //==========================================================================
 //
 //
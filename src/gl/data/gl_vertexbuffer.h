@@ -41,6 +41,27 @@ struct FFlatVertex
 
 #define VTO ((FFlatVertex*)NULL)
 
+// Everything a wall's vertices are generated from. If this is unchanged
+// the vertices from the last time the wall was drawn can be used again.
+struct FWallCacheKey
+{
+	float x1, y1, x2, y2;
+	float fracleft, fracright;
+	float ztop[2], zbottom[2];
+	float u[4], v[4];
+	int flags;
+	int heightstamp[2];
+};
+
+struct FWallCacheEntry
+{
+	FWallCacheKey key;
+	unsigned int offset;
+	unsigned int capacity;
+	unsigned int count;
+	long frame;
+};
+
 
 class FFlatVertexBuffer : public FVertexBuffer
 {
@@ -49,10 +70,22 @@ class FFlatVertexBuffer : public FVertexBuffer
 	unsigned int mCurIndex;
 	unsigned int mNumReserved;
 
+	// draws that are collected and submitted together while batching is on.
+	bool mBatching;
+	unsigned int mBatchType;
+	TArray<int> mBatchFirst;
+	TArray<int> mBatchCount;
+
+	// static storage for wall vertices, between the flat data and the streaming area.
+	TArray<FWallCacheEntry> mWallCache;
+	unsigned int mWallCacheNext;
+	unsigned int mWallCacheEnd;
+
 	void CheckPlanes(sector_t *sector);
 
 	static const unsigned int BUFFER_SIZE = 2000000;
 	static const unsigned int BUFFER_SIZE_TO_USE = 1999500;
+	static const unsigned int WALLCACHE_SIZE = 500000;
 
 	void ImmRenderBuffer(unsigned int primtype, unsigned int offset, unsigned int count);
 
@@ -76,12 +109,26 @@ public:
 		unsigned int diff = newofs - mCurIndex;
 		*poffset = mCurIndex;
 		mCurIndex = newofs;
-		if (mCurIndex >= BUFFER_SIZE_TO_USE) mCurIndex = mIndex;
+		if (mCurIndex >= BUFFER_SIZE_TO_USE)
+		{
+			// The batched draws must be done before their vertices get overwritten.
+			if (mBatching) FlushBatch();
+			mCurIndex = mIndex;
+		}
 		return diff;
 	}
 #ifdef __GL_PCH_H	// we need the system includes for this but we cannot include them ourselves without creating #define clashes. The affected files wouldn't try to draw anyway.
 	void RenderArray(unsigned int primtype, unsigned int offset, unsigned int count)
 	{
+		if (mBatching)
+		{
+			if (mBatchFirst.Size() > 0 && primtype != mBatchType) FlushBatch();
+			mBatchType = primtype;
+			mBatchFirst.Push(offset);
+			mBatchCount.Push(count);
+			return;
+		}
+		render_drawcalls++;
 		drawcalls.Clock();
 		if (gl.flags & RFL_BUFFER_STORAGE)
 		{
@@ -109,6 +156,26 @@ public:
 		mCurIndex = mIndex;
 	}
 
+	// While batching is on RenderArray only records the draw. Anything that
+	// changes GL state must call FlushBatch before doing so.
+	void BeginBatch()
+	{
+		mBatching = true;
+	}
+	void EndBatch()
+	{
+		FlushBatch();
+		mBatching = false;
+	}
+	void FlushBatch();
+
+	FWallCacheEntry *GetWallCacheEntry(unsigned int segnum, int part)
+	{
+		unsigned int index = segnum * 4 + part;
+		return index < mWallCache.Size() ? &mWallCache[index] : NULL;
+	}
+	FFlatVertex *AllocWallCache(FWallCacheEntry *entry, unsigned int capacity);
+
 private:
 	int CreateSubsectorVertices(subsector_t *sub, const secplane_t &plane, int floor);
 	int CreateSectorVertices(sector_t *sec, const secplane_t &plane, int floor);
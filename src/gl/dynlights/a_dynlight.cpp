@@ -37,6 +37,7 @@
 #include "g_level.h"
 #include "thingdef/thingdef.h"
 #include "i_system.h"
+#include "doomstat.h"
 
 
 #include "gl/renderer/gl_renderer.h"
@@ -113,6 +114,43 @@ void AVavoomLightColor::BeginPlay ()
 
 static FRandom randLight;
 
+//=============================================================================
+//
+// Relink statistics for the lightstats display. Linking is done by the
+// playsim so these are collected per tic, not per frame.
+//
+//=============================================================================
+
+struct FLightLinkStats
+{
+	int relinked;
+	int skipped;
+	int nodesadded;
+	int nodesdeleted;
+};
+
+static FLightLinkStats linkstats[2];	// current and last complete tic
+static int linkstattic = -1;
+static int lightnodesallocated, lightnodesfree;
+
+static FLightLinkStats &GetLinkStats()
+{
+	if (gametic != linkstattic)
+	{
+		linkstats[1] = linkstats[0];
+		memset(&linkstats[0], 0, sizeof(linkstats[0]));
+		linkstattic = gametic;
+	}
+	return linkstats[0];
+}
+
+void gl_AppendLightLinkStats(FString &out)
+{
+	FLightLinkStats &last = linkstats[1];
+	out.AppendFormat("DLight links - %d relinked, %d unchanged, %d nodes added, %d nodes deleted - Nodes: %d allocated, %d free\n",
+		last.relinked, last.skipped, last.nodesadded, last.nodesdeleted, lightnodesallocated, lightnodesfree);
+}
+
 //==========================================================================
 //
 // Base class
@@ -352,12 +390,16 @@ void ADynamicLight::UpdateLocation()
 
 
 		// The radius being used here is always the maximum possible with the
-		// current settings. This avoids constant relinking of flickering lights
+		// current settings. This avoids constant relinking of flickering and pulsing lights
 
 		if (lighttype == FlickerLight || lighttype == RandomFlickerLight) 
 		{
 			intensity = float(m_intensity[1]);
 		}
+		else if (lighttype == PulseLight)
+		{
+			intensity = float(MAX(m_intensity[0], m_intensity[1]));
+		}
 		else
 		{
 			intensity = m_currentIntensity;
@@ -369,6 +411,10 @@ void ADynamicLight::UpdateLocation()
 			//Update the light lists
 			LinkLight();
 		}
+		else
+		{
+			GetLinkStats().skipped++;
+		}
 	}
 }
 
@@ -401,6 +447,40 @@ size_t ADynamicLight::PointerSubstitution (DObject *old, DObject *notOld)
 	return ret;
 }
 
+//=============================================================================
+//
+// Maintain a freelist of FLightNodes. Moving lights relink every tic
+// and would otherwise constantly allocate and free their nodes.
+//
+//=============================================================================
+
+static FLightNode *freelightnodes;
+
+static FLightNode *GetLightNode()
+{
+	FLightNode *node;
+
+	if (freelightnodes != NULL)
+	{
+		node = freelightnodes;
+		freelightnodes = node->nextTarget;
+		lightnodesfree--;
+	}
+	else
+	{
+		node = (FLightNode *)M_Malloc(sizeof(*node));
+		lightnodesallocated++;
+	}
+	return node;
+}
+
+static void PutLightNode(FLightNode *node)
+{
+	node->nextTarget = freelightnodes;
+	freelightnodes = node;
+	lightnodesfree++;
+}
+
 //=============================================================================
 //
 // These have been copied from the secnode code and modified for the light links
@@ -430,7 +510,8 @@ FLightNode * AddLightNode(FLightNode ** thread, void * linkto, ADynamicLight * l
 	// Couldn't find an existing node for this sector. Add one at the head
 	// of the list.
 	
-	node = new FLightNode;
+	node = GetLightNode();
+	GetLinkStats().nodesadded++;
 	
 	node->targ = linkto;
 	node->lightsource = light; 
@@ -473,7 +554,8 @@ static FLightNode * DeleteLightNode(FLightNode * node)
 		
 		// Return this node to the freelist
 		tn=node->nextTarget;
-		delete node;
+		PutLightNode(node);
+		GetLinkStats().nodesdeleted++;
 		return(tn);
     }
 	return(NULL);
@@ -570,6 +652,7 @@ void ADynamicLight::LinkLight()
 	// mark the old light nodes
 	FLightNode * node;
 	
+	GetLinkStats().relinked++;
 	node = touching_sides;
 	while (node)
     {
@@ -147,12 +147,6 @@ public:
 	void BeginPlay();
 };
 
-
-enum
-{
-	STAT_DLIGHT=64
-};
-
 struct FDynLightData
 {
 	TArray<float> arrays[3];
@@ -183,6 +177,7 @@ struct FDynLightData
 
 
 
+int gl_SetupLightData(ADynamicLight * light, float radius, bool forceadditive, float *data);
 bool gl_GetLight(Plane & p, ADynamicLight * light, bool checkside, bool forceadditive, FDynLightData &data);
 void gl_UploadLights(FDynLightData &data);
 
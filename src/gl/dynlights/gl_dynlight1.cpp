@@ -78,29 +78,13 @@ CUSTOM_CVAR (Bool, gl_lights_additive, false,  CVAR_ARCHIVE | CVAR_GLOBALCONFIG
 
 //==========================================================================
 //
-// Sets up the parameters to render one dynamic light onto one plane
+// Fills in the light buffer data for one light and returns
+// which of the three light arrays it belongs to.
 //
 //==========================================================================
-bool gl_GetLight(Plane & p, ADynamicLight * light, bool checkside, bool forceadditive, FDynLightData &ldata)
+int gl_SetupLightData(ADynamicLight * light, float radius, bool forceadditive, float *data)
 {
-	Vector fn, pos;
 	int i = 0;
-
-    float x = FIXED2FLOAT(light->X());
-	float y = FIXED2FLOAT(light->Y());
-	float z = FIXED2FLOAT(light->Z());
-	
-	float dist = fabsf(p.DistToPoint(x, z, y));
-	float radius = (light->GetRadius() * gl_lights_size);
-	
-	if (radius <= 0.f) return false;
-	if (dist > radius) return false;
-	if (checkside && gl_lights_checkside && p.PointOnSide(x, z, y))
-	{
-		return false;
-	}
-
-
 	float cs;
 	if (gl_lights_additive || light->flags4&MF4_ADDITIVE || forceadditive) 
 	{
@@ -127,15 +111,41 @@ bool gl_GetLight(Plane & p, ADynamicLight * light, bool checkside, bool forceadd
 		i = 1;
 	}
 
-	float *data = &ldata.arrays[i][ldata.arrays[i].Reserve(8)];
-	data[0] = x;
-	data[1] = z;
-	data[2] = y;
+	data[0] = FIXED2FLOAT(light->X());
+	data[1] = FIXED2FLOAT(light->Z());
+	data[2] = FIXED2FLOAT(light->Y());
 	data[3] = radius;
 	data[4] = r;
 	data[5] = g;
 	data[6] = b;
 	data[7] = 0;
+	return i;
+}
+
+//==========================================================================
+//
+// Sets up the parameters to render one dynamic light onto one plane
+//
+//==========================================================================
+bool gl_GetLight(Plane & p, ADynamicLight * light, bool checkside, bool forceadditive, FDynLightData &ldata)
+{
+    float x = FIXED2FLOAT(light->X());
+	float y = FIXED2FLOAT(light->Y());
+	float z = FIXED2FLOAT(light->Z());
+	
+	float dist = fabsf(p.DistToPoint(x, z, y));
+	float radius = (light->GetRadius() * gl_lights_size);
+	
+	if (radius <= 0.f) return false;
+	if (dist > radius) return false;
+	if (checkside && gl_lights_checkside && p.PointOnSide(x, z, y))
+	{
+		return false;
+	}
+
+	float data[8];
+	int i = gl_SetupLightData(light, radius, forceadditive, data);
+	memcpy(&ldata.arrays[i][ldata.arrays[i].Reserve(8)], data, sizeof(data));
 	return true;
 }
 
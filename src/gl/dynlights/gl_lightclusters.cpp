@@ -0,0 +1,435 @@
+//
+// DESCRIPTION:
+//      Per frame light table with flattened light lists.
+//
+
+#include "gl/system/gl_system.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "doomstat.h"
+#include "templates.h"
+#include "p_local.h"
+#include "r_state.h"
+#include "gl/dynlights/gl_dynlight.h"
+#include "gl/dynlights/gl_lightclusters.h"
+#include "gl/utility/gl_clock.h"
+#include "gl/utility/gl_geometric.h"
+
+CVAR(Bool, gl_lightclusters, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Float, gl_lights_size)
+EXTERN_CVAR(Bool, gl_lights_checkside)
+
+FLightClusters gl_LightClusters;
+
+//==========================================================================
+//
+// Collects all active lights. The light lists of the subsectors and
+// sidedefs are flattened later, when they are needed.
+//
+//==========================================================================
+
+void FLightClusters::Build()
+{
+	TThinkerIterator<ADynamicLight> it(STAT_DLIGHT);
+	ADynamicLight *light;
+
+	mValid = false;
+	if (!gl_lightclusters) return;
+
+	LightSetup.Clock();
+	mLights.Clear();
+	mX.Clear();
+	mY.Clear();
+	mZ.Clear();
+	mRadius.Clear();
+	mData.Clear();
+	mType.Clear();
+
+	while ((light = it.Next()) != NULL)
+	{
+		light->bufferindex = -1;
+		if (!light->IsActive()) continue;
+
+		float radius = light->GetRadius() * gl_lights_size;
+		if (radius <= 0.f) continue;
+
+		light->bufferindex = mLights.Push(light);
+		mX.Push(FIXED2FLOAT(light->X()));
+		mY.Push(FIXED2FLOAT(light->Y()));
+		mZ.Push(FIXED2FLOAT(light->Z()));
+		mRadius.Push(radius);
+		mType.Push(gl_SetupLightData(light, radius, false, &mData[mData.Reserve(8)]));
+	}
+
+	// This invalidates all ranges of the previous frame.
+	mFrame++;
+	mIndices.Clear();
+	ResetRanges(mSubsectorRanges, numsubsectors);
+	ResetRanges(mSideRanges, numsides);
+
+	mValid = true;
+	LightSetup.Unclock();
+}
+
+//==========================================================================
+//
+// The frame numbers only need to be cleared when the map's size changes.
+// Otherwise the old ones are all below the current one.
+//
+//==========================================================================
+
+void FLightClusters::ResetRanges(TArray<FRange> &ranges, int count)
+{
+	if (ranges.Size() != (unsigned)count)
+	{
+		ranges.Resize(count);
+		if (count > 0) memset(&ranges[0], 0, count * sizeof(FRange));
+	}
+}
+
+//==========================================================================
+//
+// Returns the table indices of a node list's active lights, flattening
+// the list first if that hasn't been done in this frame.
+//
+//==========================================================================
+
+const int *FLightClusters::GetRange(FRange &range, FLightNode *node, int &count)
+{
+	if (range.Frame != mFrame)
+	{
+		range.Frame = mFrame;
+		range.Start = mIndices.Size();
+		for (; node != NULL; node = node->nextLight)
+		{
+			ADynamicLight *light = node->lightsource;
+
+			// A light that is not in STAT_DLIGHT still has the index from an older frame.
+			if (light->bufferindex >= 0 && (unsigned)light->bufferindex < mLights.Size() && mLights[light->bufferindex] == light)
+			{
+				mIndices.Push(light->bufferindex);
+			}
+		}
+		range.Count = mIndices.Size() - range.Start;
+	}
+	count = range.Count;
+	return count > 0 ? &mIndices[range.Start] : NULL;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FLightClusters::AddLight(int index, FDynLightData &data)
+{
+	TArray<float> &arr = data.arrays[mType[index]];
+	memcpy(&arr[arr.Reserve(8)], &mData[index * 8], 8 * sizeof(float));
+}
+
+//==========================================================================
+//
+// Same checks as GLWall::SetupLights and gl_GetLight, on the precalculated data.
+//
+//==========================================================================
+
+void FLightClusters::GetWallLights(float *vtx, Plane &p, const side_t *side, const subsector_t *sub, FDynLightData &data)
+{
+	const int *list;
+	int count;
+
+	if (side != NULL)
+	{
+		list = GetRange(mSideRanges[int(side - sides)], side->lighthead, count);
+	}
+	else
+	{
+		list = GetRange(mSubsectorRanges[int(sub - subsectors)], sub->lighthead, count);
+	}
+	if (count == 0) return;
+
+	Vector fn = p.Normal();
+	Vector right, up;
+	fn.GetRightUp(right, up);
+
+	for (int i = 0; i < count; i++)
+	{
+		int l = list[i];
+		float x = mX[l], y = mY[l], z = mZ[l];
+		float radius = mRadius[l];
+		float dist = fabsf(p.DistToPoint(x, z, y));
+
+		iter_dlight++;
+		if (dist >= radius) continue;
+
+		float scale = 1.0f / ((2.f * radius) - dist);
+		Vector nearPt(x + fn.X() * dist, z + fn.Y() * dist, y + fn.Z() * dist);
+		int outcnt[4] = { 0,0,0,0 };
+
+		// do a quick check whether the light touches this polygon
+		for (int j = 0; j < 4; j++)
+		{
+			Vector nearToVert(vtx[j * 3] - nearPt.X(), vtx[j * 3 + 1] - nearPt.Y(), vtx[j * 3 + 2] - nearPt.Z());
+			float u = (nearToVert.Dot(right) * scale) + 0.5f;
+			float v = (nearToVert.Dot(up) * scale) + 0.5f;
+
+			if (u < 0) outcnt[0]++;
+			if (u > 1) outcnt[1]++;
+			if (v < 0) outcnt[2]++;
+			if (v > 1) outcnt[3]++;
+		}
+		if (outcnt[0] == 4 || outcnt[1] == 4 || outcnt[2] == 4 || outcnt[3] == 4) continue;
+		if (gl_lights_checkside && p.PointOnSide(x, z, y)) continue;
+
+		AddLight(l, data);
+	}
+}
+
+//==========================================================================
+//
+// Same checks as GLFlat::SetupSubsectorLights and gl_GetLight, on the precalculated data.
+//
+//==========================================================================
+
+void FLightClusters::GetFlatLights(secplane_t &plane, bool ceiling, const subsector_t *sub, FDynLightData &data)
+{
+	int count;
+	const int *list = GetRange(mSubsectorRanges[int(sub - subsectors)], sub->lighthead, count);
+	if (count == 0) return;
+
+	Plane p;
+	p.Set(plane);
+
+	for (int i = 0; i < count; i++)
+	{
+		int l = list[i];
+		float x = mX[l], y = mY[l], z = mZ[l];
+
+		iter_dlightf++;
+
+		// we must do the side check here because gl_SetupLight needs the correct plane orientation
+		// which we don't have for Legacy-style 3D-floors
+		float planeh = (float)plane.ZatPoint(double(x), double(y));
+		if (gl_lights_checkside && ((planeh < z && ceiling) || (planeh > z && !ceiling))) continue;
+		if (fabsf(p.DistToPoint(x, z, y)) > mRadius[l]) continue;
+
+		AddLight(l, data);
+	}
+}
+
+//==========================================================================
+//
+// The node list walks of GLWall::SetupLights and GLFlat::SetupSubsectorLights
+//
+//==========================================================================
+
+void gl_GetWallLightsFromNodes(float *vtx, Plane &p, FLightNode *node, FDynLightData &data)
+{
+	// Iterate through all dynamic lights which touch this wall and render them
+	while (node)
+	{
+		if (!(node->lightsource->flags2&MF2_DORMANT))
+		{
+			iter_dlight++;
+
+			Vector fn, pos;
+
+			float x = FIXED2FLOAT(node->lightsource->X());
+			float y = FIXED2FLOAT(node->lightsource->Y());
+			float z = FIXED2FLOAT(node->lightsource->Z());
+			float dist = fabsf(p.DistToPoint(x, z, y));
+			float radius = (node->lightsource->GetRadius() * gl_lights_size);
+			float scale = 1.0f / ((2.f * radius) - dist);
+
+			if (radius > 0.f && dist < radius)
+			{
+				Vector nearPt, up, right;
+
+				pos.Set(x,z,y);
+				fn=p.Normal();
+				fn.GetRightUp(right, up);
+
+				Vector tmpVec = fn * dist;
+				nearPt = pos + tmpVec;
+
+				Vector t1;
+				int outcnt[4]={0,0,0,0};
+
+				// do a quick check whether the light touches this polygon
+				for(int i=0;i<4;i++)
+				{
+					t1.Set(&vtx[i*3]);
+					Vector nearToVert = t1 - nearPt;
+					float u = (nearToVert.Dot(right) * scale) + 0.5f;
+					float v = (nearToVert.Dot(up) * scale) + 0.5f;
+
+					if (u<0) outcnt[0]++;
+					if (u>1) outcnt[1]++;
+					if (v<0) outcnt[2]++;
+					if (v>1) outcnt[3]++;
+
+				}
+				if (outcnt[0]!=4 && outcnt[1]!=4 && outcnt[2]!=4 && outcnt[3]!=4) 
+				{
+					gl_GetLight(p, node->lightsource, true, false, data);
+				}
+			}
+		}
+		node = node->nextLight;
+	}
+}
+
+void gl_GetFlatLightsFromNodes(secplane_t &plane, bool ceiling, FLightNode *node, FDynLightData &data)
+{
+	Plane p;
+
+	while (node)
+	{
+		ADynamicLight * light = node->lightsource;
+			
+		if (light->flags2&MF2_DORMANT)
+		{
+			node=node->nextLight;
+			continue;
+		}
+		iter_dlightf++;
+
+		// we must do the side check here because gl_SetupLight needs the correct plane orientation
+		// which we don't have for Legacy-style 3D-floors
+		fixed_t planeh = plane.ZatPoint(light);
+		if (gl_lights_checkside && ((planeh<light->Z() && ceiling) || (planeh>light->Z() && !ceiling)))
+		{
+			node=node->nextLight;
+			continue;
+		}
+
+		p.Set(plane);
+		gl_GetLight(p, light, false, false, data);
+		node = node->nextLight;
+	}
+}
+
+//==========================================================================
+//
+// Gathers the lights of every sidedef and subsector of the current level,
+// once by walking the node lists and once with the light table, and checks
+// that both give the same lights. The light table's time includes
+// flattening the ranges, which a frame only does for what it draws.
+//
+//==========================================================================
+
+static bool SameLights(const FDynLightData &a, const FDynLightData &b)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if (a.arrays[i].Size() != b.arrays[i].Size()) return false;
+		if (a.arrays[i].Size() > 0 && memcmp(&a.arrays[i][0], &b.arrays[i][0], a.arrays[i].Size() * sizeof(float))) return false;
+	}
+	return true;
+}
+
+static int CountLights(const FDynLightData &data)
+{
+	return (data.arrays[0].Size() + data.arrays[1].Size() + data.arrays[2].Size()) / 8;
+}
+
+CCMD(lightbench)
+{
+	const int passes = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 1000) : 10;
+	bool enabled = gl_lightclusters;
+	FDynLightData ref, opt;
+	cycle_t reftime, opttime, buildtime;
+	int surfaces = 0, lights = 0, mismatches = 0;
+
+	if (gamestate != GS_LEVEL)
+	{
+		Printf("lightbench needs a level\n");
+		return;
+	}
+
+	gl_lightclusters = true;
+	reftime.Reset();
+	opttime.Reset();
+	buildtime.Reset();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		bool count = pass == 0;
+
+		buildtime.Clock();
+		gl_LightClusters.Build();
+		buildtime.Unclock();
+
+		for (int i = 0; i < numsides; i++)
+		{
+			side_t *side = &sides[i];
+			line_t *line = side->linedef;
+			if (line == NULL || (side->Flags & WALLF_POLYOBJ)) continue;
+
+			vertex_t *v1 = side == line->sidedef[0] ? line->v1 : line->v2;
+			vertex_t *v2 = side == line->sidedef[0] ? line->v2 : line->v1;
+			sector_t *sec = side->sector;
+			float x1 = FIXED2FLOAT(v1->x), y1 = FIXED2FLOAT(v1->y);
+			float x2 = FIXED2FLOAT(v2->x), y2 = FIXED2FLOAT(v2->y);
+			float vtx[] = {
+				x1, FIXED2FLOAT(sec->floorplane.ZatPoint(v1)), y1,
+				x1, FIXED2FLOAT(sec->ceilingplane.ZatPoint(v1)), y1,
+				x2, FIXED2FLOAT(sec->ceilingplane.ZatPoint(v2)), y2,
+				x2, FIXED2FLOAT(sec->floorplane.ZatPoint(v2)), y2 };
+			Plane p;
+
+			p.Init(vtx, 4);
+			if (!p.ValidNormal()) continue;
+
+			ref.Clear();
+			reftime.Clock();
+			gl_GetWallLightsFromNodes(vtx, p, side->lighthead, ref);
+			reftime.Unclock();
+
+			opt.Clear();
+			opttime.Clock();
+			gl_LightClusters.GetWallLights(vtx, p, side, NULL, opt);
+			opttime.Unclock();
+
+			if (count)
+			{
+				surfaces++;
+				lights += CountLights(ref);
+				if (!SameLights(ref, opt)) mismatches++;
+			}
+		}
+
+		for (int i = 0; i < numsubsectors; i++)
+		{
+			subsector_t *sub = &subsectors[i];
+
+			for (int ceiling = 0; ceiling < 2; ceiling++)
+			{
+				secplane_t &plane = ceiling ? sub->sector->ceilingplane : sub->sector->floorplane;
+
+				ref.Clear();
+				reftime.Clock();
+				gl_GetFlatLightsFromNodes(plane, !!ceiling, sub->lighthead, ref);
+				reftime.Unclock();
+
+				opt.Clear();
+				opttime.Clock();
+				gl_LightClusters.GetFlatLights(plane, !!ceiling, sub, opt);
+				opttime.Unclock();
+
+				if (count)
+				{
+					surfaces++;
+					lights += CountLights(ref);
+					if (!SameLights(ref, opt)) mismatches++;
+				}
+			}
+		}
+	}
+	gl_lightclusters = enabled;
+	if (!enabled) gl_LightClusters.Clear();
+
+	Printf("%d surfaces, %d lights applied to them\n", surfaces, lights);
+	Printf("node lists: %2.3f ms, light table: %2.3f ms + %2.3f ms to collect the lights per pass, %d surfaces with different lights\n",
+		reftime.TimeMS() / passes, opttime.TimeMS() / passes, buildtime.TimeMS() / passes, mismatches);
+}
@@ -0,0 +1,76 @@
+#ifndef __GL_LIGHTCLUSTERS_H
+#define __GL_LIGHTCLUSTERS_H
+
+#include "tarray.h"
+
+struct subsector_t;
+struct side_t;
+struct secplane_t;
+struct FDynLightData;
+struct FLightNode;
+class ADynamicLight;
+class Plane;
+
+//==========================================================================
+//
+// All active dynamic lights of a frame, set up once before rendering.
+//
+// The subsectors and sidedefs are the clusters: their light lists get
+// flattened into index ranges so that the surfaces only need to loop
+// over a piece of an int array instead of walking the FLightNode lists
+// and recalculating each light's parameters for every surface they touch.
+// A range is collected when the first surface of its subsector or sidedef
+// asks for it in a frame, so the parts of the map that don't get drawn
+// cost nothing. This happens while drawing, on the main thread.
+// Using the BSP for clustering instead of a regular grid keeps lights
+// from shining through solid walls, just like the node lists do. Each
+// range lists the lights in node list order, so a surface with more
+// lights than the shader can take drops the same ones as before.
+//
+// This only replaces the per-surface light search. Every surface still
+// uploads its own light list through FLightBuffer. The lightbench
+// command compares the CPU time with the node list walks.
+//
+//==========================================================================
+
+class FLightClusters
+{
+	TArray<ADynamicLight *> mLights;
+	// light positions and radii as separate arrays for the range checks
+	TArray<float> mX, mY, mZ, mRadius;
+	TArray<float> mData;		// 8 floats per light in the light buffer's format
+	TArray<BYTE> mType;			// light array (normal, subtractive, additive) the light belongs to
+
+	struct FRange
+	{
+		unsigned Frame;		// mFrame when the range was collected
+		int Start, Count;	// piece of mIndices
+	};
+
+	TArray<FRange> mSubsectorRanges;
+	TArray<FRange> mSideRanges;
+	TArray<int> mIndices;
+	unsigned mFrame;
+	bool mValid;
+
+	static void ResetRanges(TArray<FRange> &ranges, int count);
+	const int *GetRange(FRange &range, FLightNode *node, int &count);
+	void AddLight(int index, FDynLightData &data);
+
+public:
+	FLightClusters() { mFrame = 0; mValid = false; }
+	void Build();
+	void Clear() { mValid = false; }
+	bool IsValid() const { return mValid; }
+
+	void GetWallLights(float *vtx, Plane &p, const side_t *side, const subsector_t *sub, FDynLightData &data);
+	void GetFlatLights(secplane_t &plane, bool ceiling, const subsector_t *sub, FDynLightData &data);
+};
+
+extern FLightClusters gl_LightClusters;
+
+// The node list walks the table replaces, for when gl_lightclusters is off.
+void gl_GetWallLightsFromNodes(float *vtx, Plane &p, FLightNode *node, FDynLightData &data);
+void gl_GetFlatLightsFromNodes(secplane_t &plane, bool ceiling, FLightNode *node, FDynLightData &data);
+
+#endif
@@ -46,6 +46,9 @@ static inline uint32_t rgb_to_yuv(uint32_t c)
     return RGBtoYUV[MASK_RGB & c];
 }
 
+/* Calculates the neighbour patterns of one row */
+void hqxPatterns(const uint32_t *sp, int prevline, int nextline, int Xres, uint8_t *patterns, uint32_t *yuvbuffer);
+
 /* Test if there is difference in color */
 static inline int yuv_diff(uint32_t yuv1, uint32_t yuv2) {
     return (( abs((int64_t)(yuv1 & Ymask) - (int64_t)(yuv2 & Ymask)) > trY ) ||
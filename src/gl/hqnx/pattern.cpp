@@ -0,0 +1,106 @@
+//
+// DESCRIPTION:
+//      Pixel pattern classification for the hqNx scalers.
+//
+
+#include "mystdint.h"
+#include "common.h"
+#include "hqx.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HQX_SSE2
+#endif
+
+int hqxUseSIMD = 1;
+
+//
+// Converts a source row to YUV, with one extra pixel on each side that
+// repeats the edge pixel, the same way the scalers treat the image border.
+//
+static void RowToYUV(const uint32_t *sp, int Xres, uint32_t *yuv)
+{
+    yuv[0] = rgb_to_yuv(sp[0]);
+    for (int i = 0; i < Xres; i++)
+    {
+        yuv[i + 1] = rgb_to_yuv(sp[i]);
+    }
+    yuv[Xres + 1] = yuv[Xres];
+}
+
+#ifdef HQX_SSE2
+//
+// Returns the pattern flag in each lane where the neighbour's YUV differs
+// from the center pixel by more than the thresholds used by yuv_diff.
+//
+static inline __m128i DiffFlags(__m128i center, const uint32_t *neighbour, __m128i thresh, int flag)
+{
+    __m128i n = _mm_loadu_si128((const __m128i *)neighbour);
+    __m128i d = _mm_or_si128(_mm_subs_epu8(center, n), _mm_subs_epu8(n, center));
+    __m128i same = _mm_cmpeq_epi32(_mm_subs_epu8(d, thresh), _mm_setzero_si128());
+    return _mm_andnot_si128(same, _mm_set1_epi32(flag));
+}
+#endif
+
+//
+// Calculates the patterns of one row for the switch in the hqNx scalers.
+// Bit n is set if the nth neighbour (w1-w9 without w5) is different from
+// the center pixel. yuvbuffer must have room for 3 * (Xres + 2) entries.
+//
+void hqxPatterns(const uint32_t *sp, int prevline, int nextline, int Xres, uint8_t *patterns, uint32_t *yuvbuffer)
+{
+    uint32_t *prev = yuvbuffer;
+    uint32_t *cur = yuvbuffer + Xres + 2;
+    uint32_t *next = yuvbuffer + 2 * (Xres + 2);
+    int i = 0;
+
+    RowToYUV(sp + prevline, Xres, prev);
+    RowToYUV(sp, Xres, cur);
+    RowToYUV(sp + nextline, Xres, next);
+
+#ifdef HQX_SSE2
+    if (hqxUseSIMD)
+    {
+        // The YUV components are one byte each so the threshold for each of them can be checked
+        // with saturated byte arithmetics. The top byte is always 0 and gets a threshold of 255.
+        const __m128i thresh = _mm_set1_epi32(0xff000000 | (trY & Ymask) | (trU & Umask) | (trV & Vmask));
+
+        for (; i + 4 <= Xres; i += 4)
+        {
+            __m128i center = _mm_loadu_si128((const __m128i *)&cur[i + 1]);
+            __m128i pattern = DiffFlags(center, &prev[i], thresh, 1);
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &prev[i + 1], thresh, 2));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &prev[i + 2], thresh, 4));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &cur[i], thresh, 8));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &cur[i + 2], thresh, 16));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &next[i], thresh, 32));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &next[i + 1], thresh, 64));
+            pattern = _mm_or_si128(pattern, DiffFlags(center, &next[i + 2], thresh, 128));
+
+            pattern = _mm_packs_epi32(pattern, pattern);
+            pattern = _mm_packus_epi16(pattern, pattern);
+            uint32_t packed = (uint32_t)_mm_cvtsi128_si32(pattern);
+            patterns[i] = (uint8_t)packed;
+            patterns[i + 1] = (uint8_t)(packed >> 8);
+            patterns[i + 2] = (uint8_t)(packed >> 16);
+            patterns[i + 3] = (uint8_t)(packed >> 24);
+        }
+    }
+#endif
+
+    for (; i < Xres; i++)
+    {
+        uint32_t yuv1 = cur[i + 1];
+        int pattern = 0;
+
+        if (yuv_diff(yuv1, prev[i])) pattern |= 1;
+        if (yuv_diff(yuv1, prev[i + 1])) pattern |= 2;
+        if (yuv_diff(yuv1, prev[i + 2])) pattern |= 4;
+        if (yuv_diff(yuv1, cur[i])) pattern |= 8;
+        if (yuv_diff(yuv1, cur[i + 2])) pattern |= 16;
+        if (yuv_diff(yuv1, next[i])) pattern |= 32;
+        if (yuv_diff(yuv1, next[i + 1])) pattern |= 64;
+        if (yuv_diff(yuv1, next[i + 2])) pattern |= 128;
+        patterns[i] = (uint8_t)pattern;
+    }
+}
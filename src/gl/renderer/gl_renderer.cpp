@@ -305,6 +305,7 @@ void FGLRenderer::DrawTexture(FTexture *img, DCanvas::DrawParms &parms)
 	double h = parms.destheight;
 	float u1, v1, u2, v2;
 	int light = 255;
+	FAtlasEntry *atlas = NULL;
 
 	FMaterial * gltex = FMaterial::ValidateTexture(img, false);
 
@@ -327,7 +328,9 @@ void FGLRenderer::DrawTexture(FTexture *img, DCanvas::DrawParms &parms)
 				if (pal) translation = -pal->GetIndex();
 			}
 		}
-		gl_RenderState.SetMaterial(gltex, CLAMP_XY_NOMIP, translation, 0, !!(parms.style.Flags & STYLEF_RedIsAlpha));
+		bool alphatexture = !!(parms.style.Flags & STYLEF_RedIsAlpha);
+		if (!alphatexture) atlas = gltex->GetAtlasEntry(CLAMP_XY_NOMIP, translation);
+		gl_RenderState.SetMaterial(gltex, CLAMP_XY_NOMIP, translation, 0, alphatexture, atlas);
 
 		u1 = gltex->GetUL();
 		v1 = gltex->GetVT();
@@ -362,6 +365,14 @@ void FGLRenderer::DrawTexture(FTexture *img, DCanvas::DrawParms &parms)
 		u2 = float(u2 - (parms.texwidth - parms.windowright) / parms.texwidth);
 	}
 
+	if (atlas != NULL)
+	{
+		u1 = atlas->MapU(u1);
+		v1 = atlas->MapV(v1);
+		u2 = atlas->MapU(u2);
+		v2 = atlas->MapV(v2);
+	}
+
 	PalEntry color;
 	if (parms.style.Flags & STYLEF_ColorIsFixed)
 	{
@@ -135,6 +135,8 @@ public:
 
 // Global functions. Make them members of GLRenderer later?
 void gl_RenderBSPNode (void *node);
+void gl_StartSetupItems();
+void gl_ProcessSetupItems();
 bool gl_CheckClip(side_t * sidedef, sector_t * frontsector, sector_t * backsector);
 void gl_CheckViewArea(vertex_t *v1, vertex_t *v2, sector_t *frontsector, sector_t *backsector);
 
@@ -146,7 +148,7 @@ typedef enum
 		area_default
 } area_t;
 
-extern area_t			in_area;
+extern thread_local area_t in_area;
 
 
 sector_t * gl_FakeFlat(sector_t * sec, sector_t * dest, area_t in_area, bool back);
@@ -51,6 +51,7 @@ void gl_SetTextureMode(int type);
 FRenderState gl_RenderState;
 
 CVAR(Bool, gl_direct_state_change, true, 0)
+CVAR(Bool, gl_batchdraws, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 
 static VSMatrix identityMatrix(1);
@@ -90,6 +91,10 @@ void FRenderState::Reset()
 	stBlendEquation = -1;
 	stAlphaThreshold = -1.f;
 	mLastDepthClamp = true;
+
+	mBatching = false;
+	mBatchStateValid = false;
+	mBatchTexture = NULL;
 }
 
 //==========================================================================
@@ -240,6 +245,24 @@ bool FRenderState::ApplyShader()
 
 void FRenderState::Apply()
 {
+	if (mBatching)
+	{
+		FBatchState state;
+
+		// Matrices are not part of the batch state so anything using them cannot be batched.
+		// Whether they are enabled is, so that the next draw without them resets them.
+		GetBatchState(state);
+		if (mBatchStateValid && mBatchLightIndex == mLightIndex && !mTextureMatrixEnabled && !mModelMatrixEnabled &&
+			!memcmp(&state, &mBatchState, sizeof(state)))
+		{
+			return;
+		}
+		FlushBatch();
+		mBatchState = state;
+		mBatchStateValid = true;
+		mBatchLightIndex = mLightIndex;
+	}
+
 	if (!gl_direct_state_change)
 	{
 		if (mSrcBlend != stSrcBlend || mDstBlend != stDstBlend)
@@ -268,6 +291,81 @@ void FRenderState::Apply()
 
 
 
+//==========================================================================
+//
+// Batching
+//
+// Draws through the flat vertex buffer are collected as long as the render
+// state does not change and then submitted with a single call.
+// This may only be enabled around code that changes GL state exclusively
+// through this class.
+//
+//==========================================================================
+
+void FRenderState::EnableBatching(bool on)
+{
+	on = on && gl_batchdraws;
+	if (on == mBatching) return;
+
+	if (on) GLRenderer->mVBO->BeginBatch();
+	else GLRenderer->mVBO->EndBatch();
+	mBatching = on;
+	mBatchStateValid = false;
+	mBatchTexture = NULL;
+	// the blend state may have been changed directly since the last time these were set.
+	stSrcBlend = stDstBlend = -1;
+	stBlendEquation = -1;
+}
+
+void FRenderState::FlushBatch()
+{
+	GLRenderer->mVBO->FlushBatch();
+}
+
+void FRenderState::GetBatchState(FBatchState &state)
+{
+	memset(&state, 0, sizeof(state));	// the padding must be cleared for memcmp
+	state.VertexBuffer = mVertexBuffer;
+	state.EffectState = mEffectState;
+	state.SpecialEffect = mSpecialEffect;
+	state.TextureMode = mTextureMode;
+	state.Desaturation = mDesaturation;
+	state.ColormapState = mColormapState;
+	state.SrcBlend = mSrcBlend;
+	state.DstBlend = mDstBlend;
+	state.BlendEquation = mBlendEquation;
+	state.TextureEnabled = mTextureEnabled;
+	state.FogEnabled = mFogEnabled;
+	state.GlowEnabled = mGlowEnabled;
+	state.TextureMatrixEnabled = mTextureMatrixEnabled;
+	state.ModelMatrixEnabled = mModelMatrixEnabled;
+	state.AlphaThreshold = mAlphaThreshold;
+	state.InterpolationFactor = mInterpolationFactor;
+	state.ShaderTimer = mShaderTimer;
+	state.ClipHeightTop = mClipHeightTop;
+	state.ClipHeightBottom = mClipHeightBottom;
+	memcpy(state.ClipSplit, mClipSplit, sizeof(state.ClipSplit));
+	memcpy(state.LightParms, mLightParms, sizeof(state.LightParms));
+	memcpy(state.Color, mColor.vec, sizeof(state.Color));
+	memcpy(state.CameraPos, mCameraPos.vec, sizeof(state.CameraPos));
+	memcpy(state.DynColor, mDynColor.vec, sizeof(state.DynColor));
+	if (mGlowEnabled)
+	{
+		memcpy(state.Glow[0], mGlowTop.vec, sizeof(state.Glow[0]));
+		memcpy(state.Glow[1], mGlowBottom.vec, sizeof(state.Glow[1]));
+		memcpy(state.Glow[2], mGlowTopPlane.vec, sizeof(state.Glow[2]));
+		memcpy(state.Glow[3], mGlowBottomPlane.vec, sizeof(state.Glow[3]));
+	}
+	state.FogColor = mFogColor.d;
+	state.ObjectColor = mObjectColor.d;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 void FRenderState::ApplyColorMask()
 {
 	if ((mColorMask[0] != currentColorMask[0]) ||
@@ -293,6 +391,12 @@ void FRenderState::ApplyMatrices()
 
 void FRenderState::ApplyLightIndex(int index)
 {
+	if (mBatching)
+	{
+		if (index == mBatchLightIndex) return;
+		FlushBatch();
+		mBatchLightIndex = index;
+	}
 	if (GLRenderer->mLights->GetBufferType() == GL_UNIFORM_BUFFER && index > -1)
 	{
 		index = GLRenderer->mLights->BindUBO(index);
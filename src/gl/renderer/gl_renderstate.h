@@ -6,6 +6,7 @@
 #include "gl/data/gl_data.h"
 #include "gl/data/gl_matrix.h"
 #include "gl/textures/gl_material.h"
+#include "gl/textures/gl_atlas.h"
 #include "c_cvars.h"
 #include "r_defs.h"
 #include "r_data/r_translate.h"
@@ -87,7 +88,32 @@ class FRenderState
 
 	FShader *activeShader;
 
+	// Everything ApplyShader sends to the shader. While batching, Apply
+	// does nothing as long as this does not change.
+	struct FBatchState
+	{
+		FVertexBuffer *VertexBuffer;
+		int EffectState, SpecialEffect, TextureMode, Desaturation, ColormapState;
+		int SrcBlend, DstBlend, BlendEquation;
+		bool TextureEnabled, FogEnabled, GlowEnabled;
+		bool TextureMatrixEnabled, ModelMatrixEnabled;
+		float AlphaThreshold, InterpolationFactor, ShaderTimer;
+		float ClipHeightTop, ClipHeightBottom, ClipSplit[2];
+		float LightParms[4], Color[4], CameraPos[4], DynColor[4];
+		float Glow[4][4];
+		uint32 FogColor, ObjectColor;	// plain values so that the struct can be cleared with memset
+	};
+
+	bool mBatching;
+	bool mBatchStateValid;
+	FBatchState mBatchState;
+	int mBatchLightIndex;
+	const void *mBatchTexture;
+	int mBatchClamp, mBatchTranslation;
+
 	bool ApplyShader();
+	void GetBatchState(FBatchState &state);
+	void FlushBatch();
 
 public:
 
@@ -103,7 +129,9 @@ public:
 
 	void Reset();
 
-	void SetMaterial(FMaterial *mat, int clampmode, int translation, int overrideshader, bool alphatexture)
+	// If atlas is not NULL the material is drawn from its atlas page and the texture
+	// coordinates must have been mapped with it. It cannot be used for alpha textures.
+	void SetMaterial(FMaterial *mat, int clampmode, int translation, int overrideshader, bool alphatexture, FAtlasEntry *atlas = NULL)
 	{
 		// textures without their own palette are a special case for use as an alpha texture:
 		// They use the color index directly as an alpha value instead of using the palette's red.
@@ -112,12 +140,24 @@ public:
 		{
 			if (mat->tex->UseBasePalette()) translation = TRANSLATION(TRANSLATION_Standard, 8);
 		}
+		// different materials on the same atlas page can be batched.
+		const void *bindtex = atlas != NULL ? (const void *)atlas->mPage : (const void *)mat;
+		int bindtrans = atlas != NULL ? 0 : translation;
+		if (mBatching && (bindtex != mBatchTexture || clampmode != mBatchClamp || bindtrans != mBatchTranslation))
+		{
+			// the texture gets bound right away so everything queued for the old one must be drawn first.
+			FlushBatch();
+			mBatchTexture = bindtex;
+			mBatchClamp = clampmode;
+			mBatchTranslation = bindtrans;
+		}
 		mEffectState = overrideshader >= 0? overrideshader : mat->mShaderIndex;
 		mShaderTimer = mat->tex->gl_info.shaderspeed;
-		mat->Bind(clampmode, translation);
+		mat->Bind(clampmode, translation, atlas);
 	}
 
 	void Apply();
+	void EnableBatching(bool on);
 	void ApplyColorMask();
 	void ApplyMatrices();
 	void ApplyLightIndex(int index);
@@ -334,9 +374,12 @@ public:
 			mSrcBlend = src;
 			mDstBlend = dst;
 		}
-		else
+		else if (!mBatching || src != stSrcBlend || dst != stDstBlend)
 		{
+			if (mBatching) FlushBatch();
 			glBlendFunc(src, dst);
+			stSrcBlend = src;
+			stDstBlend = dst;
 		}
 	}
 
@@ -352,9 +395,11 @@ public:
 		{
 			mBlendEquation = eq;
 		}
-		else
+		else if (!mBatching || eq != stBlendEquation)
 		{
+			if (mBatching) FlushBatch();
 			glBlendEquation(eq);
+			stBlendEquation = eq;
 		}
 	}
 
@@ -362,6 +407,7 @@ public:
 	bool SetDepthClamp(bool on)
 	{
 		bool res = mLastDepthClamp;
+		if (mBatching) FlushBatch();
 		if (!on) glDisable(GL_DEPTH_CLAMP);
 		else glEnable(GL_DEPTH_CLAMP);
 		mLastDepthClamp = on;
@@ -40,14 +40,17 @@
 #include "r_sky.h"
 #include "p_effect.h"
 #include "po_man.h"
+#include "m_workerpool.h"
 
 #include "gl/renderer/gl_renderer.h"
 #include "gl/data/gl_data.h"
 #include "gl/data/gl_vertexbuffer.h"
 #include "gl/scene/gl_clipper.h"
+#include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_portal.h"
 #include "gl/scene/gl_wall.h"
 #include "gl/utility/gl_clock.h"
+#include "gl/utility/gl_threads.h"
 
 EXTERN_CVAR(Bool, gl_render_segs)
 
@@ -58,6 +61,152 @@ CVAR(Bool, gl_render_things, true, 0)
 CVAR(Bool, gl_render_walls, true, 0)
 CVAR(Bool, gl_render_flats, true, 0)
 
+// Number of threads (including the main thread) that process the walls, flats
+// and sprites found by the BSP traversal. 0 or 1 does it all during traversal.
+CUSTOM_CVAR(Int, gl_setupthreads, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 0) self = 0;
+	else if (self > 16) self = 16;
+}
+
+//==========================================================================
+//
+// Deferred scene setup
+//
+// With gl_setupthreads > 1 the BSP traversal only records what it finds.
+// The items are then processed on a pool of worker threads, each into its
+// own set of draw lists, and finally copied to gl_drawinfo in traversal
+// order so that the draw lists come out the same as in a serial setup.
+//
+//==========================================================================
+
+enum
+{
+	SI_Wall,
+	SI_Particle,
+	SI_Sprite,
+	SI_Sector,
+};
+
+struct FSetupItem
+{
+	BYTE Type;
+	BYTE Thread;		// the worker that processed it
+	bool Serial;		// must be processed on the main thread
+	area_t Area;
+	union
+	{
+		seg_t *Seg;
+		AActor *Thing;
+		particle_t *Particle;
+	};
+	subsector_t *Sub;
+	sector_t *Front;
+	sector_t *Back;
+	unsigned int Start[GLDL_TYPES];	// range of the worker's draw items this
+	unsigned int End[GLDL_TYPES];	// item produced
+};
+
+static bool ThreadedSetup;
+static TArray<FSetupItem> SetupItems;
+static FSetupSink *SetupSinks;
+static int NumSetupSinks;
+
+// Fake sectors created by gl_FakeFlat need to live until the items
+// referencing them are processed, so for a deferred setup gl_FakeFlat
+// writes them straight into FakeSectors instead of a local variable.
+static TDeletingArray<sector_t *> FakeSectors;
+static unsigned int NumFakeSectors;
+
+static sector_t *FakeSectorDest(sector_t *local)
+{
+	if (!ThreadedSetup) return local;
+
+	if (NumFakeSectors == FakeSectors.Size())
+	{
+		FakeSectors.Push(new sector_t);
+	}
+	return FakeSectors[NumFakeSectors];
+}
+
+// Called when a sector returned by gl_FakeFlat gets queued. If it is the
+// fake one, the next call to FakeSectorDest must not overwrite it.
+static sector_t *KeepSector(sector_t *sec)
+{
+	if (ThreadedSetup && NumFakeSectors < FakeSectors.Size() && sec == FakeSectors[NumFakeSectors])
+	{
+		NumFakeSectors++;
+	}
+	return sec;
+}
+
+//==========================================================================
+//
+// Sky and portal walls and sector stacks need the portal manager, which
+// may only be used on the main thread. Items that are going to create
+// them are marked before they are queued so that no worker starts them.
+//
+//==========================================================================
+
+static bool IsPortalPlane(sector_t *sec, int plane)
+{
+	if (sec->portals[plane] != NULL || sec->GetReflect(plane) > 0) return true;
+	ASkyViewpoint *skybox = sec->GetSkyBox(plane);
+	return sec->GetTexture(plane) == skyflatnum || (skybox != NULL && skybox->bAlways);
+}
+
+static bool IsPortalWall(seg_t *seg, sector_t *front, sector_t *back)
+{
+	line_t *line = seg->linedef;
+
+	if (line->skybox != NULL || line->special == Line_Horizon || line->special == Line_Mirror) return true;
+	for (int plane = sector_t::floor; plane <= sector_t::ceiling; plane++)
+	{
+		if (IsPortalPlane(front, plane)) return true;
+		if (back != NULL && IsPortalPlane(back, plane)) return true;
+	}
+	return false;
+}
+
+static FSetupItem *QueueSetupItem(int type, sector_t *front)
+{
+	FSetupItem *item = &SetupItems[SetupItems.Reserve(1)];
+	item->Type = type;
+	item->Thread = 0;
+	item->Serial = false;
+	item->Area = in_area;
+	item->Sub = NULL;
+	item->Front = front;
+	item->Back = NULL;
+	return item;
+}
+
+static void ProcessSetupItem(FSetupItem &item)
+{
+	switch (item.Type)
+	{
+	case SI_Wall:
+	{
+		GLWall wall;
+		wall.sub = item.Sub;
+		wall.Process(item.Seg, item.Front, item.Back);
+		break;
+	}
+
+	case SI_Particle:
+		GLRenderer->ProcessParticle(item.Particle, item.Front);
+		break;
+
+	case SI_Sprite:
+		GLRenderer->ProcessSprite(item.Thing, item.Front);
+		break;
+
+	case SI_Sector:
+		GLRenderer->ProcessSector(item.Front);
+		break;
+	}
+}
+
 
 static void UnclipSubsector(subsector_t *sub)
 {
@@ -158,7 +307,7 @@ static void AddLine (seg_t *seg)
 			// clipping checks are only needed when the backsector is not the same as the front sector
 			gl_CheckViewArea(seg->v1, seg->v2, seg->frontsector, seg->backsector);
 
-			backsector = gl_FakeFlat(seg->backsector, &bs, true);
+			backsector = gl_FakeFlat(seg->backsector, FakeSectorDest(&bs), true);
 
 			if (gl_CheckClip(seg->sidedef, currentsector, backsector))
 			{
@@ -182,9 +331,20 @@ static void AddLine (seg_t *seg)
 		{
 			SetupWall.Clock();
 
-			GLWall wall;
-			wall.sub = currentsubsector;
-			wall.Process(seg, currentsector, backsector);
+			if (ThreadedSetup)
+			{
+				FSetupItem *item = QueueSetupItem(SI_Wall, currentsector);
+				item->Seg = seg;
+				item->Sub = currentsubsector;
+				item->Back = KeepSector(backsector);
+				item->Serial = IsPortalWall(seg, currentsector, item->Back);
+			}
+			else
+			{
+				GLWall wall;
+				wall.sub = currentsubsector;
+				wall.Process(seg, currentsector, backsector);
+			}
 			rendered_lines++;
 
 			SetupWall.Unclock();
@@ -334,7 +494,8 @@ static inline void RenderThings(subsector_t * sub, sector_t * sector)
 		// Handle all things in sector.
 		for (AActor * thing = sec->thinglist; thing; thing = thing->snext)
 		{
-			GLRenderer->ProcessSprite(thing, sector);
+			if (ThreadedSetup) QueueSetupItem(SI_Sprite, sector)->Thing = thing;
+			else GLRenderer->ProcessSprite(thing, sector);
 		}
 	}
 	SetupSprite.Unclock();
@@ -383,7 +544,7 @@ static void DoSubsector(subsector_t * sub)
 		UnclipSubsector(sub);
 	}
 
-	fakesector=gl_FakeFlat(sector, &fake, false);
+	fakesector=KeepSector(gl_FakeFlat(sector, FakeSectorDest(&fake), false));
 
 	if (sector->validcount != validcount)
 	{
@@ -398,7 +559,8 @@ static void DoSubsector(subsector_t * sub)
 
 		for (i = ParticlesInSubsec[DWORD(sub-subsectors)]; i != NO_PARTICLE; i = Particles[i].snext)
 		{
-			GLRenderer->ProcessParticle(&Particles[i], fakesector);
+			if (ThreadedSetup) QueueSetupItem(SI_Particle, fakesector)->Particle = &Particles[i];
+			else GLRenderer->ProcessParticle(&Particles[i], fakesector);
 		}
 		SetupSprite.Unclock();
 	}
@@ -437,7 +599,7 @@ static void DoSubsector(subsector_t * sub)
 					sector = sub->render_sector;
 					// the planes of this subsector are faked to belong to another sector
 					// This means we need the heightsec parts and light info of the render sector, not the actual one.
-					fakesector = gl_FakeFlat(sector, &fake, false);
+					fakesector = KeepSector(gl_FakeFlat(sector, FakeSectorDest(&fake), false));
 				}
 
 				BYTE &srf = gl_drawinfo->sectorrenderflags[sub->render_sector->sectornum];
@@ -446,7 +608,12 @@ static void DoSubsector(subsector_t * sub)
 					srf |= SSRF_PROCESSED;
 
 					SetupFlat.Clock();
-					GLRenderer->ProcessSector(fakesector);
+					if (ThreadedSetup)
+					{
+						FSetupItem *item = QueueSetupItem(SI_Sector, fakesector);
+						item->Serial = fakesector->portals[sector_t::floor] != NULL || fakesector->portals[sector_t::ceiling] != NULL;
+					}
+					else GLRenderer->ProcessSector(fakesector);
 					SetupFlat.Unclock();
 				}
 				// mark subsector as processed - but mark for rendering only if it has an actual area.
@@ -519,3 +686,217 @@ void gl_RenderBSPNode (void *node)
 }
 
 
+
+
+//==========================================================================
+//
+// Setup workers
+//
+//==========================================================================
+
+template<class T> static void GrowSinkArray(TArray<T> &array, unsigned int minsize)
+{
+	// The sink is empty at this point so this only reallocates.
+	array.Grow(array.Max() < minsize ? minsize : array.Max() + 1);
+}
+
+template<class T> static void TruncateSinkArray(TArray<T> &array, unsigned int size)
+{
+	array.Delete(size, array.Size() - size);
+}
+
+static void GrowSink(FSetupSink &sink, unsigned int minsize)
+{
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		GLDrawList &dl = sink.drawlists[i];
+		GrowSinkArray(dl.walls, minsize);
+		GrowSinkArray(dl.flats, minsize);
+		GrowSinkArray(dl.sprites, minsize);
+		GrowSinkArray(dl.drawitems, minsize);
+	}
+	sink.Full = false;
+}
+
+static void SetupWorker(unsigned int index, int thread, void *)
+{
+	FSetupItem &item = SetupItems[index];
+	FSetupSink &sink = SetupSinks[thread];
+	unsigned int walls[GLDL_TYPES], flats[GLDL_TYPES], sprites[GLDL_TYPES];
+	int rendered_flats = sink.rendered_flats;
+	int rendered_sprites = sink.rendered_sprites;
+	int render_texsplit = sink.render_texsplit;
+
+	item.Thread = thread;
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		GLDrawList &dl = sink.drawlists[i];
+		item.Start[i] = dl.drawitems.Size();
+		walls[i] = dl.walls.Size();
+		flats[i] = dl.flats.Size();
+		sprites[i] = dl.sprites.Size();
+	}
+
+	if (item.Serial) return;
+
+	in_area = item.Area;
+	gl_setupsink = &sink;
+	try
+	{
+		ProcessSetupItem(item);
+	}
+	catch (FSetupSerialOnly &)
+	{
+		// Throw away whatever this item has produced so far and leave it to
+		// the main thread.
+		item.Serial = true;
+		for (int i = 0; i < GLDL_TYPES; i++)
+		{
+			GLDrawList &dl = sink.drawlists[i];
+			TruncateSinkArray(dl.drawitems, item.Start[i]);
+			TruncateSinkArray(dl.walls, walls[i]);
+			TruncateSinkArray(dl.flats, flats[i]);
+			TruncateSinkArray(dl.sprites, sprites[i]);
+		}
+		sink.rendered_flats = rendered_flats;
+		sink.rendered_sprites = rendered_sprites;
+		sink.render_texsplit = render_texsplit;
+	}
+	gl_setupsink = NULL;
+
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		item.End[i] = sink.drawlists[i].drawitems.Size();
+	}
+}
+
+//==========================================================================
+//
+// Copies one item's output from its worker's draw lists to gl_drawinfo
+//
+//==========================================================================
+
+static void MergeSetupItem(FSetupItem &item)
+{
+	FSetupSink &sink = SetupSinks[item.Thread];
+	int spriteindex = -1;
+
+	for (int i = 0; i < GLDL_TYPES; i++)
+	{
+		GLDrawList &from = sink.drawlists[i];
+		GLDrawList &to = gl_drawinfo->drawlists[i];
+
+		for (unsigned int j = item.Start[i]; j < item.End[i]; j++)
+		{
+			GLDrawItem &di = from.drawitems[j];
+			switch (di.rendertype)
+			{
+			case GLDIT_WALL:
+				to.AddWall(&from.walls[di.index]);
+				break;
+
+			case GLDIT_FLAT:
+				to.AddFlat(&from.flats[di.index]);
+				break;
+
+			case GLDIT_SPRITE:
+				// All parts of a split sprite share one index, just like
+				// GLSprite::Process would have given them.
+				if (item.Type == SI_Sprite)
+				{
+					if (spriteindex < 0) spriteindex = GLRenderer->gl_spriteindex++;
+					from.sprites[di.index].index = spriteindex;
+				}
+				to.AddSprite(&from.sprites[di.index]);
+				break;
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+// gl_StartSetupItems
+//
+//==========================================================================
+
+void gl_StartSetupItems()
+{
+	ThreadedSetup = gl_setupthreads > 1;
+	SetupItems.Clear();
+	NumFakeSectors = 0;
+
+	if (ThreadedSetup && NumSetupSinks != gl_setupthreads)
+	{
+		delete[] SetupSinks;
+		NumSetupSinks = gl_setupthreads;
+		SetupSinks = new FSetupSink[NumSetupSinks];
+		for (int i = 0; i < NumSetupSinks; i++)
+		{
+			SetupSinks[i].rendered_flats = 0;
+			SetupSinks[i].rendered_sprites = 0;
+			SetupSinks[i].render_texsplit = 0;
+			GrowSink(SetupSinks[i], 256);
+		}
+	}
+}
+
+//==========================================================================
+//
+// gl_ProcessSetupItems
+//
+// Processes everything the BSP traversal has queued and fills gl_drawinfo's
+// draw lists.
+//
+//==========================================================================
+
+void gl_ProcessSetupItems()
+{
+	if (!ThreadedSetup) return;
+	ThreadedSetup = false;
+
+	area_t savedarea = in_area;
+
+	SetupThreads.Clock();
+	if (SetupItems.Size() > 0)
+	{
+		WorkerPool.Run(NumSetupSinks, SetupItems.Size(), SetupWorker);
+	}
+	SetupThreads.Unclock();
+
+	for (unsigned int i = 0; i < SetupItems.Size(); i++)
+	{
+		FSetupItem &item = SetupItems[i];
+
+		if (item.Serial)
+		{
+			in_area = item.Area;
+			ProcessSetupItem(item);
+		}
+		else
+		{
+			MergeSetupItem(item);
+		}
+	}
+	in_area = savedarea;
+
+	for (int i = 0; i < NumSetupSinks; i++)
+	{
+		FSetupSink &sink = SetupSinks[i];
+
+		rendered_flats += sink.rendered_flats;
+		rendered_sprites += sink.rendered_sprites;
+		render_texsplit += sink.render_texsplit;
+		sink.rendered_flats = sink.rendered_sprites = sink.render_texsplit = 0;
+
+		for (int j = 0; j < GLDL_TYPES; j++)
+		{
+			sink.drawlists[j].Reset();
+		}
+		if (sink.Full)
+		{
+			GrowSink(sink, 0);
+		}
+	}
+	SetupItems.Clear();
+}
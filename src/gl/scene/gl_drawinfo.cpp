@@ -36,11 +36,14 @@
 //      sorting algorithm for translucent objects.
 
 
+#include <algorithm>
 #include "gl/system/gl_system.h"
 #include "r_sky.h"
 #include "r_utility.h"
 #include "r_state.h"
 #include "doomstat.h"
+#include "c_dispatch.h"
+#include "m_random.h"
 
 #include "gl/system/gl_cvars.h"
 #include "gl/data/gl_data.h"
@@ -52,6 +55,7 @@
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_templates.h"
+#include "gl/utility/gl_threads.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/stereo3d/scoped_color_mask.h"
 
@@ -62,10 +66,18 @@ FDrawInfo * gl_drawinfo;
 //
 //
 //==========================================================================
-class StaticSortNodeArray : public TDeletingArray<SortNode*>
+class StaticSortNodeArray : public TArray<SortNode*>
 {
+	enum { BLOCKSIZE = 1024 };
+
+	TArray<SortNode*> blocks;
 	unsigned usecount;
 public:
+	StaticSortNodeArray() { usecount = 0; }
+	~StaticSortNodeArray()
+	{
+		for (unsigned i = 0; i < blocks.Size(); i++) delete[] blocks[i];
+	}
 	unsigned Size() { return usecount; }
 	void Clear() { usecount=0; }
 	void Release(int start) { usecount=start; }
@@ -77,7 +89,12 @@ SortNode * StaticSortNodeArray::GetNew()
 {
 	if (usecount==TArray<SortNode*>::Size())
 	{
-		Push(new SortNode);
+		// Allocate the nodes in blocks so that scenes with thousands of translucent
+		// objects don't need an allocation for each of them the first time around
+		// and the nodes of one sort tree are close together in memory.
+		SortNode *block = new SortNode[BLOCKSIZE];
+		blocks.Push(block);
+		for (int i = 0; i < BLOCKSIZE; i++) Push(&block[i]);
 	}
 	return operator[](usecount++);
 }
@@ -224,11 +241,17 @@ void GLDrawList::MakeSortList()
 //
 //
 //==========================================================================
-SortNode * GLDrawList::FindSortPlane(SortNode * head)
+SortNode * GLDrawList::FindSortPlane(SortNode * head, bool * haswall)
 {
-	while (head->next && drawitems[head->itemindex].rendertype!=GLDIT_FLAT) 
-		head=head->next;
-	if (drawitems[head->itemindex].rendertype==GLDIT_FLAT) return head;
+	// also checks for walls so that the search for a sort wall can be skipped
+	// for the lists that only contain sprites.
+	*haswall = false;
+	for (; head; head = head->next)
+	{
+		GLDrawItemType type = drawitems[head->itemindex].rendertype;
+		if (type == GLDIT_FLAT) return head;
+		if (type == GLDIT_WALL) *haswall = true;
+	}
 	return NULL;
 }
 
@@ -549,6 +572,28 @@ int __cdecl CompareSprite(const void * a,const void * b)
 	return gd->CompareSprites(*(SortNode**)a,*(SortNode**)b);
 }
 
+static bool sortreference;	// use qsort with CompareSprite, for sortbench
+
+//==========================================================================
+//
+// Sort key for the sprite list: sorts by depth, back to front, then by
+// index in the same order as CompareSprites. Packing both into one
+// integer makes the comparisons trivial and avoids going through the
+// draw item and sprite arrays for each of them.
+//
+//==========================================================================
+
+struct FSpriteSortKey
+{
+	QWORD key;
+	SortNode * node;
+
+	bool operator < (const FSpriteSortKey &other) const
+	{
+		return key < other.key;
+	}
+};
+
 //==========================================================================
 //
 //
@@ -561,13 +606,34 @@ SortNode * GLDrawList::SortSpriteList(SortNode * head)
 	unsigned i;
 
 	static TArray<SortNode*> sortspritelist;
+	static TArray<FSpriteSortKey> sortkeys;
 
 	SortNode * parent=head->parent;
 
 	sortspritelist.Clear();
 	for(count=0,n=head;n;n=n->next) sortspritelist.Push(n);
-	gd=this;
-	qsort(&sortspritelist[0],sortspritelist.Size(),sizeof(SortNode *),CompareSprite);
+	if (sortreference)
+	{
+		gd=this;
+		qsort(&sortspritelist[0],sortspritelist.Size(),sizeof(SortNode *),CompareSprite);
+	}
+	else
+	{
+		// flipping the sign bit makes the signed values sort correctly as unsigned ones.
+		DWORD indexmask = (i_compatflags & COMPATF_SPRITESORT)? 0x80000000 : 0x7fffffff;
+
+		sortkeys.Resize(sortspritelist.Size());
+		for(i=0;i<sortspritelist.Size();i++)
+		{
+			GLSprite * s=&sprites[drawitems[sortspritelist[i]->itemindex].index];
+			DWORD depthkey = ~((DWORD)s->depth ^ 0x80000000);
+			DWORD indexkey = (DWORD)s->index ^ indexmask;
+			sortkeys[i].key = ((QWORD)depthkey << 32) | indexkey;
+			sortkeys[i].node = sortspritelist[i];
+		}
+		std::sort(&sortkeys[0], &sortkeys[0] + sortkeys.Size());
+		for(i=0;i<sortkeys.Size();i++) sortspritelist[i] = sortkeys[i].node;
+	}
 	for(i=0;i<sortspritelist.Size();i++)
 	{
 		sortspritelist[i]->next=NULL;
@@ -585,8 +651,9 @@ SortNode * GLDrawList::SortSpriteList(SortNode * head)
 SortNode * GLDrawList::DoSort(SortNode * head)
 {
 	SortNode * node, * sn, * next;
+	bool haswall;
 
-	sn=FindSortPlane(head);
+	sn=FindSortPlane(head, &haswall);
 	if (sn)
 	{
 		if (sn==head) head=head->next;
@@ -615,7 +682,7 @@ SortNode * GLDrawList::DoSort(SortNode * head)
 	}
 	else
 	{
-		sn=FindSortWall(head);
+		sn=haswall? FindSortWall(head) : NULL;
 		if (sn)
 		{
 			if (sn==head) head=head->next;
@@ -664,6 +731,7 @@ void GLDrawList::DoDraw(int pass, int i, bool trans)
 		{
 			GLFlat * f=&flats[drawitems[i].index];
 			RenderFlat.Clock();
+			gl_RenderState.EnableBatching(false);
 			f->Draw(pass, trans);
 			RenderFlat.Unclock();
 		}
@@ -673,6 +741,7 @@ void GLDrawList::DoDraw(int pass, int i, bool trans)
 		{
 			GLWall * w=&walls[drawitems[i].index];
 			RenderWall.Clock();
+			gl_RenderState.EnableBatching(false);
 			w->Draw(pass);
 			RenderWall.Unclock();
 		}
@@ -682,6 +751,9 @@ void GLDrawList::DoDraw(int pass, int i, bool trans)
 		{
 			GLSprite * s=&sprites[drawitems[i].index];
 			RenderSprite.Clock();
+			// Sprites only change the GL state through gl_RenderState so a run of them
+			// can be batched. Models and everything else may not.
+			gl_RenderState.EnableBatching(s->modelframe == NULL);
 			s->Draw(pass);
 			RenderSprite.Unclock();
 		}
@@ -767,11 +839,118 @@ void GLDrawList::DrawSorted()
 	glEnable(GL_CLIP_DISTANCE2);
 	glEnable(GL_CLIP_DISTANCE3);
 	DoDrawSorted(sorted);
+	gl_RenderState.EnableBatching(false);
 	glDisable(GL_CLIP_DISTANCE2);
 	glDisable(GL_CLIP_DISTANCE3);
 	gl_RenderState.ClearClipSplit();
 }
 
+//==========================================================================
+//
+// Collects the draw order of a sort tree in the same order as
+// DoDrawSorted. Sprites are identified by their index because
+// the pieces of a split sprite may be sorted either way.
+//
+//==========================================================================
+
+static void CollectSortOrder(GLDrawList &list, SortNode * head, TArray<int> &order)
+{
+	if (head->left) CollectSortOrder(list, head->left, order);
+	for (SortNode * node = head; node; node = node->equal)
+	{
+		GLDrawItem &item = list.drawitems[node->itemindex];
+		order.Push(item.rendertype == GLDIT_SPRITE? list.sprites[item.index].index : -1 - node->itemindex);
+	}
+	if (head->right) CollectSortOrder(list, head->right, order);
+}
+
+//==========================================================================
+//
+// Sorts a synthetic scene with lots of translucent sprites and some
+// translucent walls in between, once with the old qsort based sprite
+// sorting and once with the current code, and checks that both produce
+// the same draw order.
+//
+//==========================================================================
+
+CCMD(sortbench)
+{
+	int numsprites = argv.argc() > 1 ? clamp(atoi(argv[1]), 1, 100000) : 5000;
+	int numwalls = argv.argc() > 2 ? clamp(atoi(argv[2]), 0, 10000) : 50;
+	const int passes = 10;
+	GLDrawList scene;
+	TArray<int> reforder, optorder;
+	cycle_t reftime, opttime;
+	FRandom rng;
+	int i;
+
+	// The viewer is at the origin looking along the x-axis.
+	rng.Init(numsprites);
+	for (i = 0; i < numsprites; i++)
+	{
+		GLSprite s = GLSprite();
+		s.x = float(64 + rng.GenRand_Real1() * 4000);
+		s.y = float(rng.GenRand_Real1() * 4000 - 2000);
+		s.z = float(rng.GenRand_Real1() * 256);
+
+		// billboard facing the viewer
+		float len = sqrtf(s.x * s.x + s.y * s.y);
+		float dx = -s.y / len * 16, dy = s.x / len * 16;
+		s.x1 = s.x - dx; s.y1 = s.y - dy; s.z1 = s.z + 32;
+		s.x2 = s.x + dx; s.y2 = s.y + dy; s.z2 = s.z;
+		s.ul = 0; s.ur = 1;
+		s.vt = 0; s.vb = 1;
+		s.depth = int(s.x * 16);
+		s.index = i;
+		scene.AddSprite(&s);
+	}
+	for (i = 0; i < numwalls; i++)
+	{
+		GLWall w = GLWall();
+		float x = float(64 + rng.GenRand_Real1() * 4000);
+		float y = float(rng.GenRand_Real1() * 4000 - 2000);
+		float angle = float(rng.GenRand_Real1() * M_PI);
+		float dx = cosf(angle) * 128, dy = sinf(angle) * 128;
+		w.glseg.x1 = x - dx; w.glseg.y1 = y - dy;
+		w.glseg.x2 = x + dx; w.glseg.y2 = y + dy;
+		w.ztop[0] = w.ztop[1] = 256;
+		w.uprgt.u = w.lorgt.u = 1;
+		w.type = RENDERWALL_M2S;
+		w.viewdistance = FLOAT2FIXED(sqrtf(x * x + y * y));
+		scene.AddWall(&w);
+	}
+
+	reftime.Reset();
+	opttime.Reset();
+	for (int pass = 0; pass < 2 * passes; pass++)
+	{
+		bool reference = !(pass & 1);
+		GLDrawList list;
+
+		list.walls = scene.walls;
+		list.sprites = scene.sprites;
+		list.drawitems = scene.drawitems;
+
+		sortreference = reference;
+		cycle_t &time = reference? reftime : opttime;
+		time.Clock();
+		list.MakeSortList();
+		list.sorted = list.DoSort(SortNodes[list.SortNodeStart]);
+		time.Unclock();
+
+		TArray<int> &order = reference? reforder : optorder;
+		order.Clear();
+		CollectSortOrder(list, list.sorted, order);
+	}
+	sortreference = false;
+
+	bool same = reforder.Size() == optorder.Size() &&
+		!memcmp(&reforder[0], &optorder[0], reforder.Size() * sizeof(int));
+	Printf("%d sprites, %d walls, %u draw items after splitting\n", numsprites, numwalls, optorder.Size());
+	Printf("reference: %2.3f ms, optimized: %2.3f ms per sort, %s draw order\n",
+		reftime.TimeMS() / passes, opttime.TimeMS() / passes, same? "same" : "different");
+}
+
 //==========================================================================
 //
 //
@@ -783,6 +962,7 @@ void GLDrawList::Draw(int pass, bool trans)
 	{
 		DoDraw(pass, i, trans);
 	}
+	gl_RenderState.EnableBatching(false);
 }
 
 //==========================================================================
@@ -793,10 +973,12 @@ void GLDrawList::Draw(int pass, bool trans)
 void GLDrawList::DrawWalls(int pass)
 {
 	RenderWall.Clock();
+	gl_RenderState.EnableBatching(pass != GLPASS_LIGHTSONLY);
 	for(unsigned i=0;i<drawitems.Size();i++)
 	{
 		walls[drawitems[i].index].Draw(pass);
 	}
+	gl_RenderState.EnableBatching(false);
 	RenderWall.Unclock();
 }
 
@@ -808,10 +990,12 @@ void GLDrawList::DrawWalls(int pass)
 void GLDrawList::DrawFlats(int pass)
 {
 	RenderFlat.Clock();
+	gl_RenderState.EnableBatching(pass != GLPASS_LIGHTSONLY);
 	for(unsigned i=0;i<drawitems.Size();i++)
 	{
 		flats[drawitems[i].index].Draw(pass, false);
 	}
+	gl_RenderState.EnableBatching(false);
 	RenderFlat.Unclock();
 }
 
@@ -830,11 +1014,20 @@ void GLDrawList::DrawDecals()
 
 //==========================================================================
 //
-// Sorting the drawitems first by texture and then by light level.
+// Sorting the drawitems first by texture and then by light level
+// so that as many as possible can be drawn in one batch.
 //
 //==========================================================================
 static GLDrawList * sortinfo;
 
+static int CompareLight(int l1, const FColormap &c1, int l2, const FColormap &c2)
+{
+	if (l1 != l2) return l1 - l2;
+	if (c1.LightColor.d != c2.LightColor.d) return c1.LightColor.d < c2.LightColor.d ? -1 : 1;
+	if (c1.FadeColor.d != c2.FadeColor.d) return c1.FadeColor.d < c2.FadeColor.d ? -1 : 1;
+	return c1.desaturation - c2.desaturation;
+}
+
 static int __cdecl diwcmp (const void *a, const void *b)
 {
 	const GLDrawItem * di1 = (const GLDrawItem *)a;
@@ -844,7 +1037,8 @@ static int __cdecl diwcmp (const void *a, const void *b)
 	GLWall * w2=&sortinfo->walls[di2->index];
 
 	if (w1->gltexture != w2->gltexture) return w1->gltexture - w2->gltexture;
-	return ((w1->flags & 3) - (w2->flags & 3));
+	if ((w1->flags & 3) != (w2->flags & 3)) return ((w1->flags & 3) - (w2->flags & 3));
+	return CompareLight(w1->lightlevel + w1->rellight, w1->Colormap, w2->lightlevel + w2->rellight, w2->Colormap);
 }
 
 static int __cdecl difcmp (const void *a, const void *b)
@@ -855,7 +1049,8 @@ static int __cdecl difcmp (const void *a, const void *b)
 	const GLDrawItem * di2 = (const GLDrawItem *)b;
 	GLFlat* w2=&sortinfo->flats[di2->index];
 
-	return w1->gltexture - w2->gltexture;
+	if (w1->gltexture != w2->gltexture) return w1->gltexture - w2->gltexture;
+	return CompareLight(w1->lightlevel, w1->Colormap, w2->lightlevel, w2->Colormap);
 }
 
 
@@ -907,6 +1102,66 @@ void GLDrawList::AddSprite(GLSprite * sprite)
 	drawitems.Push(GLDrawItem(GLDIT_SPRITE,sprites.Push(*sprite)));
 }
 
+//==========================================================================
+//
+// gl_AddToDrawList
+//
+//==========================================================================
+
+template<class T> static void CheckSinkRoom(const TArray<T> &array)
+{
+	if (array.Size() == array.Max())
+	{
+		gl_setupsink->Full = true;
+		throw FSetupSerialOnly();
+	}
+}
+
+void gl_AddToDrawList(int list, GLWall *wall)
+{
+	if (gl_setupsink == NULL)
+	{
+		gl_drawinfo->drawlists[list].AddWall(wall);
+	}
+	else
+	{
+		GLDrawList &dl = gl_setupsink->drawlists[list];
+		CheckSinkRoom(dl.walls);
+		CheckSinkRoom(dl.drawitems);
+		dl.AddWall(wall);
+	}
+}
+
+void gl_AddToDrawList(int list, GLFlat *flat)
+{
+	if (gl_setupsink == NULL)
+	{
+		gl_drawinfo->drawlists[list].AddFlat(flat);
+	}
+	else
+	{
+		GLDrawList &dl = gl_setupsink->drawlists[list];
+		CheckSinkRoom(dl.flats);
+		CheckSinkRoom(dl.drawitems);
+		dl.AddFlat(flat);
+	}
+}
+
+void gl_AddToDrawList(int list, GLSprite *sprite)
+{
+	if (gl_setupsink == NULL)
+	{
+		gl_drawinfo->drawlists[list].AddSprite(sprite);
+	}
+	else
+	{
+		GLDrawList &dl = gl_setupsink->drawlists[list];
+		CheckSinkRoom(dl.sprites);
+		CheckSinkRoom(dl.drawitems);
+		dl.AddSprite(sprite);
+	}
+}
+
 
 //==========================================================================
 //
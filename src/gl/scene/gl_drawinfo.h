@@ -111,7 +111,7 @@ public:
 
 
 	void MakeSortList();
-	SortNode * FindSortPlane(SortNode * head);
+	SortNode * FindSortPlane(SortNode * head, bool * haswall);
 	SortNode * FindSortWall(SortNode * head);
 	void SortPlaneIntoPlane(SortNode * head,SortNode * sort);
 	void SortWallIntoPlane(SortNode * head,SortNode * sort);
@@ -134,6 +134,32 @@ public:
 } ;
 
 
+//==========================================================================
+//
+// The output of one scene setup worker. Its draw lists are copied to
+// gl_drawinfo in BSP traversal order once all workers are done. They must
+// not grow on a worker, because that would go through M_Realloc, so an
+// item that does not fit is processed again on the main thread and the
+// lists are enlarged afterwards.
+//
+//==========================================================================
+
+struct FSetupSink
+{
+	GLDrawList drawlists[GLDL_TYPES];
+	int rendered_flats;
+	int rendered_sprites;
+	int render_texsplit;
+	bool Full;
+};
+
+// Puts a processed wall, flat or sprite in one of gl_drawinfo's draw lists,
+// or in the current worker's on a setup worker.
+void gl_AddToDrawList(int list, GLWall *wall);
+void gl_AddToDrawList(int list, GLFlat *flat);
+void gl_AddToDrawList(int list, GLSprite *sprite);
+
+
 //==========================================================================
 //
 // these are used to link faked planes due to missing textures to a sector
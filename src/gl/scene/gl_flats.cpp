@@ -53,12 +53,14 @@
 #include "gl/dynlights/gl_dynlight.h"
 #include "gl/dynlights/gl_glow.h"
 #include "gl/dynlights/gl_lightbuffer.h"
+#include "gl/dynlights/gl_lightclusters.h"
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/shaders/gl_shader.h"
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_convert.h"
 #include "gl/utility/gl_templates.h"
+#include "gl/utility/gl_threads.h"
 
 #ifdef _DEBUG
 CVAR(Int, gl_breaksec, -1, 0)
@@ -113,8 +115,6 @@ extern FDynLightData lightdata;
 
 void GLFlat::SetupSubsectorLights(int pass, subsector_t * sub, int *dli)
 {
-	Plane p;
-
 	if (dli != NULL && *dli != -1)
 	{
 		gl_RenderState.ApplyLightIndex(GLRenderer->mLights->GetIndex(*dli));
@@ -122,31 +122,15 @@ void GLFlat::SetupSubsectorLights(int pass, subsector_t * sub, int *dli)
 		return;
 	}
 
+	LightSetup.Clock();
 	lightdata.Clear();
-	FLightNode * node = sub->lighthead;
-	while (node)
+	if (gl_LightClusters.IsValid())
 	{
-		ADynamicLight * light = node->lightsource;
-			
-		if (light->flags2&MF2_DORMANT)
-		{
-			node=node->nextLight;
-			continue;
-		}
-		iter_dlightf++;
-
-		// we must do the side check here because gl_SetupLight needs the correct plane orientation
-		// which we don't have for Legacy-style 3D-floors
-		fixed_t planeh = plane.plane.ZatPoint(light);
-		if (gl_lights_checkside && ((planeh<light->Z() && ceiling) || (planeh>light->Z() && !ceiling)))
-		{
-			node=node->nextLight;
-			continue;
-		}
-
-		p.Set(plane.plane);
-		gl_GetLight(p, light, false, false, lightdata);
-		node = node->nextLight;
+		gl_LightClusters.GetFlatLights(plane.plane, ceiling, sub, lightdata);
+	}
+	else
+	{
+		gl_GetFlatLightsFromNodes(plane.plane, ceiling, sub->lighthead, lightdata);
 	}
 
 	int d = GLRenderer->mLights->UploadLights(lightdata);
@@ -158,6 +142,7 @@ void GLFlat::SetupSubsectorLights(int pass, subsector_t * sub, int *dli)
 	{
 		gl_RenderState.ApplyLightIndex(d);
 	}
+	LightSetup.Unclock();
 }
 
 //==========================================================================
@@ -276,9 +261,7 @@ void GLFlat::DrawSubsectors(int pass, bool processlights, bool istrans)
 				if (gl_drawinfo->ss_renderflags[sub-subsectors]&renderflags || istrans)
 				{
 					if (processlights) SetupSubsectorLights(GLPASS_ALL, sub, &dli);
-					drawcalls.Clock();
-					glDrawArrays(GL_TRIANGLE_FAN, index, sub->numlines);
-					drawcalls.Unclock();
+					GLRenderer->mVBO->RenderArray(GL_TRIANGLE_FAN, index, sub->numlines);
 					flatvertices += sub->numlines;
 					flatprimitives++;
 				}
@@ -403,7 +386,7 @@ inline void GLFlat::PutFlat(bool fog)
 		bool masked = gltexture->isMasked() && ((renderflags&SSRF_RENDER3DPLANES) || stack);
 		list = masked ? GLDL_MASKEDFLATS : GLDL_PLAINFLATS;
 	}
-	gl_drawinfo->drawlists[list].AddFlat (this);
+	gl_AddToDrawList(list, this);
 }
 
 //==========================================================================
@@ -444,7 +427,8 @@ void GLFlat::Process(sector_t * model, int whichplane, bool fog)
 	z = plane.plane.ZatPoint(0.f, 0.f);
 	
 	PutFlat(fog);
-	rendered_flats++;
+	if (gl_setupsink != NULL) gl_setupsink->rendered_flats++;
+	else rendered_flats++;
 }
 
 //==========================================================================
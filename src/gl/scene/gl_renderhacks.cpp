@@ -49,6 +49,7 @@
 #include "gl/scene/gl_portal.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_templates.h"
+#include "gl/utility/gl_threads.h"
 
 
 // This is for debugging maps.
@@ -140,6 +141,7 @@ void FDrawInfo::AddOtherCeilingPlane(int sector, gl_subsectorrendernode * node)
 void FDrawInfo::AddUpperMissingTexture(side_t * side, subsector_t *sub, fixed_t backheight)
 {
 	if (!side->segs[0]->backsector) return;
+	gl_MainThreadOnly();
 
 	totalms.Clock();
 	for(int i=0; i<side->numsegs; i++)
@@ -203,6 +205,7 @@ void FDrawInfo::AddLowerMissingTexture(side_t * side, subsector_t *sub, fixed_t
 		// process the missing texture for them.
 		if (backsec->transdoorheight == backsec->GetPlaneTexZ(sector_t::floor)) return;
 	}
+	gl_MainThreadOnly();
 
 	totalms.Clock();
 	// we need to check all segs of this sidedef
@@ -1026,11 +1029,13 @@ ADD_STAT(sectorhacks)
 
 void FDrawInfo::AddFloorStack(sector_t * sec)
 {
+	gl_MainThreadOnly();
 	FloorStacks.Push(sec);
 }
 
 void FDrawInfo::AddCeilingStack(sector_t * sec)
 {
+	gl_MainThreadOnly();
 	CeilingStacks.Push(sec);
 }
 
@@ -54,6 +54,7 @@
 #include "gl/gl_functions.h"
 
 #include "gl/dynlights/gl_lightbuffer.h"
+#include "gl/dynlights/gl_lightclusters.h"
 #include "gl/system/gl_interface.h"
 #include "gl/system/gl_framebuffer.h"
 #include "gl/system/gl_cvars.h"
@@ -70,6 +71,7 @@
 #include "gl/stereo3d/gl_stereo3d.h"
 #include "gl/stereo3d/scoped_view_shifter.h"
 #include "gl/textures/gl_material.h"
+#include "gl/textures/gl_texworker.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_convert.h"
 #include "gl/utility/gl_templates.h"
@@ -93,7 +95,7 @@ EXTERN_CVAR (Bool, r_deathcamera)
 extern int viewpitch;
  
 DWORD			gl_fixedcolormap;
-area_t			in_area;
+thread_local area_t in_area;
 TArray<BYTE> currentmapsection;
 
 void gl_ParseDefs();
@@ -313,7 +315,9 @@ void FGLRenderer::CreateScene()
 	for(unsigned i=0;i<portals.Size(); i++) portals[i]->glportal = NULL;
 	gl_spriteindex=0;
 	Bsp.Clock();
+	gl_StartSetupItems();
 	gl_RenderBSPNode (nodes + numnodes - 1);
+	gl_ProcessSetupItems();
 	Bsp.Unclock();
 
 	// And now the crappy hacks that have to be done to avoid rendering anomalies:
@@ -879,7 +883,12 @@ void FGLRenderer::RenderView (player_t* player)
 
 	P_FindParticleSubsectors ();
 
+	// replace placeholders for textures that have been upsampled in the background.
+	GLTextureWorker.UploadFinished(8);
+
 	GLRenderer->mLights->Clear();
+	if (gl_lights) gl_LightClusters.Build();
+	else gl_LightClusters.Clear();
 
 	// prepare all camera textures that have been used in the last frame
 	FCanvasTextureInfo::UpdateAll();
@@ -931,6 +940,8 @@ void FGLRenderer::WriteSavePic (player_t *player, FILE *file, int width, int hei
 	gl_RenderState.SetVertexBuffer(mVBO);
 	GLRenderer->mVBO->Reset();
 	GLRenderer->mLights->Clear();
+	if (gl_lights) gl_LightClusters.Build();
+	else gl_LightClusters.Clear();
 
 	// Check if there's some lights. If not some code can be skipped.
 	TThinkerIterator<ADynamicLight> it(STAT_DLIGHT);
@@ -49,6 +49,7 @@
 #include "gl/scene/gl_portal.h"
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_convert.h"
+#include "gl/utility/gl_threads.h"
 
 CVAR(Bool,gl_noskyboxes, false, 0)
 extern int skyfog;
@@ -157,6 +158,7 @@ void GLWall::SkyPlane(sector_t *sector, int plane, bool allowreflect)
 			}
 			else
 			{
+				gl_MainThreadOnly();
 				skyinfo.init(sector->sky, Colormap.FadeColor);
 				type = RENDERWALL_SKY;
 				sky = UniqueSkies.Get(&skyinfo);
@@ -196,6 +198,7 @@ void GLWall::SkyLine(line_t *line)
 	}
 	else
 	{
+		gl_MainThreadOnly();
 		skyinfo.init(line->frontsector->sky, Colormap.FadeColor);
 		type = RENDERWALL_SKY;
 		sky = UniqueSkies.Get(&skyinfo);
@@ -59,6 +59,7 @@
 #include "gl/textures/gl_material.h"
 #include "gl/utility/gl_clock.h"
 #include "gl/data/gl_vertexbuffer.h"
+#include "gl/utility/gl_threads.h"
 
 CVAR(Bool, gl_usecolorblending, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 CVAR(Bool, gl_spritebrightfog, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);
@@ -211,7 +212,23 @@ void GLSprite::Draw(int pass)
 		gl_RenderState.SetFog(0, 0);
 	}
 
-	if (gltexture) gl_RenderState.SetMaterial(gltexture, CLAMP_XY, translation, OverrideShader, !!(RenderStyle.Flags & STYLEF_RedIsAlpha));
+	// sprites get their atlas coordinates here so that splitting them in Process
+	// can still work with the material's own coordinates.
+	FAtlasEntry *atlas = NULL;
+	float uleft = ul, uright = ur, vtop = vt, vbottom = vb;
+	if (gltexture)
+	{
+		bool alphatexture = !!(RenderStyle.Flags & STYLEF_RedIsAlpha);
+		if (!alphatexture && !modelframe) atlas = gltexture->GetAtlasEntry(CLAMP_XY, translation);
+		gl_RenderState.SetMaterial(gltexture, CLAMP_XY, translation, OverrideShader, alphatexture, atlas);
+		if (atlas != NULL)
+		{
+			uleft = atlas->MapU(ul);
+			uright = atlas->MapU(ur);
+			vtop = atlas->MapV(vt);
+			vbottom = atlas->MapV(vb);
+		}
+	}
 	else if (!modelframe) gl_RenderState.EnableTexture(false);
 
 	if (!modelframe)
@@ -258,13 +275,13 @@ void GLSprite::Draw(int pass)
 		FFlatVertex *ptr;
 		unsigned int offset, count;
 		ptr = GLRenderer->mVBO->GetBuffer();
-		ptr->Set(v1[0], v1[1], v1[2], ul, vt);
+		ptr->Set(v1[0], v1[1], v1[2], uleft, vtop);
 		ptr++;
-		ptr->Set(v2[0], v2[1], v2[2], ur, vt);
+		ptr->Set(v2[0], v2[1], v2[2], uright, vtop);
 		ptr++;
-		ptr->Set(v3[0], v3[1], v3[2], ul, vb);
+		ptr->Set(v3[0], v3[1], v3[2], uleft, vbottom);
 		ptr++;
-		ptr->Set(v4[0], v4[1], v4[2], ur, vb);
+		ptr->Set(v4[0], v4[1], v4[2], uright, vbottom);
 		ptr++;
 		GLRenderer->mVBO->RenderCurrent(ptr, GL_TRIANGLE_STRIP, &offset, &count);
 
@@ -316,7 +333,7 @@ inline void GLSprite::PutSprite(bool translucent)
 	{
 		list = GLDL_MODELS;
 	}
-	gl_drawinfo->drawlists[list].AddSprite(this);
+	gl_AddToDrawList(list, this);
 }
 
 //==========================================================================
@@ -819,7 +836,8 @@ void GLSprite::Process(AActor* thing,sector_t * sector)
 	// end of light calculation
 
 	actor=thing;
-	index = GLRenderer->gl_spriteindex++;
+	// sprites from setup workers are numbered when they get merged.
+	index = gl_setupsink != NULL ? 0 : GLRenderer->gl_spriteindex++;
 	particle=NULL;
 	
 	const bool drawWithXYBillboard = ( !(actor->renderflags & RF_FORCEYBILLBOARD)
@@ -841,7 +859,8 @@ void GLSprite::Process(AActor* thing,sector_t * sector)
 	{
 		SplitSprite(thing->Sector, hw_styleflags != STYLEHW_Solid);
 	}
-	rendered_sprites++;
+	if (gl_setupsink != NULL) gl_setupsink->rendered_sprites++;
+	else rendered_sprites++;
 }
 
 
@@ -963,7 +982,8 @@ void GLSprite::ProcessParticle (particle_t *particle, sector_t *sector)//, int s
 	else hw_styleflags = STYLEHW_NoAlphaTest;
 
 	PutSprite(hw_styleflags != STYLEHW_Solid);
-	rendered_sprites++;
+	if (gl_setupsink != NULL) gl_setupsink->rendered_sprites++;
+	else rendered_sprites++;
 }
 
 
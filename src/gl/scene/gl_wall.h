@@ -21,6 +21,8 @@ struct GLSkyInfo;
 struct FTexCoordInfo;
 struct FPortal;
 struct FFlatVertex;
+struct FWallCacheKey;
+struct FWallCacheEntry;
 
 
 enum WallTypes
@@ -223,6 +225,7 @@ private:
 	void SplitRightEdge(texcoord * tcs, FFlatVertex *&ptr);
 	void SplitUpperEdge(texcoord * tcs, FFlatVertex *&ptr);
 	void SplitLowerEdge(texcoord * tcs, FFlatVertex *&ptr);
+	FWallCacheEntry *GetWallCache(texcoord * tcs, bool split, FWallCacheKey &key);
 
 public:
 
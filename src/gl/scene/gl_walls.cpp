@@ -55,6 +55,7 @@
 #include "gl/utility/gl_clock.h"
 #include "gl/utility/gl_geometric.h"
 #include "gl/utility/gl_templates.h"
+#include "gl/utility/gl_threads.h"
 #include "gl/shaders/gl_shader.h"
 
 
@@ -132,11 +133,14 @@ void GLWall::PutWall(bool translucent)
 
 	CheckGlowing();
 
+	// the portal manager is not thread safe.
+	if (!translucent && passflag[type] == 4 && type != RENDERWALL_COLORLAYER) gl_MainThreadOnly();
+
 	if (translucent) // translucent walls
 	{
 		viewdistance = P_AproxDistance( ((seg->linedef->v1->x+seg->linedef->v2->x)>>1) - viewx,
 											((seg->linedef->v1->y+seg->linedef->v2->y)>>1) - viewy);
-		gl_drawinfo->drawlists[GLDL_TRANSLUCENT].AddWall(this);
+		gl_AddToDrawList(GLDL_TRANSLUCENT, this);
 	}
 	else if (passflag[type]!=4)	// non-translucent walls
 	{
@@ -153,13 +157,13 @@ void GLWall::PutWall(bool translucent)
 		{
 			list = masked ? GLDL_MASKEDWALLS : GLDL_PLAINWALLS;
 		}
-		gl_drawinfo->drawlists[list].AddWall(this);
+		gl_AddToDrawList(list, this);
 
 	}
 	else switch (type)
 	{
 	case RENDERWALL_COLORLAYER:
-		gl_drawinfo->drawlists[GLDL_TRANSLUCENTBORDER].AddWall(this);
+		gl_AddToDrawList(GLDL_TRANSLUCENTBORDER, this);
 		break;
 
 	// portals don't go into the draw list.
@@ -206,7 +210,7 @@ void GLWall::PutWall(bool translucent)
 		{
 			// draw a reflective layer over the mirror
 			type=RENDERWALL_MIRRORSURFACE;
-			gl_drawinfo->drawlists[GLDL_TRANSLUCENTBORDER].AddWall(this);
+			gl_AddToDrawList(GLDL_TRANSLUCENTBORDER, this);
 		}
 		break;
 
@@ -275,7 +279,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 	{
 		return;
 	}
-	::SplitWall.Clock();
+	if (gl_setupsink == NULL) ::SplitWall.Clock();
 
 #ifdef _DEBUG
 	if (seg->linedef-lines==1)
@@ -348,7 +352,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 					copyWall1.lorgt.u = copyWall2.lolft.u = lolft.u + coeff * (lorgt.u-lolft.u);
 					copyWall1.lorgt.v = copyWall2.lolft.v = lolft.v + coeff * (lorgt.v-lolft.v);
 
-					::SplitWall.Unclock();
+					if (gl_setupsink == NULL) ::SplitWall.Unclock();
 
 					copyWall1.SplitWall(frontsector, translucent);
 					copyWall2.SplitWall(frontsector, translucent);
@@ -391,7 +395,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 					copyWall1.lorgt.u = copyWall2.lolft.u = lolft.u + coeff * (lorgt.u-lolft.u);
 					copyWall1.lorgt.v = copyWall2.lolft.v = lolft.v + coeff * (lorgt.v-lolft.v);
 
-					::SplitWall.Unclock();
+					if (gl_setupsink == NULL) ::SplitWall.Unclock();
 
 					copyWall1.SplitWall(frontsector, translucent);
 					copyWall2.SplitWall(frontsector, translucent);
@@ -412,7 +416,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 				lightlevel=ll;
 				Colormap=lc;
 
-				::SplitWall.Unclock();
+				if (gl_setupsink == NULL) ::SplitWall.Unclock();
 
 				return;
 			}
@@ -434,7 +438,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 			}
 			if (ztop[0]==zbottom[0] && ztop[1]==zbottom[1]) 
 			{
-				::SplitWall.Unclock();
+				if (gl_setupsink == NULL) ::SplitWall.Unclock();
 				return;
 			}
 		}
@@ -449,7 +453,7 @@ void GLWall::SplitWall(sector_t * frontsector, bool translucent)
 	lightlevel=ll;
 	Colormap=lc;
 	flags &= ~GLWF_NOSPLITUPPER;
-	::SplitWall.Unclock();
+	if (gl_setupsink == NULL) ::SplitWall.Unclock();
 }
 
 
@@ -1039,7 +1043,8 @@ void GLWall::DoMidTexture(seg_t * seg, bool drawfogboundary,
 
 				t=1;
 			}
-			render_texsplit+=t;
+			if (gl_setupsink != NULL) gl_setupsink->render_texsplit += t;
+			else render_texsplit+=t;
 		}
 		else
 		{
@@ -1465,6 +1470,7 @@ void GLWall::Process(seg_t *seg, sector_t * frontsector, sector_t * backsector)
 		glseg.fracright = 1;
 		if (gl_seamless)
 		{
+			if (v1->dirty || v2->dirty) gl_MainThreadOnly();
 			if (v1->dirty) gl_RecalcVertexHeights(v1);
 			if (v2->dirty) gl_RecalcVertexHeights(v2);
 		}
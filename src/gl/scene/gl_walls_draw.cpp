@@ -50,6 +50,7 @@
 #include "gl/dynlights/gl_dynlight.h"
 #include "gl/dynlights/gl_glow.h"
 #include "gl/dynlights/gl_lightbuffer.h"
+#include "gl/dynlights/gl_lightclusters.h"
 #include "gl/scene/gl_drawinfo.h"
 #include "gl/scene/gl_portal.h"
 #include "gl/shaders/gl_shader.h"
@@ -58,6 +59,7 @@
 #include "gl/utility/gl_templates.h"
 
 EXTERN_CVAR(Bool, gl_seamless)
+CVAR(Bool, gl_cachewalls, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 
 //==========================================================================
 //
@@ -89,6 +91,19 @@ void GLWall::SetupLights()
 	{
 		return;
 	}
+	LightSetup.Clock();
+	if (gl_LightClusters.IsValid())
+	{
+		if (seg->sidedef != NULL)
+		{
+			if (!(seg->sidedef->Flags & WALLF_POLYOBJ)) gl_LightClusters.GetWallLights(vtx, p, seg->sidedef, NULL, lightdata);
+			else if (sub) gl_LightClusters.GetWallLights(vtx, p, NULL, sub, lightdata);
+		}
+		dynlightindex = GLRenderer->mLights->UploadLights(lightdata);
+		LightSetup.Unclock();
+		return;
+	}
+
 	FLightNode *node;
 	if (seg->sidedef == NULL)
 	{
@@ -105,64 +120,55 @@ void GLWall::SetupLights()
 	}
 	else node = NULL;
 
-	// Iterate through all dynamic lights which touch this wall and render them
-	while (node)
-	{
-		if (!(node->lightsource->flags2&MF2_DORMANT))
-		{
-			iter_dlight++;
+	gl_GetWallLightsFromNodes(vtx, p, node, lightdata);
 
-			Vector fn, pos;
+	dynlightindex = GLRenderer->mLights->UploadLights(lightdata);
+	LightSetup.Unclock();
+}
 
-			float x = FIXED2FLOAT(node->lightsource->X());
-			float y = FIXED2FLOAT(node->lightsource->Y());
-			float z = FIXED2FLOAT(node->lightsource->Z());
-			float dist = fabsf(p.DistToPoint(x, z, y));
-			float radius = (node->lightsource->GetRadius() * gl_lights_size);
-			float scale = 1.0f / ((2.f * radius) - dist);
 
-			if (radius > 0.f && dist < radius)
-			{
-				Vector nearPt, up, right;
-
-				pos.Set(x,z,y);
-				fn=p.Normal();
-				fn.GetRightUp(right, up);
-
-				Vector tmpVec = fn * dist;
-				nearPt = pos + tmpVec;
-
-				Vector t1;
-				int outcnt[4]={0,0,0,0};
-				texcoord tcs[4];
-
-				// do a quick check whether the light touches this polygon
-				for(int i=0;i<4;i++)
-				{
-					t1.Set(&vtx[i*3]);
-					Vector nearToVert = t1 - nearPt;
-					tcs[i].u = (nearToVert.Dot(right) * scale) + 0.5f;
-					tcs[i].v = (nearToVert.Dot(up) * scale) + 0.5f;
-
-					if (tcs[i].u<0) outcnt[0]++;
-					if (tcs[i].u>1) outcnt[1]++;
-					if (tcs[i].v<0) outcnt[2]++;
-					if (tcs[i].v>1) outcnt[3]++;
-
-				}
-				if (outcnt[0]!=4 && outcnt[1]!=4 && outcnt[2]!=4 && outcnt[3]!=4) 
-				{
-					gl_GetLight(p, node->lightsource, true, false, lightdata);
-				}
-			}
-		}
-		node = node->nextLight;
-	}
+//==========================================================================
+//
+// Finds the static buffer entry for this wall and fills in the key
+// the cached vertices need to match. Only the plain wall parts of a
+// seg are cached, all special types are generated each time they are drawn.
+//
+//==========================================================================
 
-	dynlightindex = GLRenderer->mLights->UploadLights(lightdata);
+FWallCacheEntry *GLWall::GetWallCache(texcoord * tcs, bool split, FWallCacheKey &key)
+{
+	if (!gl_cachewalls || !(gl.flags & RFL_BUFFER_STORAGE)) return NULL;
+	if (seg == NULL || seg->sidedef == NULL || type < RENDERWALL_TOP || type > RENDERWALL_BOTTOM) return NULL;
+
+	FWallCacheEntry *entry = GLRenderer->mVBO->GetWallCacheEntry(unsigned(seg - segs), type - RENDERWALL_TOP);
+	if (entry == NULL) return NULL;
+
+	memset(&key, 0, sizeof(key));
+	key.x1 = glseg.x1;
+	key.y1 = glseg.y1;
+	key.x2 = glseg.x2;
+	key.y2 = glseg.y2;
+	key.fracleft = glseg.fracleft;
+	key.fracright = glseg.fracright;
+	key.ztop[0] = ztop[0];
+	key.ztop[1] = ztop[1];
+	key.zbottom[0] = zbottom[0];
+	key.zbottom[1] = zbottom[1];
+	for (int i = 0; i < 4; i++)
+	{
+		key.u[i] = tcs[i].u;
+		key.v[i] = tcs[i].v;
+	}
+	if (split)
+	{
+		// the vertex height lists only matter if the wall gets split.
+		key.flags = 1 | (flags & (GLWF_NOSPLITUPPER | GLWF_NOSPLITLOWER));
+		if (vertexes[0] != NULL) key.heightstamp[0] = vertexes[0]->heightstamp;
+		if (vertexes[1] != NULL) key.heightstamp[1] = vertexes[1]->heightstamp;
+	}
+	return entry;
 }
 
-
 //==========================================================================
 //
 // General purpose wall rendering function
@@ -192,22 +198,61 @@ void GLWall::RenderWall(int textured, unsigned int *store)
 	}
 
 	// the rest of the code is identical for textured rendering and lights
-	FFlatVertex *ptr = GLRenderer->mVBO->GetBuffer();
 	unsigned int count, offset;
+	FWallCacheKey key;
+	FWallCacheEntry *cache = GetWallCache(tcs, split, key);
 
-	ptr->Set(glseg.x1, zbottom[0], glseg.y1, tcs[0].u, tcs[0].v);
-	ptr++;
-	if (split && glseg.fracleft == 0) SplitLeftEdge(tcs, ptr);
-	ptr->Set(glseg.x1, ztop[0], glseg.y1, tcs[1].u, tcs[1].v);
-	ptr++;
-	if (split && !(flags & GLWF_NOSPLITUPPER)) SplitUpperEdge(tcs, ptr);
-	ptr->Set(glseg.x2, ztop[1], glseg.y2, tcs[2].u, tcs[2].v);
-	ptr++;
-	if (split && glseg.fracright == 1) SplitRightEdge(tcs, ptr);
-	ptr->Set(glseg.x2, zbottom[1], glseg.y2, tcs[3].u, tcs[3].v);
-	ptr++;
-	if (split && !(flags & GLWF_NOSPLITLOWER)) SplitLowerEdge(tcs, ptr);
-	count = GLRenderer->mVBO->GetCount(ptr, &offset);
+	if (cache != NULL && cache->frame >= 0 && !memcmp(&cache->key, &key, sizeof(key)))
+	{
+		// vertices from an earlier frame are still valid.
+		offset = cache->offset;
+		count = cache->count;
+		cache->frame = gl_frameCount;
+		render_wallcachehits++;
+	}
+	else
+	{
+		FFlatVertex *ptr = NULL;
+
+		// If the entry was already drawn with different data in this frame a pending draw may still need the old vertices.
+		// This happens when one wall part is split into several pieces (e.g. by 3D floor lighting.)
+		if (cache != NULL && cache->frame != gl_frameCount)
+		{
+			unsigned int capacity = 4 + 2 * seg->sidedef->numsegs;
+			if (vertexes[0] != NULL) capacity += 2 * vertexes[0]->numsectors;
+			if (vertexes[1] != NULL) capacity += 2 * vertexes[1]->numsectors;
+			ptr = GLRenderer->mVBO->AllocWallCache(cache, capacity);
+		}
+		FFlatVertex *start = ptr;
+		if (ptr == NULL) ptr = GLRenderer->mVBO->GetBuffer();
+
+		ptr->Set(glseg.x1, zbottom[0], glseg.y1, tcs[0].u, tcs[0].v);
+		ptr++;
+		if (split && glseg.fracleft == 0) SplitLeftEdge(tcs, ptr);
+		ptr->Set(glseg.x1, ztop[0], glseg.y1, tcs[1].u, tcs[1].v);
+		ptr++;
+		if (split && !(flags & GLWF_NOSPLITUPPER)) SplitUpperEdge(tcs, ptr);
+		ptr->Set(glseg.x2, ztop[1], glseg.y2, tcs[2].u, tcs[2].v);
+		ptr++;
+		if (split && glseg.fracright == 1) SplitRightEdge(tcs, ptr);
+		ptr->Set(glseg.x2, zbottom[1], glseg.y2, tcs[3].u, tcs[3].v);
+		ptr++;
+		if (split && !(flags & GLWF_NOSPLITLOWER)) SplitLowerEdge(tcs, ptr);
+
+		if (start != NULL)
+		{
+			offset = cache->offset;
+			count = (unsigned int)(ptr - start);
+			cache->key = key;
+			cache->count = count;
+			cache->frame = gl_frameCount;
+			render_wallcacheupdates++;
+		}
+		else
+		{
+			count = GLRenderer->mVBO->GetCount(ptr, &offset);
+		}
+	}
 	if (!(textured & RWF_NORENDER))
 	{
 		GLRenderer->mVBO->RenderArray(GL_TRIANGLE_FAN, offset, count);
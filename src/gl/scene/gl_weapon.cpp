@@ -95,7 +95,8 @@ void FGLRenderer::DrawPSprite (player_t * player,pspdef_t *psp,fixed_t sx, fixed
 	FMaterial * tex = FMaterial::ValidateTexture(lump, true, false);
 	if (!tex) return;
 
-	gl_RenderState.SetMaterial(tex, CLAMP_XY_NOMIP, 0, OverrideShader, alphatexture);
+	FAtlasEntry *atlas = alphatexture ? NULL : tex->GetAtlasEntry(CLAMP_XY_NOMIP, 0);
+	gl_RenderState.SetMaterial(tex, CLAMP_XY_NOMIP, 0, OverrideShader, alphatexture, atlas);
 
 	float vw = (float)viewwidth;
 	float vh = (float)viewheight;
@@ -153,6 +154,14 @@ void FGLRenderer::DrawPSprite (player_t * player,pspdef_t *psp,fixed_t sx, fixed
 		fV2=tex->GetSpriteVB();
 	}
 
+	if (atlas != NULL)
+	{
+		fU1 = atlas->MapU(fU1);
+		fV1 = atlas->MapV(fV1);
+		fU2 = atlas->MapU(fU2);
+		fV2 = atlas->MapV(fV2);
+	}
+
 	if (tex->GetTransparent() || OverrideShader != -1)
 	{
 		gl_RenderState.AlphaFunc(GL_GEQUAL, 0.f);
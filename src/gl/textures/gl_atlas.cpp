@@ -0,0 +1,210 @@
+//
+// DESCRIPTION:
+//      Texture atlas for small 2D graphics and sprites.
+//
+
+#include "gl/system/gl_system.h"
+#include "c_cvars.h"
+#include "stats.h"
+#include "templates.h"
+#include "gl/system/gl_interface.h"
+#include "gl/renderer/gl_renderer.h"
+#include "gl/textures/gl_hwtexture.h"
+#include "gl/textures/gl_material.h"
+#include "gl/textures/gl_samplers.h"
+#include "gl/textures/gl_atlas.h"
+#include "gl/utility/gl_clock.h"
+
+CUSTOM_CVAR(Bool, gl_texture_atlas, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG|CVAR_NOINITCALL)
+{
+	GLRenderer->FlushTextures();
+}
+
+FTextureAtlas gl_TextureAtlas;
+
+enum
+{
+	ATLAS_PAGESIZE = 1024,
+	ATLAS_MAXPAGES = 8,		// for each kind of page
+	ATLAS_MAXSIZE = 256,	// larger images are not worth packing
+	ATLAS_MIPLEVELS = 2,	// mipmap levels after the base level on sprite pages
+};
+
+//==========================================================================
+//
+// Packs the image into a page and uploads it. Returns NULL if it doesn't
+// fit into any page and no new one can be created.
+//
+//==========================================================================
+
+FAtlasEntry *FTextureAtlas::Create(unsigned char *buffer, int width, int height, int translation, bool mipmapped)
+{
+	// The border repeats the edge pixels so that filtering does not pick up the neighbours.
+	// On mipmapped pages the areas are aligned to the size of a texel at the smallest mipmap
+	// level and get a border of one such texel.
+	int align = mipmapped ? 1 << ATLAS_MIPLEVELS : 1;
+	int border = align;
+	int w = (width + 2 * border + align - 1) & ~(align - 1);
+	int h = (height + 2 * border + align - 1) & ~(align - 1);
+	int pagesize = MIN(int(ATLAS_PAGESIZE), gl.max_texturesize);
+
+	if (w > ATLAS_MAXSIZE || h > ATLAS_MAXSIZE) return NULL;
+
+	FAtlasPage *page = NULL;
+	Rect area;
+	int numpages = 0;
+
+	for (unsigned i = 0; i < mPages.Size(); i++)
+	{
+		if (mPages[i]->mMipmapped != mipmapped) continue;
+		numpages++;
+		area = mPages[i]->mPacker.Insert(w, h);
+		if (area.height != 0)
+		{
+			page = mPages[i];
+			break;
+		}
+	}
+
+	if (page == NULL)
+	{
+		if (numpages >= ATLAS_MAXPAGES) return NULL;
+
+		page = new FAtlasPage;
+		page->mTexture = new FHardwareTexture(pagesize, pagesize, true);
+		page->mPacker.Init(pagesize, pagesize, true);
+		page->mMipmapped = mipmapped;
+		page->mEntries = 0;
+		page->mUsedPixels = 0;
+		mPages.Push(page);
+
+		// Creating the texture binds it, so the previous binding must be restored
+		// for anything that is still waiting to be drawn.
+		unsigned int lastbound = FHardwareTexture::lastbound[0];
+		page->mTexture->CreateTexture(NULL, pagesize, pagesize, 0, false, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipmapped ? ATLAS_MIPLEVELS : 0);
+		glBindTexture(GL_TEXTURE_2D, lastbound);
+		FHardwareTexture::lastbound[0] = lastbound;
+
+		area = page->mPacker.Insert(w, h);
+		if (area.height == 0) return NULL;
+	}
+
+	unsigned char *data = new unsigned char[w * h * 4];
+	for (int y = 0; y < h; y++)
+	{
+		int sy = clamp(y - border, 0, height - 1);
+		for (int x = 0; x < w; x++)
+		{
+			int sx = clamp(x - border, 0, width - 1);
+			memcpy(&data[(y * w + x) * 4], &buffer[(sy * width + sx) * 4], 4);
+		}
+	}
+	page->mTexture->UpdateRect(data, area.x, area.y, w, h);
+	delete[] data;
+
+	FAtlasEntry *entry = new FAtlasEntry;
+	entry->mPage = page;
+	entry->mArea = area;
+	entry->mWidth = width;
+	entry->mHeight = height;
+	entry->mTranslation = translation;
+	entry->mScaleU = float(width) / pagesize;
+	entry->mScaleV = float(height) / pagesize;
+	entry->mOffsetU = float(area.x + border) / pagesize;
+	entry->mOffsetV = float(area.y + border) / pagesize;
+
+	page->mEntries++;
+	page->mUsedPixels += width * height;
+	return entry;
+}
+
+//==========================================================================
+//
+// Returns the entry's area to its page.
+//
+//==========================================================================
+
+void FTextureAtlas::Release(FAtlasEntry *entry)
+{
+	FAtlasPage *page = entry->mPage;
+
+	page->mEntries--;
+	page->mUsedPixels -= entry->mWidth * entry->mHeight;
+	if (page->mEntries == 0)
+	{
+		int pagesize = MIN(int(ATLAS_PAGESIZE), gl.max_texturesize);
+		page->mPacker.Init(pagesize, pagesize, true);
+	}
+	else
+	{
+		page->mPacker.AddWaste(entry->mArea);
+	}
+	delete entry;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTextureAtlas::Bind(FAtlasEntry *entry, int clampmode)
+{
+	unsigned int lastbound = FHardwareTexture::lastbound[0];
+
+	entry->mPage->mTexture->Bind(0, 0, clampmode <= CLAMP_XY);
+	if (FHardwareTexture::lastbound[0] != lastbound) render_atlasbinds++;
+	GLRenderer->mSamplerManager->Bind(0, clampmode);
+}
+
+//==========================================================================
+//
+// All materials must have released their entries before this is called.
+//
+//==========================================================================
+
+void FTextureAtlas::Clear()
+{
+	for (unsigned i = 0; i < mPages.Size(); i++)
+	{
+		delete mPages[i]->mTexture;
+		delete mPages[i];
+	}
+	mPages.Clear();
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FTextureAtlas::GetStats(FString &out)
+{
+	int entries = 0;
+	double used = 0, allocated = 0;
+	int pagesize = MIN(int(ATLAS_PAGESIZE), gl.max_texturesize);
+
+	for (unsigned i = 0; i < mPages.Size(); i++)
+	{
+		entries += mPages[i]->mEntries;
+		used += mPages[i]->mUsedPixels;
+		allocated += mPages[i]->mPacker.Occupancy();
+	}
+	if (mPages.Size() > 0)
+	{
+		used = used * 100. / (double(pagesize) * pagesize * mPages.Size());
+		allocated = allocated * 100. / mPages.Size();
+	}
+	out.AppendFormat("Atlas: %d pages, %d images, %.1f%% used by images, %.1f%% allocated\n"
+		"Texture binds: %d, %d of them atlas pages\n",
+		mPages.Size(), entries, used, allocated, render_texbinds, render_atlasbinds);
+}
+
+ADD_STAT(atlas)
+{
+	FString out;
+	gl_TextureAtlas.GetStats(out);
+	return out;
+}
@@ -0,0 +1,59 @@
+#ifndef __GL_ATLAS_H
+#define __GL_ATLAS_H
+
+#include "tarray.h"
+#include "SkylineBinPack.h"
+
+class FHardwareTexture;
+class FString;
+
+//==========================================================================
+//
+// Texture atlas for small 2D graphics and sprites
+//
+// Font characters, HUD graphics and sprites get packed into a few large
+// pages so that consecutive draws of different images can use the same
+// texture and be batched. Each material/translation combination gets its
+// own area. Pages for sprites get a limited mipmap chain and their areas
+// are aligned so that the mipmaps do not mix different images.
+//
+//==========================================================================
+
+struct FAtlasPage
+{
+	FHardwareTexture *mTexture;
+	SkylineBinPack mPacker;
+	bool mMipmapped;
+	int mEntries;
+	int mUsedPixels;
+};
+
+struct FAtlasEntry
+{
+	FAtlasPage *mPage;
+	Rect mArea;				// allocated area including the border
+	int mWidth, mHeight;	// size of the image inside the area
+	int mTranslation;		// internal translation
+	float mScaleU, mScaleV;
+	float mOffsetU, mOffsetV;
+
+	// maps the material's own texture coordinates to the page
+	float MapU(float u) const { return mOffsetU + u * mScaleU; }
+	float MapV(float v) const { return mOffsetV + v * mScaleV; }
+};
+
+class FTextureAtlas
+{
+	TArray<FAtlasPage *> mPages;
+
+public:
+	FAtlasEntry *Create(unsigned char *buffer, int width, int height, int translation, bool mipmapped);
+	void Release(FAtlasEntry *entry);
+	void Bind(FAtlasEntry *entry, int clampmode);
+	void Clear();
+	void GetStats(FString &out);
+};
+
+extern FTextureAtlas gl_TextureAtlas;
+
+#endif
@@ -39,10 +39,20 @@
 #include "gl/renderer/gl_renderer.h"
 #include "gl/textures/gl_texture.h"
 #include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "m_misc.h"
+#include "cmdlib.h"
+#include "md5.h"
+#include "textures/bitmap.h"
+#include "m_workerpool.h"
 #include "gl/hqnx/hqx.h"
 #ifdef HAVE_MMX
 #include "gl/hqnx_asm/hqnx_asm.h"
 #endif
+#include <zlib.h>
+#include <atomic>
+#include <thread>
 
 CUSTOM_CVAR(Int, gl_texture_hqresize, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOINITCALL)
 {
@@ -69,6 +79,9 @@ CUSTOM_CVAR(Int, gl_texture_hqresize_targets, 7, CVAR_ARCHIVE | CVAR_GLOBALCONFI
 CVAR (Flag, gl_texture_hqresize_textures, gl_texture_hqresize_targets, 1);
 CVAR (Flag, gl_texture_hqresize_sprites, gl_texture_hqresize_targets, 2);
 CVAR (Flag, gl_texture_hqresize_fonts, gl_texture_hqresize_targets, 4);
+CVAR (Bool, gl_texture_hqresize_cache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+CVAR (Bool, gl_texture_hqresize_multithread, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+EXTERN_CVAR (Int, gl_texture_hqresize_threads);
 
 
 static void scale2x ( uint32* inputBuffer, uint32* outputBuffer, int inWidth, int inHeight )
@@ -198,14 +211,6 @@ static unsigned char *hqNxAsmHelper( void (*hqNxFunction) ( int*, unsigned char*
 	outWidth = N * inWidth;
 	outHeight = N *inHeight;
 
-	static int initdone = false;
-
-	if (!initdone)
-	{
-		HQnX_asm::InitLUTs();
-		initdone = true;
-	}
-
 	HQnX_asm::CImage cImageIn;
 	cImageIn.SetImage(inputBuffer, inWidth, inHeight, 32);
 	cImageIn.Convert32To17();
@@ -217,7 +222,49 @@ static unsigned char *hqNxAsmHelper( void (*hqNxFunction) ( int*, unsigned char*
 }
 #endif
 
-static unsigned char *hqNxHelper( void (*hqNxFunction) ( unsigned*, unsigned*, int, int ),
+typedef void (HQX_CALLCONV *hqNxRowsFunction) ( uint32_t*, uint32_t, uint32_t*, uint32_t, int, int, int, int );
+
+struct hqNxBandParams
+{
+	hqNxRowsFunction hqNxFunction;
+	uint32_t *src, *dest;
+	uint32_t srb, drb;
+	int inWidth, inHeight;
+	int numbands;
+};
+
+static void hqNxBand( unsigned int band, int thread, void *data )
+{
+	hqNxBandParams *p = static_cast<hqNxBandParams*>(data);
+	p->hqNxFunction( p->src, p->srb, p->dest, p->drb, p->inWidth, p->inHeight, p->inHeight * band / p->numbands, p->inHeight * (band + 1) / p->numbands );
+}
+
+//===========================================================================
+// 
+// Splits the image into bands of rows that are scaled in parallel.
+// Each band reads the rows next to it from the shared source image
+// so the output is the same as scaling the whole image at once.
+// This usually runs inside a texture worker task, so the bands are
+// handed to the same worker pool instead of starting more threads.
+//
+//===========================================================================
+static void hqNxBands( hqNxRowsFunction hqNxFunction, const int N, unsigned char *inputBuffer, unsigned char *outputBuffer, const int inWidth, const int inHeight, int numbands )
+{
+	hqNxBandParams params;
+	params.hqNxFunction = hqNxFunction;
+	params.src = reinterpret_cast<uint32_t*>(inputBuffer);
+	params.dest = reinterpret_cast<uint32_t*>(outputBuffer);
+	params.srb = inWidth * 4;
+	params.drb = inWidth * 4 * N;
+	params.inWidth = inWidth;
+	params.inHeight = inHeight;
+
+	// don't bother with threads for bands of less than 32 rows.
+	params.numbands = MAX(1, MIN(numbands, inHeight / 32));
+	WorkerPool.Run( params.numbands, params.numbands, hqNxBand, &params );
+}
+
+static unsigned char *hqNxHelper( hqNxRowsFunction hqNxFunction,
 							  const int N,
 							  unsigned char *inputBuffer,
 							  const int inWidth,
@@ -225,73 +272,104 @@ static unsigned char *hqNxHelper( void (*hqNxFunction) ( unsigned*, unsigned*, i
 							  int &outWidth,
 							  int &outHeight )
 {
-	static int initdone = false;
+	outWidth = N * inWidth;
+	outHeight = N *inHeight;
 
-	if (!initdone)
+	// The background upsampling threads already keep several cores busy.
+	int numbands = 1;
+	if (gl_texture_hqresize_multithread)
 	{
-		hqxInit();
-		initdone = true;
+		numbands = std::thread::hardware_concurrency() / MAX<int>(1, gl_texture_hqresize_threads);
 	}
-	outWidth = N * inWidth;
-	outHeight = N *inHeight;
 
 	unsigned char * newBuffer = new unsigned char[outWidth*outHeight*4];
-	hqNxFunction( reinterpret_cast<unsigned*>(inputBuffer), reinterpret_cast<unsigned*>(newBuffer), inWidth, inHeight );
+	hqNxBands( hqNxFunction, N, inputBuffer, newBuffer, inWidth, inHeight, numbands );
 	delete[] inputBuffer;
 	return newBuffer;
 }
 
 
+static void InitUpsampleCache();
+static bool hqxinitdone;
+
 //===========================================================================
 // 
-// [BB] Upsamples the texture in inputBuffer, frees inputBuffer and returns
-//  the upsampled buffer.
+// Returns the scaler to be used for a texture, or 0 if it should not be
+// upsampled. This also sets up the scaler's lookup tables so it must be
+// called on the main thread before gl_UpsampleTextureBuffer.
 //
 //===========================================================================
-unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha )
+int gl_GetUpsampleMode ( const FTexture *inputTexture, const int inWidth, const int inHeight, bool hasAlpha )
 {
-	// [BB] Make sure that outWidth and outHeight denote the size of
-	// the returned buffer even if we don't upsample the input buffer.
-	outWidth = inWidth;
-	outHeight = inHeight;
-
 	// [BB] Don't resample if the width or height of the input texture is bigger than gl_texture_hqresize_maxinputsize.
 	if ( ( inWidth > gl_texture_hqresize_maxinputsize ) || ( inHeight > gl_texture_hqresize_maxinputsize ) )
-		return inputBuffer;
+		return 0;
 
 	// [BB] Don't try to upsample textures based off FCanvasTexture.
 	if ( inputTexture->bHasCanvas )
-		return inputBuffer;
+		return 0;
 
 	switch (inputTexture->UseType)
 	{
 	case FTexture::TEX_Sprite:
 	case FTexture::TEX_SkinSprite:
-		if (!(gl_texture_hqresize_targets & 2)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 2)) return 0;
 		break;
 
 	case FTexture::TEX_FontChar:
-		if (!(gl_texture_hqresize_targets & 4)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 4)) return 0;
 		break;
 
 	default:
-		if (!(gl_texture_hqresize_targets & 1)) return inputBuffer;
+		if (!(gl_texture_hqresize_targets & 1)) return 0;
 		break;
 	}
 
-	if (inputBuffer)
+	int type = gl_texture_hqresize;
+#ifdef HAVE_MMX
+	// ASM-hqNx does not preserve the alpha channel so fall back to C-version for such textures
+	if (!hasAlpha && type > 3 && type <= 6)
+	{
+		type += 3;
+	}
+#endif
+
+	static bool cacheinitdone;
+	if (!cacheinitdone)
+	{
+		InitUpsampleCache();
+		cacheinitdone = true;
+	}
+
+	if (type >= 4 && type <= 6 && !hqxinitdone)
 	{
-		outWidth = inWidth;
-		outHeight = inHeight;
-		int type = gl_texture_hqresize;
+		hqxInit();
+		hqxinitdone = true;
+	}
 #ifdef HAVE_MMX
-		// ASM-hqNx does not preserve the alpha channel so fall back to C-version for such textures
-		if (!hasAlpha && type > 3 && type <= 6)
-		{
-			type += 3;
-		}
+	static bool asminitdone;
+	if (type >= 7 && !asminitdone)
+	{
+		HQnX_asm::InitLUTs();
+		asminitdone = true;
+	}
 #endif
+	return type;
+}
+
+//===========================================================================
+// 
+// Runs the scaler on inputBuffer, frees inputBuffer and returns the
+// upsampled buffer.
+//
+//===========================================================================
+static unsigned char *RunUpsampler ( int type, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight )
+{
+	outWidth = inWidth;
+	outHeight = inHeight;
 
+	if (inputBuffer)
+	{
 		switch (type)
 		{
 		case 1:
@@ -301,11 +379,11 @@ unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, u
 		case 3:
 			return scaleNxHelper( &scale4x, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 		case 4:
-			return hqNxHelper( &hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+			return hqNxHelper( &hq2x_32_rb_rows, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 		case 5:
-			return hqNxHelper( &hq3x_32, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+			return hqNxHelper( &hq3x_32_rb_rows, 3, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 		case 6:
-			return hqNxHelper( &hq4x_32, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
+			return hqNxHelper( &hq4x_32_rb_rows, 4, inputBuffer, inWidth, inHeight, outWidth, outHeight );
 #ifdef HAVE_MMX
 		case 7:
 			return hqNxAsmHelper( &HQnX_asm::hq2x_32, 2, inputBuffer, inWidth, inHeight, outWidth, outHeight );
@@ -318,3 +396,255 @@ unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, u
 	}
 	return inputBuffer;
 }
+
+//===========================================================================
+// 
+// Upsampled texture cache
+//
+// The scaler's output is stored compressed in the cache directory so that
+// it only needs to be calculated once. The files are named after an MD5
+// of the input image, its size and the scaler so everything that affects
+// the result, including the texture's translation, is part of the key.
+//
+//===========================================================================
+
+static FString hqcachepath;
+static std::atomic<int> hqcachehits, hqcachemisses, hqcachewrites, hqcachetmp;
+
+struct FUpsampleCacheHeader
+{
+	char magic[4];
+	DWORD width;
+	DWORD height;
+};
+
+//===========================================================================
+// 
+// The path is set up once on the main thread. Afterwards it is only
+// read so the worker threads can use it without locking.
+//
+//===========================================================================
+static void InitUpsampleCache()
+{
+	if (hqcachepath.IsEmpty())
+	{
+		hqcachepath = M_GetCachePath(true);
+		hqcachepath += "/hqnx/";
+		CreatePath(hqcachepath);
+	}
+}
+
+static void GetUpsampleCacheName(char *name, size_t namesize, int type, unsigned char *inputBuffer, int inWidth, int inHeight)
+{
+	MD5Context md5;
+	BYTE digest[16];
+	int header[3] = { type, inWidth, inHeight };
+
+	md5.Init();
+	md5.Update((BYTE*)header, sizeof(header));
+	md5.Update(inputBuffer, inWidth * inHeight * 4);
+	md5.Final(digest);
+
+	size_t len = mysnprintf(name, namesize, "%s", hqcachepath.GetChars());
+	for (int i = 0; i < 16 && len + 2 < namesize; i++)
+	{
+		len += mysnprintf(name + len, namesize - len, "%02x", digest[i]);
+	}
+	mysnprintf(name + len, namesize - len, ".hqc");
+}
+
+static unsigned char *ReadUpsampleCache(const char *name, int &outWidth, int &outHeight)
+{
+	FILE *f = fopen(name, "rb");
+	if (f == NULL) return NULL;
+
+	unsigned char *buffer = NULL;
+	FUpsampleCacheHeader header;
+	if (fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, "HQC1", 4) &&
+		header.width > 0 && header.width <= 4096 && header.height > 0 && header.height <= 4096)
+	{
+		fseek(f, 0, SEEK_END);
+		long compsize = ftell(f) - (long)sizeof(header);
+		fseek(f, sizeof(header), SEEK_SET);
+
+		if (compsize > 0)
+		{
+			unsigned char *compressed = new unsigned char[compsize];
+			uLongf size = header.width * header.height * 4;
+			buffer = new unsigned char[size];
+
+			if (fread(compressed, 1, compsize, f) != (size_t)compsize ||
+				uncompress(buffer, &size, compressed, compsize) != Z_OK ||
+				size != header.width * header.height * 4)
+			{
+				delete[] buffer;
+				buffer = NULL;
+			}
+			delete[] compressed;
+		}
+	}
+	fclose(f);
+
+	if (buffer != NULL)
+	{
+		outWidth = header.width;
+		outHeight = header.height;
+	}
+	return buffer;
+}
+
+static void WriteUpsampleCache(const char *name, unsigned char *buffer, int width, int height)
+{
+	uLong len = width * height * 4;
+	uLongf size = compressBound(len);
+	unsigned char *compressed = new unsigned char[size];
+
+	if (compress2(compressed, &size, buffer, len, Z_BEST_SPEED) == Z_OK)
+	{
+		// Write to a temporary file first so that other threads never see a
+		// partially written file when they upsample the same image.
+		char tmpname[1024];
+		mysnprintf(tmpname, countof(tmpname), "%s.%d.tmp", name, int(hqcachetmp++));
+
+		FILE *f = fopen(tmpname, "wb");
+		if (f != NULL)
+		{
+			FUpsampleCacheHeader header;
+			memcpy(header.magic, "HQC1", 4);
+			header.width = width;
+			header.height = height;
+
+			bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(compressed, 1, size, f) == size;
+			ok = fclose(f) == 0 && ok;
+			if (ok && rename(tmpname, name) == 0)
+			{
+				hqcachewrites++;
+			}
+			else
+			{
+				remove(tmpname);
+			}
+		}
+	}
+	delete[] compressed;
+}
+
+//===========================================================================
+// 
+// Upsamples inputBuffer with the given scaler, frees inputBuffer and
+// returns the upsampled buffer. This only works on the passed buffer
+// so it may run on any thread.
+//
+//===========================================================================
+unsigned char *gl_UpsampleTextureBuffer ( int type, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight )
+{
+	if (inputBuffer == NULL || type == 0 || !gl_texture_hqresize_cache || hqcachepath.IsEmpty())
+	{
+		return RunUpsampler(type, inputBuffer, inWidth, inHeight, outWidth, outHeight);
+	}
+
+	char name[1024];
+	GetUpsampleCacheName(name, countof(name), type, inputBuffer, inWidth, inHeight);
+
+	unsigned char *cached = ReadUpsampleCache(name, outWidth, outHeight);
+	if (cached != NULL)
+	{
+		hqcachehits++;
+		delete[] inputBuffer;
+		return cached;
+	}
+
+	hqcachemisses++;
+	unsigned char *outputBuffer = RunUpsampler(type, inputBuffer, inWidth, inHeight, outWidth, outHeight);
+	if (outputBuffer != inputBuffer)
+	{
+		WriteUpsampleCache(name, outputBuffer, outWidth, outHeight);
+	}
+	return outputBuffer;
+}
+
+ADD_STAT(hqcache)
+{
+	FString out;
+	out.Format("Upsample cache: %d hits, %d misses, %d written", int(hqcachehits), int(hqcachemisses), int(hqcachewrites));
+	return out;
+}
+
+//===========================================================================
+// 
+// [BB] Upsamples the texture in inputBuffer, frees inputBuffer and returns
+//  the upsampled buffer.
+//
+//===========================================================================
+unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha )
+{
+	// [BB] Make sure that outWidth and outHeight denote the size of
+	// the returned buffer even if we don't upsample the input buffer.
+	outWidth = inWidth;
+	outHeight = inHeight;
+
+	int type = gl_GetUpsampleMode(inputTexture, inWidth, inHeight, hasAlpha);
+	if (type == 0) return inputBuffer;
+	return gl_UpsampleTextureBuffer(type, inputBuffer, inWidth, inHeight, outWidth, outHeight);
+}
+
+//===========================================================================
+// 
+// Runs the hqNx scaler over all textures that are small enough to be
+// upsampled: once with the plain C code on one thread as the reference,
+// and once with SSE2 and row bands, and checks that both produce the
+// same output.
+//
+//===========================================================================
+CCMD (hqbench)
+{
+	static const hqNxRowsFunction functions[] = { &hq2x_32_rb_rows, &hq3x_32_rb_rows, &hq4x_32_rb_rows };
+	int N = argv.argc() > 1 ? clamp(atoi(argv[1]), 2, 4) : 4;
+	int numbands = std::thread::hardware_concurrency();
+	int count = 0, pixels = 0, mismatches = 0;
+	cycle_t reftime, opttime;
+
+	if (!hqxinitdone)
+	{
+		hqxInit();
+		hqxinitdone = true;
+	}
+	reftime.Reset();
+	opttime.Reset();
+
+	for (int i = 0; i < TexMan.NumTextures(); i++)
+	{
+		FTexture *tex = TexMan.ByIndex(i);
+		int w = tex->GetWidth();
+		int h = tex->GetHeight();
+
+		if (tex->UseType == FTexture::TEX_Null || tex->bHasCanvas || w <= 0 || h <= 0 ||
+			w > gl_texture_hqresize_maxinputsize || h > gl_texture_hqresize_maxinputsize) continue;
+
+		FBitmap bmp;
+		if (!bmp.Create(w, h)) continue;
+		memset(bmp.GetPixels(), 0, w * h * 4);
+		tex->CopyTrueColorPixels(&bmp, 0, 0);
+
+		unsigned char *ref = new unsigned char[w * h * N * N * 4];
+		unsigned char *opt = new unsigned char[w * h * N * N * 4];
+
+		hqxUseSIMD = 0;
+		reftime.Clock();
+		hqNxBands(functions[N - 2], N, bmp.GetPixels(), ref, w, h, 1);
+		reftime.Unclock();
+
+		hqxUseSIMD = 1;
+		opttime.Clock();
+		hqNxBands(functions[N - 2], N, bmp.GetPixels(), opt, w, h, numbands);
+		opttime.Unclock();
+
+		if (memcmp(ref, opt, w * h * N * N * 4)) mismatches++;
+		count++;
+		pixels += w * h;
+		delete[] ref;
+		delete[] opt;
+	}
+	Printf("hq%dx: %d textures, %d pixels, %d threads\n", N, count, pixels, numbands);
+	Printf("reference: %2.3f ms, optimized: %2.3f ms, %d mismatches\n", reftime.TimeMS(), opttime.TimeMS(), mismatches);
+}
@@ -46,6 +46,7 @@
 #include "gl/system/gl_cvars.h"
 #include "gl/renderer/gl_renderer.h"
 #include "gl/textures/gl_material.h"
+#include "gl/utility/gl_clock.h"
 
 
 extern TexFilter_s TexFilter[];
@@ -241,6 +242,29 @@ unsigned int FHardwareTexture::CreateTexture(unsigned char * buffer, int w, int
 }
 
 
+//===========================================================================
+// 
+//	Replaces a part of the untranslated texture, which must already exist.
+//	The previous binding of texture unit 0 is left intact.
+//
+//===========================================================================
+
+void FHardwareTexture::UpdateRect(unsigned char * buffer, int x, int y, int w, int h)
+{
+	TranslatedTexture * glTex = GetTexID(0);
+	if (glTex->glTexID == 0) return;
+
+	glBindTexture(GL_TEXTURE_2D, glTex->glTexID);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+	glBindTexture(GL_TEXTURE_2D, lastbound[0]);
+
+	// The mipmaps are recreated the next time they are needed. This only
+	// happens on an actual bind so if the texture is already bound it must
+	// be forced.
+	glTex->mipmapped = false;
+	if (lastbound[0] == glTex->glTexID) lastbound[0] = 0;
+}
+
 //===========================================================================
 // 
 //	Creates a texture
@@ -356,6 +380,7 @@ unsigned int FHardwareTexture::Bind(int texunit, int translation, bool needmipma
 	{
 		if (lastbound[texunit] == pTex->glTexID) return pTex->glTexID;
 		lastbound[texunit] = pTex->glTexID;
+		render_texbinds++;
 		if (texunit != 0) glActiveTexture(GL_TEXTURE0 + texunit);
 		glBindTexture(GL_TEXTURE_2D, pTex->glTexID);
 		// Check if we need mipmaps on a texture that was creted without them.
@@ -77,6 +77,7 @@ public:
 
 	unsigned int Bind(int texunit, int translation, bool needmipmap);
 	unsigned int CreateTexture(unsigned char * buffer, int w, int h, int texunit, bool mipmap, int translation);
+	void UpdateRect(unsigned char * buffer, int x, int y, int w, int h);
 
 	void Clean(bool all);
 };
@@ -58,11 +58,14 @@
 #include "gl/textures/gl_material.h"
 #include "gl/textures/gl_samplers.h"
 #include "gl/shaders/gl_shader.h"
+#include "gl/textures/gl_texworker.h"
+#include "gl/textures/gl_atlas.h"
 
 EXTERN_CVAR(Bool, gl_render_precise)
 EXTERN_CVAR(Int, gl_lightmode)
 EXTERN_CVAR(Bool, gl_precache)
 EXTERN_CVAR(Bool, gl_texture_usehires)
+EXTERN_CVAR(Bool, gl_texture_atlas)
 
 //===========================================================================
 //
@@ -160,6 +163,7 @@ unsigned char *FGLTexture::LoadHiresTexture(FTexture *tex, int *width, int *heig
 
 void FGLTexture::Clean(bool all)
 {
+	GLTextureWorker.Cancel(this);
 	if (mHwTexture) 
 	{
 		if (!all) mHwTexture->Clean(false);
@@ -176,9 +180,12 @@ void FGLTexture::Clean(bool all)
 // 
 //	Initializes the buffer for the texture data
 //
+//  If deferredupsample is passed the upsampling is left to the caller,
+//  which gets the scaler to use through it.
+//
 //===========================================================================
 
-unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded)
+unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded, int *deferredupsample)
 {
 	unsigned char * buffer;
 	int W, H;
@@ -240,12 +247,33 @@ unsigned char * FGLTexture::CreateTexBuffer(int translation, int & w, int & h, F
 	// if we just want the texture for some checks there's no need for upsampling.
 	if (!createexpanded) return buffer;
 
+	if (deferredupsample != NULL)
+	{
+		*deferredupsample = gl_GetUpsampleMode(tex, W, H, !!bIsTransparent);
+		return buffer;
+	}
+
 	// [BB] The hqnx upsampling (not the scaleN one) destroys partial transparency, don't upsamle textures using it.
 	// [BB] Potentially upsample the buffer.
 	return gl_CreateUpsampledTextureBuffer ( tex, buffer, W, H, w, h, !!bIsTransparent);
 }
 
 
+//===========================================================================
+// 
+//	Replaces a texture's placeholder with the upsampled image
+//
+//===========================================================================
+
+void FGLTexture::ReplaceTexture(unsigned char *buffer, int w, int h, int translation, bool mipmap)
+{
+	if (mHwTexture != NULL)
+	{
+		tex->ProcessData(buffer, w, h, false);
+		mHwTexture->CreateTexture(buffer, w, h, 0, mipmap, translation);
+	}
+}
+
 //===========================================================================
 // 
 //	Create hardware texture for world use
@@ -293,13 +321,21 @@ const FHardwareTexture *FGLTexture::Bind(int texunit, int clampmode, int transla
 		{
 			
 			int w=0, h=0;
+			int upsample = 0;
 
 			// Create this texture
 			unsigned char * buffer = NULL;
 			
 			if (!tex->bHasCanvas)
 			{
-				buffer = CreateTexBuffer(translation, w, h, hirescheck);
+				buffer = CreateTexBuffer(translation, w, h, hirescheck, true, GLTextureWorker.IsEnabled()? &upsample : NULL);
+				if (upsample > 0)
+				{
+					// The unscaled image is used until the worker is done.
+					unsigned char *copy = new unsigned char[w*(h+1)*4];
+					memcpy(copy, buffer, w*(h+1)*4);
+					GLTextureWorker.Queue(this, translation, needmipmap, upsample, copy, w, h);
+				}
 				tex->ProcessData(buffer, w, h, false);
 			}
 			if (!hwtex->CreateTexture(buffer, w, h, texunit, needmipmap, translation)) 
@@ -507,6 +543,7 @@ FMaterial::FMaterial(FTexture * tx, bool expanded)
 	}
 
 	mTextureLayers.ShrinkToFit();
+	mNoAtlas = false;
 	mMaxBound = -1;
 	mMaterials.Push(this);
 	tx->gl_info.Material[expanded] = this;
@@ -522,6 +559,7 @@ FMaterial::FMaterial(FTexture * tx, bool expanded)
 
 FMaterial::~FMaterial()
 {
+	ReleaseAtlasEntries();
 	for(unsigned i=0;i<mMaterials.Size();i++)
 	{
 		if (mMaterials[i]==this) 
@@ -633,8 +671,21 @@ static int lastclamp;
 static int lasttrans;
 
 
-void FMaterial::Bind(int clampmode, int translation)
+void FMaterial::Bind(int clampmode, int translation, FAtlasEntry *atlas)
 {
+	if (atlas != NULL)
+	{
+		// Materials in the atlas only have a base layer.
+		last = NULL;
+		gl_TextureAtlas.Bind(atlas, clampmode);
+		for(int i=1; i<=mMaxBound;i++)
+		{
+			FHardwareTexture::Unbind(i);
+		}
+		mMaxBound = 0;
+		return;
+	}
+
 	// avoid rebinding the same texture multiple times.
 	if (this == last && lastclamp == clampmode && translation == lasttrans) return;
 	last = this;
@@ -677,6 +728,77 @@ void FMaterial::Bind(int clampmode, int translation)
 }
 
 
+//===========================================================================
+//
+// Returns the material's area in the texture atlas for the given
+// translation and packs it there first if needed. Returns NULL if this
+// material cannot be drawn from the atlas.
+//
+// Only sprites and 2D graphics are eligible, and only when drawn with
+// a clamp mode that never uses hires replacements, upsampling or wrapping.
+//
+//===========================================================================
+
+FAtlasEntry *FMaterial::GetAtlasEntry(int clampmode, int translation)
+{
+	if (mNoAtlas || !gl_texture_atlas) return NULL;
+	if (clampmode != CLAMP_XY_NOMIP && (clampmode != CLAMP_XY || !mExpanded)) return NULL;
+
+	// Like the hardware textures the entries are keyed by the internal translation
+	// so that a translation that has been changed gets its own entry.
+	int trans = translation <= 0 ? -translation : GLTranslationPalette::GetInternalTranslation(translation);
+	for(unsigned i=0;i<mAtlasEntries.Size();i++)
+	{
+		if (mAtlasEntries[i]->mTranslation == trans) return mAtlasEntries[i];
+	}
+
+	switch (tex->UseType)
+	{
+	case FTexture::TEX_Sprite:
+	case FTexture::TEX_SkinSprite:
+	case FTexture::TEX_FontChar:
+	case FTexture::TEX_MiscPatch:
+		break;
+
+	default:
+		mNoAtlas = true;
+		return NULL;
+	}
+	if (tex->bHasCanvas || tex->bWarped || mTextureLayers.Size() > 0 || mShaderIndex != 0)
+	{
+		mNoAtlas = true;
+		return NULL;
+	}
+
+	int w, h;
+	int upsample = 0;
+	unsigned char *buffer = mBaseLayer->CreateTexBuffer(trans, w, h, NULL, true, &upsample);
+	FAtlasEntry *entry = NULL;
+
+	// upsampled textures would have a different size than their area.
+	if (upsample == 0)
+	{
+		tex->ProcessData(buffer, w, h, false);
+		entry = gl_TextureAtlas.Create(buffer, w, h, trans, mExpanded);
+	}
+	delete[] buffer;
+
+	// Too large or the atlas is full. This gets retried after the next texture flush.
+	if (entry == NULL) mNoAtlas = true;
+	else mAtlasEntries.Push(entry);
+	return entry;
+}
+
+void FMaterial::ReleaseAtlasEntries()
+{
+	for(unsigned i=0;i<mAtlasEntries.Size();i++)
+	{
+		gl_TextureAtlas.Release(mAtlasEntries[i]);
+	}
+	mAtlasEntries.Clear();
+	mNoAtlas = false;
+}
+
 //===========================================================================
 //
 //
@@ -788,6 +910,7 @@ again:
 		FMaterial *gltex = tex->gl_info.Material[expand];
 		if (gltex == NULL) 
 		{
+			gl_MainThreadOnly();
 			if (expand)
 			{
 				if (tex->bWarped || tex->bHasCanvas || tex->gl_info.shaderindex >= FIRST_USER_SHADER)
@@ -840,6 +963,8 @@ void FMaterial::FlushAll()
 			if (gltex != NULL) gltex->Clean(true);
 		}
 	}
+	// All materials have released their atlas entries above.
+	gl_TextureAtlas.Clear();
 }
 
 void FMaterial::ClearLastTexture()
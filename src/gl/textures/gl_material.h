@@ -6,12 +6,14 @@
 #include "textures/textures.h"
 #include "gl/textures/gl_hwtexture.h"
 #include "gl/renderer/gl_colormap.h"
+#include "gl/utility/gl_threads.h"
 #include "i_system.h"
 
 EXTERN_CVAR(Bool, gl_precache)
 
 struct FRemapTable;
 class FTextureShader;
+struct FAtlasEntry;
 
 enum
 {
@@ -77,7 +79,8 @@ public:
 	FGLTexture(FTexture * tx, bool expandpatches);
 	~FGLTexture();
 
-	unsigned char * CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded = true);
+	unsigned char * CreateTexBuffer(int translation, int & w, int & h, FTexture *hirescheck, bool createexpanded = true, int *deferredupsample = NULL);
+	void ReplaceTexture(unsigned char *buffer, int w, int h, int translation, bool mipmap);
 
 	void Clean(bool all);
 	int Dump(int i);
@@ -118,8 +121,12 @@ class FMaterial
 	float mSpriteU[2], mSpriteV[2];
 	FloatRect mSpriteRect;
 
+	TArray<FAtlasEntry *> mAtlasEntries;	// one for each translation
+	bool mNoAtlas;
+
 	FGLTexture * ValidateSysTexture(FTexture * tex, bool expand);
 	bool TrimBorders(int *rect);
+	void ReleaseAtlasEntries();
 
 public:
 	FTexture *tex;
@@ -137,7 +144,8 @@ public:
 		return mTextureLayers.Size() + 1;
 	}
 
-	void Bind(int clamp, int translation);
+	void Bind(int clamp, int translation, FAtlasEntry *atlas = NULL);
+	FAtlasEntry *GetAtlasEntry(int clamp, int translation);
 
 	unsigned char * CreateTexBuffer(int translation, int & w, int & h, bool allowhires=true, bool createexpanded = true) const
 	{
@@ -146,6 +154,7 @@ public:
 
 	void Clean(bool f)
 	{
+		ReleaseAtlasEntries();
 		mBaseLayer->Clean(f);
 	}
 
@@ -235,6 +244,7 @@ public:
 	{
 		if (mBaseLayer->bIsTransparent == -1) 
 		{
+			gl_MainThreadOnly();
 			if (!mBaseLayer->tex->bHasCanvas)
 			{
 				int w, h;
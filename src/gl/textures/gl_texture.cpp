@@ -50,6 +50,7 @@
 #include "gl/textures/gl_texture.h"
 #include "gl/textures/gl_material.h"
 #include "gl/textures/gl_samplers.h"
+#include "gl/utility/gl_threads.h"
 
 //==========================================================================
 //
@@ -358,6 +359,8 @@ void FTexture::GetGlowColor(float *data)
 {
 	if (gl_info.bGlowing && gl_info.GlowColor == 0)
 	{
+		gl_MainThreadOnly();
+
 		int w, h;
 		unsigned char *buffer = GLRenderer->GetTextureBuffer(this, w, h);
 
@@ -63,6 +63,8 @@ PalEntry averageColor(const DWORD *data, int size, fixed_t maxout);
 
 
 unsigned char *gl_CreateUpsampledTextureBuffer ( const FTexture *inputTexture, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight, bool hasAlpha );
+int gl_GetUpsampleMode ( const FTexture *inputTexture, const int inWidth, const int inHeight, bool hasAlpha );
+unsigned char *gl_UpsampleTextureBuffer ( int type, unsigned char *inputBuffer, const int inWidth, const int inHeight, int &outWidth, int &outHeight );
 int CheckDDPK3(FTexture *tex);
 int CheckExternalFile(FTexture *tex, bool & hascolorkey);
 PalEntry averageColor(const DWORD *data, int size, fixed_t maxout);
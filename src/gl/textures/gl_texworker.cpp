@@ -0,0 +1,240 @@
+//
+// DESCRIPTION:
+//      Background texture upsampling.
+//
+
+#include "gl/system/gl_system.h"
+#include "c_cvars.h"
+#include "m_workerpool.h"
+#include "gl/renderer/gl_renderer.h"
+#include "gl/textures/gl_material.h"
+#include "gl/textures/gl_texture.h"
+#include "gl/textures/gl_texworker.h"
+
+CUSTOM_CVAR(Int, gl_texture_hqresize_threads, 2, CVAR_ARCHIVE | CVAR_GLOBALCONFIG | CVAR_NOINITCALL)
+{
+	if (self < 0) self = 0;
+	else if (self > 8) self = 8;
+	// this throws away everything that is still being worked on so those textures need to be recreated.
+	GLRenderer->FlushTextures();
+}
+
+FTextureWorker GLTextureWorker;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FTextureWorker::FTextureWorker()
+{
+	mActive = 0;
+	mQuit = false;
+}
+
+FTextureWorker::~FTextureWorker()
+{
+	Stop();
+}
+
+//==========================================================================
+//
+// With gl_texture_hqresize_threads 0 the textures are upsampled on the
+// main thread when they are created, as before.
+//
+//==========================================================================
+
+bool FTextureWorker::IsEnabled() const
+{
+	return gl_texture_hqresize_threads > 0;
+}
+
+//==========================================================================
+//
+// Waits for the running tasks and throws away everything that's not
+// uploaded yet.
+//
+//==========================================================================
+
+void FTextureWorker::Stop()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	mQuit = true;
+	mIdle.wait(lock, [this] { return mActive == 0; });
+	mQuit = false;
+
+	for (size_t i = 0; i < mQueue.size(); i++)
+	{
+		delete[] mQueue[i]->buffer;
+		delete mQueue[i];
+	}
+	for (size_t i = 0; i < mFinished.size(); i++)
+	{
+		delete[] mFinished[i]->buffer;
+		delete mFinished[i];
+	}
+	mQueue.clear();
+	mFinished.clear();
+}
+
+//==========================================================================
+//
+// Each task scales one texture and then posts itself again if there is
+// more to do, so the pool gets a chance to help with other work between
+// two textures.
+//
+//==========================================================================
+
+void FTextureWorker::TaskMain(void *data)
+{
+	static_cast<FTextureWorker *>(data)->RunJob();
+}
+
+void FTextureWorker::RunJob()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	if (!mQuit && !mQueue.empty())
+	{
+		FJob *job = mQueue.front();
+		mQueue.erase(mQueue.begin());
+		mRunning.push_back(job);
+
+		lock.unlock();
+		int w, h;
+		job->buffer = gl_UpsampleTextureBuffer(job->mode, job->buffer, job->width, job->height, w, h);
+		job->width = w;
+		job->height = h;
+		lock.lock();
+
+		for (size_t i = 0; i < mRunning.size(); i++)
+		{
+			if (mRunning[i] == job)
+			{
+				mRunning.erase(mRunning.begin() + i);
+				break;
+			}
+		}
+		if (job->cancelled)
+		{
+			delete[] job->buffer;
+			delete job;
+		}
+		else
+		{
+			mFinished.push_back(job);
+		}
+	}
+
+	if (!mQuit && !mQueue.empty())
+	{
+		lock.unlock();
+		WorkerPool.Post(TaskMain, this);
+	}
+	else
+	{
+		mActive--;
+		mIdle.notify_all();
+	}
+}
+
+//==========================================================================
+//
+// Takes ownership of buffer, which must have been allocated with new[].
+//
+//==========================================================================
+
+void FTextureWorker::Queue(FGLTexture *tex, int translation, bool mipmap, int mode, unsigned char *buffer, int width, int height)
+{
+	FJob *job = new FJob;
+	job->tex = tex;
+	job->translation = translation;
+	job->mipmap = mipmap;
+	job->mode = mode;
+	job->buffer = buffer;
+	job->width = width;
+	job->height = height;
+	job->cancelled = false;
+
+	bool post = false;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mQueue.push_back(job);
+		// gl_texture_hqresize_threads limits how many pool threads the
+		// upsampling may occupy at the same time.
+		if (mActive < gl_texture_hqresize_threads)
+		{
+			mActive++;
+			post = true;
+		}
+	}
+	if (post)
+	{
+		WorkerPool.Post(TaskMain, this);
+	}
+}
+
+//==========================================================================
+//
+// Must be called before a texture's hardware textures get deleted.
+//
+//==========================================================================
+
+void FTextureWorker::Cancel(FGLTexture *tex)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+
+	for (size_t i = 0; i < mQueue.size(); )
+	{
+		if (mQueue[i]->tex == tex)
+		{
+			delete[] mQueue[i]->buffer;
+			delete mQueue[i];
+			mQueue.erase(mQueue.begin() + i);
+		}
+		else i++;
+	}
+	for (size_t i = 0; i < mFinished.size(); )
+	{
+		if (mFinished[i]->tex == tex)
+		{
+			delete[] mFinished[i]->buffer;
+			delete mFinished[i];
+			mFinished.erase(mFinished.begin() + i);
+		}
+		else i++;
+	}
+	// These are still being worked on and get deleted by the worker when done.
+	for (size_t i = 0; i < mRunning.size(); i++)
+	{
+		if (mRunning[i]->tex == tex) mRunning[i]->cancelled = true;
+	}
+}
+
+//==========================================================================
+//
+// Replaces the placeholders of up to maxcount finished textures.
+//
+//==========================================================================
+
+void FTextureWorker::UploadFinished(int maxcount)
+{
+	std::vector<FJob *> jobs;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		if (mFinished.empty()) return;
+
+		size_t count = MIN<size_t>(maxcount, mFinished.size());
+		jobs.assign(mFinished.begin(), mFinished.begin() + count);
+		mFinished.erase(mFinished.begin(), mFinished.begin() + count);
+	}
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		FJob *job = jobs[i];
+		job->tex->ReplaceTexture(job->buffer, job->width, job->height, job->translation, job->mipmap);
+		delete[] job->buffer;
+		delete job;
+	}
+	FMaterial::ClearLastTexture();
+}
@@ -0,0 +1,59 @@
+#ifndef __GL_TEXWORKER_H
+#define __GL_TEXWORKER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+class FGLTexture;
+
+//==========================================================================
+//
+// Upsamples textures on background threads.
+//
+// When a texture that needs upsampling gets created, its unscaled image is
+// uploaded right away and used as a placeholder. The scaler runs as a task
+// on the shared worker pool and the main thread replaces the placeholder
+// once per frame with what has been finished in the meantime.
+//
+//==========================================================================
+
+class FTextureWorker
+{
+	struct FJob
+	{
+		FGLTexture *tex;
+		int translation;
+		bool mipmap;
+		int mode;
+		unsigned char *buffer;
+		int width, height;
+		bool cancelled;
+	};
+
+public:
+	FTextureWorker();
+	~FTextureWorker();
+
+	bool IsEnabled() const;
+	void Queue(FGLTexture *tex, int translation, bool mipmap, int mode, unsigned char *buffer, int width, int height);
+	void Cancel(FGLTexture *tex);
+	void UploadFinished(int maxcount);
+	void Stop();
+
+private:
+	static void TaskMain(void *data);
+	void RunJob();
+
+	std::mutex mLock;
+	std::condition_variable mIdle;
+	std::vector<FJob *> mQueue;
+	std::vector<FJob *> mRunning;
+	std::vector<FJob *> mFinished;
+	int mActive;		// Tasks posted to the worker pool
+	bool mQuit;
+};
+
+extern FTextureWorker GLTextureWorker;
+
+#endif
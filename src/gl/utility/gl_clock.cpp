@@ -21,10 +21,15 @@ glcycle_t RenderFlat,SetupFlat;
 glcycle_t RenderSprite,SetupSprite;
 glcycle_t All, Finish, PortalAll, Bsp;
 glcycle_t ProcessAll;
+glcycle_t SetupThreads;
+glcycle_t LightSetup;
 glcycle_t RenderAll;
 glcycle_t Dirty;
 glcycle_t drawcalls;
 int vertexcount, flatvertices, flatprimitives;
+int render_drawcalls, render_batcheddraws;
+int render_wallcachehits, render_wallcacheupdates;
+int render_texbinds, render_atlasbinds;
 
 int rendered_lines,rendered_flats,rendered_sprites,render_vertexsplit,render_texsplit,rendered_decals, rendered_portals;
 int iter_dlightf, iter_dlight, draw_dlight, draw_dlightf;
@@ -97,9 +102,14 @@ void ResetProfilingData()
 	SetupFlat.Reset();
 	RenderSprite.Reset();
 	SetupSprite.Reset();
+	SetupThreads.Reset();
+	LightSetup.Reset();
 	drawcalls.Reset();
 
 	flatvertices=flatprimitives=vertexcount=0;
+	render_drawcalls=render_batcheddraws=0;
+	render_wallcachehits=render_wallcacheupdates=0;
+	render_texbinds=render_atlasbinds=0;
 	render_texsplit=render_vertexsplit=rendered_lines=rendered_flats=rendered_sprites=rendered_decals=rendered_portals = 0;
 }
 
@@ -118,24 +128,31 @@ static void AppendRenderTimes(FString &str)
 	str.AppendFormat("W: Render=%2.3f, Split = %2.3f, Setup=%2.3f, Clip=%2.3f\n"
 		"F: Render=%2.3f, Setup=%2.3f\n"
 		"S: Render=%2.3f, Setup=%2.3f\n"
-		"All=%2.3f, Render=%2.3f, Setup=%2.3f, BSP = %2.3f, Portal=%2.3f, Drawcalls=%2.3f, Finish=%2.3f\n",
+		"L: Setup=%2.3f\n"
+		"All=%2.3f, Render=%2.3f, Setup=%2.3f, Threads=%2.3f, BSP = %2.3f, Portal=%2.3f, Drawcalls=%2.3f, Finish=%2.3f\n",
 	RenderWall.TimeMS(), SplitWall.TimeMS(), setupwall, clipwall, RenderFlat.TimeMS(), SetupFlat.TimeMS(),
-	RenderSprite.TimeMS(), SetupSprite.TimeMS(), All.TimeMS() + Finish.TimeMS(), RenderAll.TimeMS(),
-	ProcessAll.TimeMS(), bsp, PortalAll.TimeMS(), drawcalls.TimeMS(), Finish.TimeMS());
+	RenderSprite.TimeMS(), SetupSprite.TimeMS(), LightSetup.TimeMS(), All.TimeMS() + Finish.TimeMS(), RenderAll.TimeMS(),
+	ProcessAll.TimeMS(), SetupThreads.TimeMS(), bsp, PortalAll.TimeMS(), drawcalls.TimeMS(), Finish.TimeMS());
 }
 
 static void AppendRenderStats(FString &out)
 {
 	out.AppendFormat("Walls: %d (%d splits, %d t-splits, %d vertices)\n"
 		"Flats: %d (%d primitives, %d vertices)\n"
-		"Sprites: %d, Decals=%d, Portals: %d\n",
-		rendered_lines, render_vertexsplit, render_texsplit, vertexcount, rendered_flats, flatprimitives, flatvertices, rendered_sprites,rendered_decals, rendered_portals );
+		"Sprites: %d, Decals=%d, Portals: %d\n"
+		"Draw calls: %d (%d merged into batches)\n"
+		"Wall cache: %d reused, %d updated\n",
+		rendered_lines, render_vertexsplit, render_texsplit, vertexcount, rendered_flats, flatprimitives, flatvertices, rendered_sprites,rendered_decals, rendered_portals,
+		render_drawcalls, render_batcheddraws, render_wallcachehits, render_wallcacheupdates );
 }
 
+void gl_AppendLightLinkStats(FString &out);
+
 static void AppendLightStats(FString &out)
 {
 	out.AppendFormat("DLight - Walls: %d processed, %d rendered - Flats: %d processed, %d rendered\n", 
 		iter_dlight, draw_dlight, iter_dlightf, draw_dlightf );
+	gl_AppendLightLinkStats(out);
 }
 
 ADD_STAT(rendertimes)
@@ -107,6 +107,8 @@ extern glcycle_t RenderFlat,SetupFlat;
 extern glcycle_t RenderSprite,SetupSprite;
 extern glcycle_t All, Finish, PortalAll, Bsp;
 extern glcycle_t ProcessAll;
+extern glcycle_t SetupThreads;
+extern glcycle_t LightSetup;
 extern glcycle_t RenderAll;
 extern glcycle_t Dirty;
 extern glcycle_t drawcalls;
@@ -116,6 +118,9 @@ extern int rendered_lines,rendered_flats,rendered_sprites,rendered_decals,render
 extern int rendered_portals;
 
 extern int vertexcount, flatvertices, flatprimitives;
+extern int render_drawcalls, render_batcheddraws;
+extern int render_wallcachehits, render_wallcacheupdates;
+extern int render_texbinds, render_atlasbinds;
 
 void ResetProfilingData();
 void CheckBench();
@@ -0,0 +1,8 @@
+//
+// DESCRIPTION:
+//      Scene setup on worker threads.
+//
+
+#include "gl/utility/gl_threads.h"
+
+thread_local FSetupSink *gl_setupsink;
@@ -0,0 +1,35 @@
+#ifndef __GL_THREADS_H
+#define __GL_THREADS_H
+
+#include <stddef.h>
+
+//==========================================================================
+//
+// Scene setup on worker threads
+//
+// While the walls, flats and sprites found by the BSP traversal are being
+// processed on worker threads, gl_setupsink points to the current thread's
+// output. Anything that may only be done on the main thread must call
+// gl_MainThreadOnly first. On a worker this abandons the item, which is
+// then processed again on the main thread once all workers are done.
+// Sky and portal items are known to need this and are given to the main
+// thread when they are queued.
+//
+//==========================================================================
+
+struct FSetupSink;
+extern thread_local FSetupSink *gl_setupsink;
+
+struct FSetupSerialOnly
+{
+};
+
+inline void gl_MainThreadOnly()
+{
+	if (gl_setupsink != NULL)
+	{
+		throw FSetupSerialOnly();
+	}
+}
+
+#endif
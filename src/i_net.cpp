@@ -222,6 +222,7 @@ void PacketSend (void)
 		c = sendto(mysocket, (char *)TransmitBuffer, size,
 			0, (sockaddr *)&sendaddress[doomcom.remotenode],
 			sizeof(sendaddress[doomcom.remotenode]));
+		NetTraffic[doomcom.remotenode].WireOut += size;
 	}
 	else
 	{
@@ -235,6 +236,7 @@ void PacketSend (void)
 			c = sendto(mysocket, (char *)doomcom.data, doomcom.datalength,
 				0, (sockaddr *)&sendaddress[doomcom.remotenode],
 				sizeof(sendaddress[doomcom.remotenode]));
+			NetTraffic[doomcom.remotenode].WireOut += doomcom.datalength;
 		}
 	}
 	//	if (c == -1)
@@ -290,6 +292,7 @@ void PacketGet (void)
 	}
 	else if (node >= 0 && c > 0)
 	{
+		NetTraffic[node].WireIn += c;
 		doomcom.data[0] = TransmitBuffer[0] & ~NCMD_COMPRESSED;
 		if (TransmitBuffer[0] & NCMD_COMPRESSED)
 		{
@@ -283,6 +283,57 @@ DWORD FRandom::StaticSumSeeds ()
 		pr_damagemobj.sfmt.u[0] + pr_damagemobj.idx;
 }
 
+//==========================================================================
+//
+// FRandom :: StaticHashStates
+//
+// Produces a hash of every named RNG for the sync check. Unlike
+// StaticSumSeeds this covers all of them, but only looks at the start of
+// each state, since all of it changes whenever it is regenerated. The
+// hashes are summed so that the order of RNGList doesn't matter. If a
+// report is passed, one line per RNG is added to it, sorted by name.
+//
+//==========================================================================
+
+static int STACK_ARGS SortQWords (const void *a, const void *b)
+{
+	QWORD x = *(const QWORD *)a, y = *(const QWORD *)b;
+	return x < y ? -1 : x > y;
+}
+
+DWORD FRandom::StaticHashStates (FString *report)
+{
+	TArray<QWORD> lines;
+	DWORD sum = 0;
+
+	for (FRandom *rng = FRandom::RNGList; rng != NULL; rng = rng->Next)
+	{
+		if (rng->NameCRC != 0)
+		{
+			DWORD hash = rng->NameCRC;
+			hash = (hash ^ rng->idx) * 0x01000193;
+			for (int i = 0; i < 4; ++i)
+			{
+				hash = (hash ^ rng->sfmt.u[i]) * 0x01000193;
+			}
+			sum += hash;
+			if (report != NULL)
+			{
+				lines.Push (((QWORD)rng->NameCRC << 32) | hash);
+			}
+		}
+	}
+	if (report != NULL)
+	{
+		qsort (&lines[0], lines.Size(), sizeof(QWORD), SortQWords);
+		for (unsigned int i = 0; i < lines.Size(); ++i)
+		{
+			report->AppendFormat ("rng %08x %08x\n", DWORD(lines[i] >> 32), DWORD(lines[i]));
+		}
+	}
+	return sum;
+}
+
 //==========================================================================
 //
 // FRandom :: StaticWriteRNGState
@@ -312,6 +363,34 @@ void FRandom::StaticWriteRNGState (FILE *file)
 	}
 }
 
+//==========================================================================
+//
+// FRandom :: StaticSerializeRNGState
+//
+// Stores or restores the state of every RNG in an in-memory archive.
+// Unlike the savegame chunk this depends on the order of RNGList, so it
+// is only good within the same session.
+//
+//==========================================================================
+
+void FRandom::StaticSerializeRNGState (FArchive &arc)
+{
+	arc << rngseed;
+
+	for (FRandom *rng = FRandom::RNGList; rng != NULL; rng = rng->Next)
+	{
+		arc << rng->idx;
+		if (arc.IsStoring())
+		{
+			arc.Write (rng->sfmt.u, sizeof(rng->sfmt.u));
+		}
+		else
+		{
+			arc.Read (rng->sfmt.u, sizeof(rng->sfmt.u));
+		}
+	}
+}
+
 //==========================================================================
 //
 // FRandom :: StaticReadRNGState
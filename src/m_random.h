@@ -40,6 +40,8 @@
 #include "sfmt/SFMT.h"
 
 struct PNGHandle;
+class FArchive;
+class FString;
 
 class FRandom
 {
@@ -176,6 +178,8 @@ public:
 	static DWORD StaticSumSeeds ();
 	static void StaticReadRNGState (PNGHandle *png);
 	static void StaticWriteRNGState (FILE *file);
+	static void StaticSerializeRNGState (FArchive &arc);
+	static DWORD StaticHashStates (FString *report);
 	static FRandom *StaticFindRNG(const char *name);
 
 #ifndef NDEBUG
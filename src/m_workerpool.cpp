@@ -0,0 +1,227 @@
+//
+// DESCRIPTION:
+//      A pool of worker threads shared by everything that gets split up
+//      over several cores.
+//
+
+#include <algorithm>
+#include "doomtype.h"
+#include "templates.h"
+#include "m_workerpool.h"
+
+FWorkerPool WorkerPool;
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FWorkerPool::FWorkerPool()
+{
+	Quit = false;
+}
+
+FWorkerPool::~FWorkerPool()
+{
+	Stop();
+}
+
+//==========================================================================
+//
+// FWorkerPool :: Start
+//
+// Called with Lock held. The calling thread always helps with its own
+// job, so one worker less than there are cores is enough. There are at
+// least two so that background tasks can't starve each other.
+//
+//==========================================================================
+
+void FWorkerPool::Start()
+{
+	if (Threads.size() > 0 || Quit)
+	{
+		return;
+	}
+	int numworkers = MAX(2, (int)std::thread::hardware_concurrency() - 1);
+	for (int i = 0; i < numworkers; ++i)
+	{
+		Threads.push_back(std::thread(&FWorkerPool::WorkerMain, this));
+	}
+}
+
+//==========================================================================
+//
+// FWorkerPool :: Stop
+//
+// Lets the workers finish everything that has been posted so that the
+// owners of the tasks don't wait for them forever.
+//
+//==========================================================================
+
+void FWorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Quit = true;
+	}
+	Wake.notify_all();
+	for (size_t i = 0; i < Threads.size(); ++i)
+	{
+		Threads[i].join();
+	}
+	Threads.clear();
+
+	std::lock_guard<std::mutex> lock(Lock);
+	Quit = false;
+}
+
+//==========================================================================
+//
+// FWorkerPool :: Run
+//
+//==========================================================================
+
+void FWorkerPool::Run(int numthreads, unsigned int count, WorkFunction work, void *data)
+{
+	if (numthreads > (int)count)
+	{
+		numthreads = (int)count;
+	}
+	if (numthreads <= 1)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			work(i, 0, data);
+		}
+		return;
+	}
+
+	FJob job;
+	job.Work = work;
+	job.Data = data;
+	job.Count = count;
+	job.Next = 0;
+	job.MaxThreads = numthreads;
+	job.Threads = 1;
+	job.Active = 1;
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Start();
+		Jobs.push_back(&job);
+	}
+	Wake.notify_all();
+
+	DoJob(&job, 0);
+
+	// The job lives on this stack, so wait until no worker uses it anymore.
+	std::unique_lock<std::mutex> lock(Lock);
+	RemoveJob(&job);
+	job.Active--;
+	while (job.Active > 0)
+	{
+		Done.wait(lock);
+	}
+}
+
+//==========================================================================
+//
+// FWorkerPool :: Post
+//
+//==========================================================================
+
+void FWorkerPool::Post(TaskFunction task, void *data)
+{
+	FTask t = { task, data };
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Start();
+		Tasks.push_back(t);
+	}
+	Wake.notify_one();
+}
+
+//==========================================================================
+//
+// FWorkerPool :: WorkerMain
+//
+//==========================================================================
+
+void FWorkerPool::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	for (;;)
+	{
+		if (Jobs.size() > 0)
+		{
+			FJob *job = Jobs.front();
+			int thread = job->Threads++;
+			job->Active++;
+			if (job->Threads >= job->MaxThreads)
+			{
+				RemoveJob(job);
+			}
+
+			lock.unlock();
+			DoJob(job, thread);
+			lock.lock();
+
+			// All indices are taken, so nobody else needs to join.
+			RemoveJob(job);
+			if (--job->Active == 0)
+			{
+				Done.notify_all();
+			}
+		}
+		else if (Tasks.size() > 0)
+		{
+			FTask task = Tasks.front();
+			Tasks.pop_front();
+
+			lock.unlock();
+			task.Func(task.Data);
+			lock.lock();
+		}
+		else if (Quit)
+		{
+			return;
+		}
+		else
+		{
+			Wake.wait(lock);
+		}
+	}
+}
+
+//==========================================================================
+//
+// FWorkerPool :: RemoveJob
+//
+// Called with Lock held.
+//
+//==========================================================================
+
+void FWorkerPool::RemoveJob(FJob *job)
+{
+	std::vector<FJob *>::iterator it = std::find(Jobs.begin(), Jobs.end(), job);
+	if (it != Jobs.end())
+	{
+		Jobs.erase(it);
+	}
+}
+
+//==========================================================================
+//
+// FWorkerPool :: DoJob
+//
+//==========================================================================
+
+void FWorkerPool::DoJob(FJob *job, int thread)
+{
+	unsigned int i;
+
+	while ((i = job->Next++) < job->Count)
+	{
+		job->Work(i, thread, job->Data);
+	}
+}
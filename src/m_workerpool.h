@@ -0,0 +1,82 @@
+//
+// DESCRIPTION:
+//      A pool of worker threads shared by everything that gets split up
+//      over several cores.
+//
+
+#ifndef __M_WORKERPOOL_H__
+#define __M_WORKERPOOL_H__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <deque>
+
+//==========================================================================
+//
+// Run calls work(index, thread, data) for every index below count, spread
+// over up to numthreads threads, and returns when all calls are done. The
+// calling thread takes part as thread 0 and the others get numbers below
+// numthreads that are unique within this call. Run may be called from
+// several threads at once, and from inside work or a posted task, so
+// nested jobs just get help from whichever workers are idle.
+//
+// Post hands a task to the workers to run in the background. Workers take
+// indices from pending Run calls before they start a new task, so a long
+// queue of tasks doesn't hold up the callers that are waiting.
+//
+// The threads are created the first time they are needed and then sleep
+// between jobs.
+//
+//==========================================================================
+
+class FWorkerPool
+{
+public:
+	typedef void (*WorkFunction)(unsigned int index, int thread, void *data);
+	typedef void (*TaskFunction)(void *data);
+
+	FWorkerPool();
+	~FWorkerPool();
+
+	void Run(int numthreads, unsigned int count, WorkFunction work, void *data = NULL);
+	void Post(TaskFunction task, void *data);
+	void Stop();
+
+private:
+	struct FJob
+	{
+		WorkFunction Work;
+		void *Data;
+		unsigned int Count;
+		std::atomic<unsigned int> Next;
+		int MaxThreads;
+		int Threads;		// Threads that joined so far
+		int Active;			// Threads still working on it
+	};
+
+	struct FTask
+	{
+		TaskFunction Func;
+		void *Data;
+	};
+
+	void Start();
+	void WorkerMain();
+	void RemoveJob(FJob *job);
+	static void DoJob(FJob *job, int thread);
+
+	std::vector<std::thread> Threads;
+	std::mutex Lock;
+	std::condition_variable Wake;
+	std::condition_variable Done;
+	std::vector<FJob *> Jobs;		// Run calls that may take more threads
+	std::deque<FTask> Tasks;
+	bool Quit;
+};
+
+extern FWorkerPool WorkerPool;
+
+#endif //__M_WORKERPOOL_H__
@@ -646,40 +646,54 @@ void ACSStringPool::ReadStrings(PNGHandle *png, DWORD id)
 	if (len != 0)
 	{
 		FPNGChunkArchive arc(png->File->GetFile(), id, len);
-		int32 i, j, poolsize;
-		unsigned int h, bucketnum;
-		char *str = NULL;
+		ReadStrings(arc);
+	}
+}
+
+//============================================================================
+//
+// ACSStringPool :: ReadStrings
+//
+// Reads strings from an archive.
+//
+//============================================================================
+
+void ACSStringPool::ReadStrings(FArchive &arc)
+{
+	int32 i, j, poolsize;
+	unsigned int h, bucketnum;
+	char *str = NULL;
 
-		arc << poolsize;
+	Clear();
+	arc << poolsize;
 
-		Pool.Resize(poolsize);
-		i = 0;
+	Pool.Resize(poolsize);
+	i = 0;
+	j = arc.ReadCount();
+	while (j >= 0)
+	{
+		// Mark skipped entries as free
+		for (; i < j; ++i)
+		{
+			Pool[i].Next = FREE_ENTRY;
+			Pool[i].LockCount = 0;
+		}
+		arc << str;
+		h = SuperFastHash(str, strlen(str));
+		bucketnum = h % NUM_BUCKETS;
+		Pool[i].Str = str;
+		Pool[i].Hash = h;
+		Pool[i].LockCount = arc.ReadCount();
+		Pool[i].Next = PoolBuckets[bucketnum];
+		PoolBuckets[bucketnum] = i;
+		i++;
 		j = arc.ReadCount();
-		while (j >= 0)
-		{
-			// Mark skipped entries as free
-			for (; i < j; ++i)
-			{
-				Pool[i].Next = FREE_ENTRY;
-				Pool[i].LockCount = 0;
-			}
-			arc << str;
-			h = SuperFastHash(str, strlen(str));
-			bucketnum = h % NUM_BUCKETS;
-			Pool[i].Str = str;
-			Pool[i].Hash = h;
-			Pool[i].LockCount = arc.ReadCount();
-			Pool[i].Next = PoolBuckets[bucketnum];
-			PoolBuckets[bucketnum] = i;
-			i++;
-			j = arc.ReadCount();
-		}
-		if (str != NULL)
-		{
-			delete[] str;
-		}
-		FindFirstFreeEntry(0);
 	}
+	if (str != NULL)
+	{
+		delete[] str;
+	}
+	FindFirstFreeEntry(0);
 }
 
 //============================================================================
@@ -692,13 +706,25 @@ void ACSStringPool::ReadStrings(PNGHandle *png, DWORD id)
 
 void ACSStringPool::WriteStrings(FILE *file, DWORD id) const
 {
-	int32 i, poolsize = (int32)Pool.Size();
-	
-	if (poolsize == 0)
+	if (Pool.Size() == 0)
 	{ // No need to write if we don't have anything.
 		return;
 	}
 	FPNGChunkArchive arc(file, id);
+	WriteStrings(arc);
+}
+
+//============================================================================
+//
+// ACSStringPool :: WriteStrings
+//
+// Writes strings to an archive.
+//
+//============================================================================
+
+void ACSStringPool::WriteStrings(FArchive &arc) const
+{
+	int32 i, poolsize = (int32)Pool.Size();
 
 	arc << poolsize;
 	for (i = 0; i < poolsize; ++i)
@@ -1033,6 +1059,89 @@ void P_WriteACSVars(FILE *stdfile)
 	GlobalACSStrings.WriteStrings(stdfile, MAKE_ID('a','s','T','r'));
 }
 
+//============================================================================
+//
+// SerializeArrayVars
+//
+//============================================================================
+
+static void SerializeArrayVars (FArchive &arc, FWorldGlobalArray *vars, unsigned int count)
+{
+	unsigned int i;
+
+	if (arc.IsStoring())
+	{
+		for (i = 0; i < count; ++i)
+		{
+			if (vars[i].CountUsed() != 0)
+			{
+				FWorldGlobalArray::ConstIterator it(vars[i]);
+				const FWorldGlobalArray::Pair *pair;
+
+				arc.WriteCount (i);
+				arc.WriteCount (vars[i].CountUsed());
+				while (it.NextPair (pair))
+				{
+					arc.WriteCount (pair->Key);
+					arc.WriteCount (pair->Value);
+				}
+			}
+		}
+		arc.WriteCount (count);
+	}
+	else
+	{
+		for (i = 0; i < count; ++i)
+		{
+			vars[i].Clear ();
+		}
+		for (i = arc.ReadCount (); i < count; i = arc.ReadCount ())
+		{
+			DWORD size = arc.ReadCount ();
+			for (DWORD k = 0; k < size; ++k)
+			{
+				SDWORD key, val;
+				key = arc.ReadCount();
+				val = arc.ReadCount();
+				vars[i].Insert (key, val);
+			}
+		}
+	}
+}
+
+//============================================================================
+//
+// P_SerializeACSVars
+//
+// Saves or restores the world and global variables along with a level
+// snapshot, which does not contain them.
+//
+//============================================================================
+
+void P_SerializeACSVars(FArchive &arc)
+{
+	int i;
+
+	for (i = 0; i < NUM_WORLDVARS; ++i)
+	{
+		arc << ACS_WorldVars[i];
+	}
+	for (i = 0; i < NUM_GLOBALVARS; ++i)
+	{
+		arc << ACS_GlobalVars[i];
+	}
+	SerializeArrayVars (arc, ACS_WorldArrays, NUM_WORLDVARS);
+	SerializeArrayVars (arc, ACS_GlobalArrays, NUM_GLOBALVARS);
+	if (arc.IsStoring())
+	{
+		GlobalACSStrings.WriteStrings(arc);
+	}
+	else
+	{
+		GlobalACSStrings.ReadStrings(arc);
+	}
+}
+
 //---- Inventory functions --------------------------------------//
 //
 
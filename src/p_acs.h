@@ -96,6 +96,8 @@ public:
 	void Dump() const;
 	void ReadStrings(PNGHandle *png, DWORD id);
 	void WriteStrings(FILE *file, DWORD id) const;
+	void ReadStrings(FArchive &arc);
+	void WriteStrings(FArchive &arc) const;
 
 private:
 	int FindString(const char *str, size_t len, unsigned int h, unsigned int bucketnum);
@@ -122,6 +124,7 @@ extern ACSStringPool GlobalACSStrings;
 void P_CollectACSGlobalStrings(const SDWORD *stack, int stackdepth);
 void P_ReadACSVars(PNGHandle *);
 void P_WriteACSVars(FILE*);
+void P_SerializeACSVars(FArchive &arc);
 void P_ClearACSVars(bool);
 void P_SerializeACSScriptNumber(FArchive &arc, int &scriptnum, bool was2byte);
 
@@ -105,6 +105,13 @@ static FRandom pr_uniquetid("UniqueTID");
 
 FRandom pr_spawnmobj ("SpawnActor");
 
+// Time spent in P_XYMovement and P_ZMovement during the current tic.
+// Only measured while ActorMoveTiming is set, which DThinker::RunThinkers
+// does at the start of each tic while the movement stat is shown.
+cycle_t ActorMoveCycles;
+int ActorMoveCount;
+bool ActorMoveTiming;
+
 CUSTOM_CVAR (Float, sv_gravity, 800.f, CVAR_SERVERINFO|CVAR_NOSAVE)
 {
 	level.gravity = self;
@@ -2904,6 +2911,99 @@ CCMD(utid)
 		(argv.argc() > 2 && atoi(argv[2]) >= 0) ? atoi(argv[2]) : 0));
 }
 
+//==========================================================================
+//
+// STAT movement
+//
+// Shows how long moving the actors took during the last tic, and how much
+// of each actor the movement code works on.
+//
+//==========================================================================
+
+ADD_STAT (movement)
+{
+	FString out;
+	out.Format ("Movement time = %04.1f ms for %d actors (%.0f ns each)  Actor: %zu bytes, movement fields: %zu bytes",
+		ActorMoveCycles.TimeMS(), ActorMoveCount,
+		ActorMoveCount > 0 ? ActorMoveCycles.TimeMS() * 1e6 / ActorMoveCount : 0.,
+		sizeof(AActor),
+		myoffsetof(AActor, projectileKickback) + sizeof(int) - myoffsetof(AActor, snext));
+	return out;
+}
+
+//==========================================================================
+//
+// CCMD spawnbench
+//
+// Spawns and destroys lots of actors at the player's position and reports
+// how long the spawning, destroying and collecting took. This changes the
+// game state, so it is not allowed in multiplayer games or demos.
+//
+//==========================================================================
+
+CCMD(spawnbench)
+{
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: spawnbench <class> [count] [rounds]\n");
+		return;
+	}
+	if (gamestate != GS_LEVEL || players[consoleplayer].mo == NULL ||
+		netgame || demorecording || demoplayback)
+	{
+		Printf ("spawnbench can only be used in a single player game\n");
+		return;
+	}
+	const PClass *type = PClass::FindClass (argv[1]);
+	if (type == NULL || !type->IsDescendantOf (RUNTIME_CLASS(AActor)))
+	{
+		Printf ("Unknown actor class '%s'\n", argv[1]);
+		return;
+	}
+
+	int count = argv.argc() > 2 ? MAX(1, atoi(argv[2])) : 10000;
+	int rounds = argv.argc() > 3 ? MAX(1, atoi(argv[3])) : 10;
+	fixedvec3 pos = players[consoleplayer].mo->Pos();
+	TArray<AActor *> actors(count);
+	cycle_t spawntime, destroytime, collecttime;
+
+	spawntime.Reset();
+	destroytime.Reset();
+	collecttime.Reset();
+	GC::FullGC();
+	for (int r = 0; r < rounds; ++r)
+	{
+		spawntime.Clock();
+		for (int i = 0; i < count; ++i)
+		{
+			actors.Push (Spawn (type, pos, NO_REPLACE));
+		}
+		spawntime.Unclock();
+
+		destroytime.Clock();
+		for (unsigned i = 0; i < actors.Size(); ++i)
+		{
+			if (!(actors[i]->ObjectFlags & OF_EuthanizeMe))
+			{
+				actors[i]->ClearCounters();
+				actors[i]->Destroy();
+			}
+		}
+		destroytime.Unclock();
+		actors.Clear();
+
+		collecttime.Clock();
+		GC::FullGC();
+		collecttime.Unclock();
+	}
+
+	double total = spawntime.TimeMS() + destroytime.TimeMS() + collecttime.TimeMS();
+	Printf ("%d x %d %s: spawn %.2f ms, destroy %.2f ms, collect %.2f ms (%.0f ns per actor)\n",
+		rounds, count, type->TypeName.GetChars(),
+		spawntime.TimeMS(), destroytime.TimeMS(), collecttime.TimeMS(),
+		total * 1e6 / ((double)rounds * count));
+}
+
 //==========================================================================
 //
 // AActor :: GetMissileDamage
@@ -3601,7 +3701,14 @@ void AActor::Tick ()
 
 		// Handle X and Y velocities
 		BlockingMobj = NULL;
+		bool timemove = ActorMoveTiming;
+		if (timemove)
+		{
+			ActorMoveCount++;
+			ActorMoveCycles.Clock();
+		}
 		fixed_t oldfloorz = P_XYMovement (this, cummx, cummy);
+		if (timemove) ActorMoveCycles.Unclock();
 		if (ObjectFlags & OF_EuthanizeMe)
 		{ // actor was destroyed
 			return;
@@ -3624,7 +3731,9 @@ void AActor::Tick ()
 			{
 				if (!(onmo = P_CheckOnmobj (this)))
 				{
+					if (timemove) ActorMoveCycles.Clock();
 					P_ZMovement (this, oldfloorz);
+					if (timemove) ActorMoveCycles.Unclock();
 					flags2 &= ~MF2_ONMOBJ;
 				}
 				else
@@ -3681,7 +3790,9 @@ void AActor::Tick ()
 			}
 			else
 			{
+				if (timemove) ActorMoveCycles.Clock();
 				P_ZMovement (this, oldfloorz);
+				if (timemove) ActorMoveCycles.Unclock();
 			}
 
 			if (ObjectFlags & OF_EuthanizeMe)
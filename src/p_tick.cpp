@@ -27,6 +27,8 @@
 
 extern gamestate_t wipegamestate;
 
+bool rewindreplay;
+
 //==========================================================================
 //
 // P_CheckTickerPaused
@@ -73,7 +75,7 @@ void P_Ticker (void)
 	}
 
 	// run the tic
-	if (paused || P_CheckTickerPaused())
+	if (!rewindreplay && (paused || P_CheckTickerPaused()))
 		return;
 
 	P_NewPspriteTick();
@@ -25,5 +25,9 @@ void P_Ticker (void);
 
 bool P_CheckTickerPaused ();
 
+// Set while rewinding replays recorded tics, which must run even though
+// the console or menu that started the rewind is up.
+extern bool rewindreplay;
+
 
 #endif
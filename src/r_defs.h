@@ -82,6 +82,7 @@ struct vertex_t
 	angle_t viewangle;	// precalculated angle for clipping
 	int angletime;		// recalculation time for view angle
 	bool dirty;			// something has changed and needs to be recalculated
+	int heightstamp;	// incremented each time heightlist gets recalculated
 	int numheights;
 	int numsectors;
 	sector_t ** sectors;
@@ -94,6 +95,7 @@ struct vertex_t
 		angletime = 0;
 		viewangle = 0;
 		dirty = true;
+		heightstamp = 0;
 		numheights = numsectors = 0;
 		sectors = NULL;
 		heightlist = NULL;
@@ -59,6 +59,8 @@ enum
 	STAT_EARTHQUAKE,						// Earthquake actors
 	STAT_MAPMARKER,							// Map marker actors
 
+	STAT_DLIGHT=64,							// Dynamic lights. These only exist for the renderer and are not part of the game state.
+
 	STAT_DEFAULT = 100,						// Thinkers go here unless specified otherwise.
 	STAT_SECTOREFFECT,						// All sector effects that cause floor and ceiling movement
 	STAT_ACTORMOVER,						// actor movers